@@ -21,9 +21,7 @@ void Level_init(Level* level, int width, int height, int depth) {
     level->rotSpawn = 0.0f;
     level->tickRandom = (unsigned int)rand();
     level->tickCount = 0;
-    level->tickList = NULL;
-    level->tickListSize = 0;
-    level->tickListCapacity = 0;
+    TickQueue_init(&level->tickQueue);
     level->networkMode = false;
 
     level->blocks = (byte*)malloc((size_t)width * height * depth);
@@ -59,9 +57,7 @@ void Level_resize(Level* level, int width, int height, int depth) {
     level->unprocessed = 0;
     level->xSpawn = level->ySpawn = level->zSpawn = 0;
     level->rotSpawn = 0.0f;
-    free(level->tickList);
-    level->tickList = NULL;
-    level->tickListSize = level->tickListCapacity = 0;
+    TickQueue_destroy(&level->tickQueue);
     level->networkMode = false; // regenerating always returns to local/singleplayer authority
 
     level->blocks = (byte*)malloc((size_t)width * height * depth);
@@ -95,9 +91,7 @@ void Level_setDataFromNetwork(Level* level, int width, int height, int depth, co
     level->unprocessed = 0;
     level->xSpawn = level->ySpawn = level->zSpawn = 0;
     level->rotSpawn = 0.0f;
-    free(level->tickList);
-    level->tickList = NULL;
-    level->tickListSize = level->tickListCapacity = 0;
+    TickQueue_destroy(&level->tickQueue);
     // c0.0.19a_04: a network-installed level is server-authoritative for its
     // whole lifetime, matching new Level().setNetworkMode(true) in the real
     // source's LevelFinalize handler
@@ -203,7 +197,7 @@ bool Level_containsLiquid(const Level* level, const AABB* box, int liquidId) {
 void Level_destroy(Level* level) {
     free(level->blocks);
     free(level->lightDepths);
-    free(level->tickList);
+    TickQueue_destroy(&level->tickQueue);
 }
 
 ArrayList_AABB Level_getCubes(const Level* level, const AABB* aabb) {
@@ -540,34 +534,27 @@ void Level_swap(Level* level, int x1, int y1, int z1, int x2, int y2, int z2) {
     }
 }
 
-static void pushTickEntry(Level* level, TickEntry entry) {
-    if (level->tickListSize == level->tickListCapacity) {
-        level->tickListCapacity = level->tickListCapacity ? level->tickListCapacity * 2 : 16;
-        level->tickList = (TickEntry*)realloc(level->tickList, (size_t)level->tickListCapacity * sizeof(TickEntry));
-    }
-    level->tickList[level->tickListSize++] = entry;
-}
-
 void Level_addToTickNextTick(Level* level, int x, int y, int z, int tileId) {
     TickEntry e = { x, y, z, tileId, 0 };
     if (tileId > 0 && tileId < 256 && gTiles[tileId]) e.delay = gTiles[tileId]->tickDelay;
-    pushTickEntry(level, e);
+    TickQueue_push(&level->tickQueue, e); // out of memory just drops it
 }
 
 void Level_onTick(Level* level) {
     level->tickCount++;
 
-    if (level->tickCount % 5 == 0 && level->tickListSize > 0) {
-        int n = level->tickListSize;
+    if (level->tickCount % 5 == 0) {
         // drain the queue snapshot from the front, matching the Java
         // ArrayList.remove(0) fifo drain of everything queued so far. An
         // entry still delayed (lava) gets decremented and pushed back to
         // the tail instead of firing.
+        int n = level->tickQueue.count;
         for (int i = 0; i < n; ++i) {
-            TickEntry e = level->tickList[i];
+            TickEntry e;
+            TickQueue_pop(&level->tickQueue, &e);
             if (e.delay > 0) {
                 e.delay--;
-                pushTickEntry(level, e);
+                TickQueue_push(&level->tickQueue, e); // can't fail, the pop made room
                 continue;
             }
             if (e.x < 0 || e.y < 0 || e.z < 0 || e.x >= level->width || e.y >= level->depth || e.z >= level->height) continue;
@@ -577,9 +564,6 @@ void Level_onTick(Level* level) {
                 if (t && t->onTick) t->onTick(t, level, e.x, e.y, e.z);
             }
         }
-        int remaining = level->tickListSize - n;
-        memmove(level->tickList, level->tickList + n, (size_t)remaining * sizeof(TickEntry));
-        level->tickListSize = remaining;
     }
 
     level->unprocessed += level->width * level->height * level->depth;
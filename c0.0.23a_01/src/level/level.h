@@ -9,21 +9,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "../phys/aabb.h"
+#include "tick_queue.h"
 #include <math.h>
 
 typedef unsigned char byte;
 
 struct LevelRenderer; typedef struct LevelRenderer LevelRenderer;
 
-// a pending liquid/gravity-tile reaction scheduled for a future tick, see
-// Level_addToTickNextTick. delay is extra 5-tick drain cycles to wait before
-// firing (c0.0.16a_02, lava only, see Tile.tickDelay).
-typedef struct {
-    int x, y, z;
-    int tileId;
-    int delay;
-} TickEntry;
-
 typedef struct Level {
     int   width, height, depth;
     byte* blocks;
@@ -45,9 +37,8 @@ typedef struct Level {
     unsigned int tickRandom;
     int tickCount;
 
-    TickEntry* tickList;
-    int tickListSize;
-    int tickListCapacity;
+    // pending liquid/gravity-tile reactions, see Level_addToTickNextTick
+    TickQueue tickQueue;
 
     // c0.0.19a_04: true for the lifetime of a level installed from a network
     // connection. While true, level_setTile is a no-op (server-authoritative
@@ -0,0 +1,47 @@
+// level/tick_queue.c
+
+#include "tick_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+void TickQueue_init(TickQueue* queue) {
+    memset(queue, 0, sizeof *queue);
+}
+
+void TickQueue_destroy(TickQueue* queue) {
+    free(queue->entries);
+    TickQueue_init(queue);
+}
+
+// doubles the ring, unwrapping it so the oldest entry lands at index 0
+static bool grow(TickQueue* queue) {
+    int newCapacity = queue->capacity ? queue->capacity * 2 : 64;
+    TickEntry* entries = (TickEntry*)malloc((size_t)newCapacity * sizeof *entries);
+    if (!entries) return false;
+    int first = queue->capacity - queue->head;
+    if (first > queue->count) first = queue->count;
+    if (queue->count > 0) {
+        memcpy(entries, queue->entries + queue->head, (size_t)first * sizeof *entries);
+        memcpy(entries + first, queue->entries, (size_t)(queue->count - first) * sizeof *entries);
+    }
+    free(queue->entries);
+    queue->entries = entries;
+    queue->capacity = newCapacity;
+    queue->head = 0;
+    return true;
+}
+
+bool TickQueue_push(TickQueue* queue, TickEntry e) {
+    if (queue->count == queue->capacity && !grow(queue)) return false;
+    queue->entries[(queue->head + queue->count) & (queue->capacity - 1)] = e;
+    queue->count++;
+    return true;
+}
+
+bool TickQueue_pop(TickQueue* queue, TickEntry* out) {
+    if (queue->count == 0) return false;
+    *out = queue->entries[queue->head];
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->count--;
+    return true;
+}
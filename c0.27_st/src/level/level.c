@@ -28,6 +28,11 @@ void Level_init(Level* level, int width, int height, int depth) {
     level->networkMode = false;
     level->player = NULL; // set once by Minecraft's own init, via Level_setPlayer
     level->inExplosion = false;
+    level->batchDepth = 0;
+    level->batchCells = NULL;
+    level->batchCount = level->batchCapacity = 0;
+    level->batchMarks = NULL;
+    level->batchMarkCells = 0;
 
     level->blocks = (byte*)malloc((size_t)width * height * depth);
     level->lightDepths = (int*)malloc((size_t)width * height * sizeof(int));
@@ -215,6 +220,12 @@ void Level_destroy(Level* level) {
     free(level->blocks);
     free(level->lightDepths);
     free(level->tickList);
+    free(level->batchCells);
+    free(level->batchMarks);
+    level->batchCells = NULL;
+    level->batchMarks = NULL;
+    level->batchCount = level->batchCapacity = 0;
+    level->batchMarkCells = 0;
 }
 
 ArrayList_AABB Level_getCubes(const Level* level, const AABB* aabb) {
@@ -404,6 +415,132 @@ void Level_updateNeighborsAt(Level* level, int x, int y, int z) {
     notifyNeighborChanged(level, x, y, z, Level_getTile(level, x, y, z));
 }
 
+// adds a changed cell to the open batch, once. false if it couldn't be
+// recorded (out of memory), for the caller to handle the change immediately
+static bool batchRecord(Level* level, int index) {
+    unsigned char bit = (unsigned char)(1u << (index & 7));
+    if (level->batchMarks[index >> 3] & bit) return true;
+    if (level->batchCount == level->batchCapacity) {
+        int newCapacity = level->batchCapacity ? level->batchCapacity * 2 : 256;
+        int* grown = (int*)realloc(level->batchCells, (size_t)newCapacity * sizeof *grown);
+        if (!grown) return false;
+        level->batchCells = grown;
+        level->batchCapacity = newCapacity;
+    }
+    level->batchMarks[index >> 3] |= bit;
+    level->batchCells[level->batchCount++] = index;
+    return true;
+}
+
+void Level_beginBatch(Level* level) {
+    if (level->batchDepth++ > 0) return;
+    size_t cells = (size_t)level->width * level->height * level->depth;
+    if (level->batchMarkCells != cells) {
+        free(level->batchMarks);
+        level->batchMarks = (unsigned char*)calloc((cells + 7) / 8, 1);
+        level->batchMarkCells = level->batchMarks ? cells : 0;
+        // no marks, no batch: every write just goes through as usual
+        if (!level->batchMarks) level->batchDepth = 0;
+    }
+}
+
+void Level_endBatch(Level* level) {
+    if (level->batchDepth == 0 || --level->batchDepth > 0) return;
+    int count = level->batchCount;
+    if (count == 0) return;
+    int* cells = level->batchCells;
+    int layer = level->width * level->height;
+
+    // light, once per column. The column marks reuse the cell bits of the
+    // bottom layer, cleared again right after
+    int minX = level->width, minY = level->depth, minZ = level->height, maxX = -1, maxY = -1, maxZ = -1;
+    for (int i = 0; i < count; i++) {
+        int index = cells[i];
+        level->batchMarks[index >> 3] &= (unsigned char)~(1u << (index & 7));
+        int x = index % level->width, z = (index / level->width) % level->height, y = index / layer;
+        if (x < minX) minX = x;
+        if (x > maxX) maxX = x;
+        if (y < minY) minY = y;
+        if (y > maxY) maxY = y;
+        if (z < minZ) minZ = z;
+        if (z > maxZ) maxZ = z;
+    }
+    for (int i = 0; i < count; i++) {
+        int column = cells[i] % layer;
+        unsigned char bit = (unsigned char)(1u << (column & 7));
+        if (level->batchMarks[column >> 3] & bit) continue;
+        level->batchMarks[column >> 3] |= bit;
+        calcLightDepths(level, column % level->width, column / level->width, 1, 1);
+    }
+    for (int i = 0; i < count; i++) {
+        int column = cells[i] % layer;
+        level->batchMarks[column >> 3] &= (unsigned char)~(1u << (column & 7));
+    }
+
+    // the renderer, as one dirty box when the changes are packed together
+    // (a blast), or cell by cell when they're scattered
+    if (level->renderer) {
+        long long box = (long long)(maxX - minX + 3) * (maxY - minY + 3) * (maxZ - minZ + 3);
+        if (box <= (long long)count * 27 * 4) {
+            LevelRenderer_setDirty(level->renderer, minX - 1, minY - 1, minZ - 1, maxX + 1, maxY + 1, maxZ + 1);
+        } else {
+            for (int i = 0; i < count; i++) {
+                int index = cells[i];
+                levelRenderer_tileChanged(level->renderer, index % level->width, index / layer, (index / level->width) % level->height);
+            }
+        }
+    }
+
+    // neighbor notifications, once per cell next to any change, passing the
+    // tile now in the first changed cell found next to it. Collected before
+    // any are sent, since a notification may well start a new change
+    int* notify = (int*)malloc((size_t)count * 6 * 2 * sizeof *notify);
+    int notifyCount = 0;
+    if (notify) {
+        static const int offsets[6][3] = { {-1,0,0}, {1,0,0}, {0,-1,0}, {0,1,0}, {0,0,-1}, {0,0,1} };
+        for (int i = 0; i < count; i++) {
+            int index = cells[i];
+            int x = index % level->width, z = (index / level->width) % level->height, y = index / layer;
+            for (int n = 0; n < 6; n++) {
+                int nx = x + offsets[n][0], ny = y + offsets[n][1], nz = z + offsets[n][2];
+                if (nx < 0 || ny < 0 || nz < 0 || nx >= level->width || ny >= level->depth || nz >= level->height) continue;
+                int neighbor = (ny * level->height + nz) * level->width + nx;
+                unsigned char bit = (unsigned char)(1u << (neighbor & 7));
+                if (level->batchMarks[neighbor >> 3] & bit) continue;
+                level->batchMarks[neighbor >> 3] |= bit;
+                notify[notifyCount++] = neighbor;
+                notify[notifyCount++] = level->blocks[index];
+            }
+        }
+        for (int i = 0; i < notifyCount; i += 2) {
+            int neighbor = notify[i];
+            level->batchMarks[neighbor >> 3] &= (unsigned char)~(1u << (neighbor & 7));
+        }
+    }
+    level->batchCount = 0;
+
+    if (notify) {
+        for (int i = 0; i < notifyCount; i += 2) {
+            int neighbor = notify[i];
+            notifyNeighborChanged(level, neighbor % level->width, neighbor / layer, (neighbor / level->width) % level->height, notify[i + 1]);
+        }
+        free(notify);
+    } else {
+        // out of memory: fall back to notifying per change, as unbatched
+        for (int i = 0; i < count; i++) {
+            int index = cells[i];
+            int x = index % level->width, z = (index / level->width) % level->height, y = index / layer;
+            int type = level->blocks[index];
+            notifyNeighborChanged(level, x - 1, y, z, type);
+            notifyNeighborChanged(level, x + 1, y, z, type);
+            notifyNeighborChanged(level, x, y - 1, z, type);
+            notifyNeighborChanged(level, x, y + 1, z, type);
+            notifyNeighborChanged(level, x, y, z - 1, type);
+            notifyNeighborChanged(level, x, y, z + 1, type);
+        }
+    }
+}
+
 bool level_setTile(Level* level, int x, int y, int z, int type) {
     // c0.0.19a_04: gated no-op in multiplayer, matching the real source's
     // setTile/setTileNoNeighborChange checking networkMode. Only the
@@ -428,6 +565,8 @@ bool Level_netSetTile(Level* level, int x, int y, int z, int type) {
     const Tile* newTile = (type >= 0 && type < 256) ? gTiles[type] : NULL;
     if (newTile && newTile->onPlace) newTile->onPlace(newTile, level, x, y, z);
 
+    if (level->batchDepth > 0 && batchRecord(level, index)) return true;
+
     notifyNeighborChanged(level, x - 1, y, z, type);
     notifyNeighborChanged(level, x + 1, y, z, type);
     notifyNeighborChanged(level, x, y - 1, z, type);
@@ -760,6 +899,10 @@ void Level_explode(Level* level, Entity* source, float x, float y, float z, floa
     // both the mining path and this one, so this flag is how it tells them
     // apart and picks the right fuse
     level->inExplosion = true;
+    // not in the real source: the whole blast is one batch, so the cells
+    // around it are notified (and its columns relit) once, not once per
+    // neighboring cleared block
+    Level_beginBatch(level);
 
     for (int bx = x0; bx < x1; ++bx) {
         for (int by = y1 - 1; by >= y0; --by) {
@@ -796,6 +939,7 @@ void Level_explode(Level* level, Entity* source, float x, float y, float z, floa
     }
 
     level->inExplosion = false;
+    Level_endBatch(level);
 
     Minecraft_hurtEntitiesInExplosion(level, source, x, y, z, radius);
 }
\ No newline at end of file
@@ -73,6 +73,16 @@ typedef struct Level {
     // this port's single shared onRemoved hook (Tnt_onRemoved), so this flag
     // is how it tells which real hook it's standing in for
     bool inExplosion;
+
+    // not in the real source: Level_beginBatch/Level_endBatch state. While
+    // batchDepth > 0, every changed cell is recorded once (batchMarks has a
+    // bit per cell, sized for batchMarkCells cells) instead of notifying
+    // its neighbors, relighting and refreshing the renderer right away
+    int batchDepth;
+    int* batchCells;
+    int batchCount, batchCapacity;
+    unsigned char* batchMarks;
+    size_t batchMarkCells;
 } Level;
 
 typedef struct {
@@ -113,6 +123,15 @@ bool  level_setTile(Level* level, int x, int y, int z, int type);
 // networkMode
 bool  Level_netSetTile(Level* level, int x, int y, int z, int type);
 bool  Level_setTileNoUpdate(Level* level, int x, int y, int z, int type);
+
+// not in the real source: groups many level_setTile calls (an explosion's
+// blast) into one change set. In between, each write still happens and
+// still fires its tile's onPlace/onRemoved, but neighbor notifications,
+// light and the renderer wait for Level_endBatch, which then notifies each
+// neighboring cell once, relights each touched column once and marks the
+// touched area dirty in one go. Nests; only the outermost end commits
+void  Level_beginBatch(Level* level);
+void  Level_endBatch(Level* level);
 int   Level_getTile(const Level* level, int x, int y, int z);
 
 bool  Level_isLit(const Level* level, int x, int y, int z);
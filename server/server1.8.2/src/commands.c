@@ -5,6 +5,7 @@
 #include "net/connection.h"
 #include "net/packet.h"
 #include "level/level.h"
+#include "level/level_codec.h"
 #include "log.h"
 #include <string.h>
 #include <stdio.h>
@@ -90,6 +91,31 @@ void Commands_dispatch(MinecraftServer* srv, Connection* issuer, const char* tex
         if (!issuer) { Log_info("Can't set spawn from console!"); return; }
         int rot = issuer->lastYaw * 320 / 256;
         Level_setSpawnPos(&srv->level, issuer->lastX / 32, issuer->lastY / 32, issuer->lastZ / 32, (float)rot);
+    } else if (strcmp(cmd, "codecbench") == 0) {
+        // not in the real source: logs how each save codec and transfer
+        // strategy does on a copy of the current level, see level_codec.h.
+        // The results go to the console/server.log only
+        const Level* level = &srv->level;
+        size_t len = (size_t)level->width * level->height * level->depth;
+        unsigned char* copy = (unsigned char*)malloc(len);
+        if (!copy) { reply(issuer, "Out of memory"); return; }
+        Level_copyBlocks(level, copy);
+        LevelCodec_benchmarkAsync(copy, len);
+        reply(issuer, "Codec benchmark started, results go to the server log");
+    } else if (strcmp(cmd, "perf") == 0) {
+        // not in the real source: the tick profiler's current window, one
+        // phase per line, see tick_profiler.h
+        const TickProfiler* p = &srv->profiler;
+        char line[80];
+        snprintf(line, sizeof line, "%lld ticks, %lld over 50ms",
+                 p->window[PERF_TICK].count, p->windowOverruns);
+        if (issuer) reply(issuer, line);
+        else Log_info("%s", line);
+        for (int i = 0; i < PERF_PHASE_COUNT; i++) {
+            TickProfiler_describe(p, (PerfPhase)i, line, sizeof line);
+            if (issuer) reply(issuer, line);
+            else Log_info("%s", line);
+        }
     } else if (strcmp(cmd, "broadcast") == 0 || strcmp(cmd, "say") == 0) {
         // rest of line, not further tokenized (unlike the single-arg
         // commands above), so the message can contain spaces
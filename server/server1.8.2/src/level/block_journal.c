@@ -0,0 +1,285 @@
+// block_journal.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "block_journal.h"
+#include "level.h"
+#include "../log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+#define JOURNAL_PATH     "server_level.journal"
+#define JOURNAL_OLD_PATH "server_level.journal.old"
+
+// file header: 4 byte magic, then width/height/depth as big endian u16s.
+// Each record after it: x, y, z as big endian u16s, the new tile id, a
+// zero pad byte, then the level tick count as a big endian i32
+static const unsigned char JOURNAL_MAGIC[4] = { 'M', 'C', 'J', '1' };
+#define JOURNAL_HEADER_LEN 10
+#define JOURNAL_RECORD_LEN 12
+
+static void putU16(unsigned char* p, int v) { p[0] = (unsigned char)(v >> 8); p[1] = (unsigned char)v; }
+static int getU16(const unsigned char* p) { return (p[0] << 8) | p[1]; }
+
+static bool flushToDisk(FILE* f) {
+    if (fflush(f) != 0) return false;
+#if defined(_WIN32)
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+static bool truncateTo(FILE* f, long length) {
+    fflush(f);
+#if defined(_WIN32)
+    bool ok = _chsize_s(_fileno(f), length) == 0;
+#else
+    bool ok = ftruncate(fileno(f), (off_t)length) == 0;
+#endif
+    fseek(f, 0, SEEK_END);
+    return ok;
+}
+
+// the length of a journal of size bytes without a torn final record,
+// 0 if not even the header is whole
+static long wholeLength(long size) {
+    if (size < JOURNAL_HEADER_LEN) return 0;
+    return size - (size - JOURNAL_HEADER_LEN) % JOURNAL_RECORD_LEN;
+}
+
+static bool headerMatches(const unsigned char* header, int width, int height, int depth) {
+    return memcmp(header, JOURNAL_MAGIC, 4) == 0 && getU16(header + 4) == width &&
+           getU16(header + 6) == height && getU16(header + 8) == depth;
+}
+
+static void writeHeader(FILE* f, int width, int height, int depth) {
+    unsigned char header[JOURNAL_HEADER_LEN];
+    memcpy(header, JOURNAL_MAGIC, 4);
+    putU16(header + 4, width);
+    putU16(header + 6, height);
+    putU16(header + 8, depth);
+    fwrite(header, 1, sizeof header, f);
+}
+
+// path, opened for appending, with whatever a crash mid-write left of a
+// record (or of the header) cut off the end first: records appended after
+// those bytes would all replay shifted by them, as garbage. A file without
+// a whole header is started over with one for these dimensions
+static FILE* openTrimmed(const char* path, int width, int height, int depth) {
+    FILE* f = fopen(path, "ab");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    long whole = size < 0 ? 0 : wholeLength(size);
+    if (whole != size) {
+        if (!truncateTo(f, whole)) {
+            Log_warn("Failed to cut a partly written record off the end of %s", path);
+            fclose(f);
+            return NULL;
+        }
+        Log_warn("Cut %ld bytes of a partly written record off the end of %s", size - whole, path);
+    }
+    if (whole == 0) {
+        writeHeader(f, width, height, depth);
+        flushToDisk(f);
+    }
+    return f;
+}
+
+// renames path to <path>.orphaned-<unix time>, or just removes it if it
+// holds no records. false if it's still there
+static bool setAsideFile(const char* path, const char* why) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return true;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    if (size >= 0 && size < JOURNAL_HEADER_LEN + JOURNAL_RECORD_LEN) return remove(path) == 0;
+
+    char aside[64];
+    snprintf(aside, sizeof aside, "%s.orphaned-%lld", path, (long long)time(NULL));
+    if (rename(path, aside) != 0) {
+        Log_severe("Failed to move %s aside to %s", path, aside);
+        return false;
+    }
+    Log_warn("%s, kept its journal %s as %s", why, path, aside);
+    return true;
+}
+
+static FILE* openLive(const BlockJournal* j) {
+    // records after another level's header could never be replayed
+    FILE* f = fopen(JOURNAL_PATH, "rb");
+    if (f) {
+        unsigned char header[JOURNAL_HEADER_LEN];
+        bool mismatched = fread(header, 1, sizeof header, f) == sizeof header &&
+                          !headerMatches(header, j->width, j->height, j->depth);
+        fclose(f);
+        if (mismatched && !setAsideFile(JOURNAL_PATH, "The journal doesn't match the loaded level")) return NULL;
+    }
+    return openTrimmed(JOURNAL_PATH, j->width, j->height, j->depth);
+}
+
+bool BlockJournal_open(BlockJournal* j, const Level* level) {
+    memset(j, 0, sizeof *j);
+    j->width = level->width;
+    j->height = level->height;
+    j->depth = level->depth;
+    j->file = openLive(j);
+    if (!j->file) {
+        Log_warn("Failed to open %s, block changes won't be journaled", JOURNAL_PATH);
+        return false;
+    }
+    return true;
+}
+
+bool BlockJournal_setAside(void) {
+    const char* why = "No level could be loaded";
+    return setAsideFile(JOURNAL_OLD_PATH, why) && setAsideFile(JOURNAL_PATH, why);
+}
+
+void BlockJournal_append(BlockJournal* j, int x, int y, int z, int type, int tick) {
+    if (!j->file) return;
+    if (j->bufLen + JOURNAL_RECORD_LEN > j->bufCapacity) {
+        int newCapacity = j->bufCapacity ? j->bufCapacity * 2 : 4096;
+        unsigned char* grown = (unsigned char*)realloc(j->buf, (size_t)newCapacity);
+        if (!grown) {
+            j->dropped++; // reported by the next sync
+            return;
+        }
+        j->buf = grown;
+        j->bufCapacity = newCapacity;
+    }
+    unsigned char* p = j->buf + j->bufLen;
+    putU16(p, x);
+    putU16(p + 2, y);
+    putU16(p + 4, z);
+    p[6] = (unsigned char)type;
+    p[7] = 0;
+    p[8] = (unsigned char)(tick >> 24); p[9] = (unsigned char)(tick >> 16);
+    p[10] = (unsigned char)(tick >> 8); p[11] = (unsigned char)tick;
+    j->bufLen += JOURNAL_RECORD_LEN;
+    j->recordsSinceRotate++;
+}
+
+void BlockJournal_sync(BlockJournal* j) {
+    if (!j->file) return;
+    if (j->dropped > 0) {
+        Log_warn("Out of memory, %lld block changes weren't journaled", j->dropped);
+        j->dropped = 0;
+    }
+    if (j->bufLen == 0) return;
+
+    long before = ftell(j->file);
+    bool ok = fwrite(j->buf, 1, (size_t)j->bufLen, j->file) == (size_t)j->bufLen;
+    if (ok) ok = flushToDisk(j->file);
+    if (!ok) {
+        // cut back whatever part did land, so the retry starts on a record
+        // boundary, and keep the records for it
+        clearerr(j->file);
+        if (before >= 0) truncateTo(j->file, before);
+        if (!j->failing) Log_warn("Failed to write %d journaled block changes to %s, retrying", j->bufLen / JOURNAL_RECORD_LEN, JOURNAL_PATH);
+        j->failing = true;
+        return;
+    }
+    if (j->failing) Log_info("Writing %s works again", JOURNAL_PATH);
+    j->failing = false;
+    j->bufLen = 0;
+}
+
+// appends src's whole records (header and any torn tail skipped) onto the
+// end of dst, itself trimmed to whole records first. src is only removed
+// once they're all on disk
+static void appendRecords(const char* dstPath, const char* srcPath, const BlockJournal* j) {
+    FILE* src = fopen(srcPath, "rb");
+    if (!src) return;
+    fseek(src, 0, SEEK_END);
+    long size = ftell(src);
+    long left = size < 0 ? 0 : wholeLength(size) - JOURNAL_HEADER_LEN;
+    FILE* dst = openTrimmed(dstPath, j->width, j->height, j->depth);
+    if (!dst) {
+        Log_warn("Failed to open %s, %s is kept as it is", dstPath, srcPath);
+        fclose(src);
+        return;
+    }
+    fseek(src, JOURNAL_HEADER_LEN, SEEK_SET);
+    unsigned char chunk[64 * JOURNAL_RECORD_LEN];
+    bool ok = true;
+    while (ok && left > 0) {
+        size_t want = left < (long)sizeof chunk ? (size_t)left : sizeof chunk;
+        ok = fread(chunk, 1, want, src) == want && fwrite(chunk, 1, want, dst) == want;
+        left -= (long)want;
+    }
+    if (ok) ok = flushToDisk(dst);
+    fclose(dst);
+    fclose(src);
+    if (ok) remove(srcPath);
+    else Log_warn("Failed to append %s to %s, both are kept", srcPath, dstPath);
+}
+
+void BlockJournal_rotate(BlockJournal* j) {
+    if (j && j->file) {
+        BlockJournal_sync(j);
+        fclose(j->file);
+        j->file = NULL;
+        // anything a failed sync still holds is in the save being taken
+        j->bufLen = 0;
+        j->failing = false;
+    }
+
+    FILE* existing = fopen(JOURNAL_OLD_PATH, "rb");
+    if (existing) {
+        // a previous save never finished, so its records still aren't
+        // covered by anything on disk: keep them, with these after them
+        fclose(existing);
+        appendRecords(JOURNAL_OLD_PATH, JOURNAL_PATH, j);
+    } else {
+        rename(JOURNAL_PATH, JOURNAL_OLD_PATH);
+    }
+
+    if (j) {
+        j->recordsSinceRotate = 0;
+        j->file = openLive(j);
+    }
+}
+
+void BlockJournal_discardRotated(void) {
+    remove(JOURNAL_OLD_PATH);
+}
+
+static long long replayFile(Level* level, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+
+    unsigned char header[JOURNAL_HEADER_LEN];
+    if (fread(header, 1, sizeof header, f) != sizeof header ||
+        !headerMatches(header, level->width, level->height, level->depth)) {
+        Log_warn("Ignoring %s, it doesn't match the loaded level", path);
+        fclose(f);
+        return 0;
+    }
+
+    long long applied = 0;
+    unsigned char rec[JOURNAL_RECORD_LEN];
+    // a torn final record from a crash mid-write is simply short, and
+    // dropped (and cut off before anything is appended, see openTrimmed)
+    while (fread(rec, 1, sizeof rec, f) == sizeof rec) {
+        int x = getU16(rec), y = getU16(rec + 2), z = getU16(rec + 4);
+        if (x >= level->width || y >= level->depth || z >= level->height) continue;
+        level->blocks[(y * level->height + z) * level->width + x] = rec[6];
+        applied++;
+    }
+    fclose(f);
+    return applied;
+}
+
+long long BlockJournal_replay(Level* level) {
+    return replayFile(level, JOURNAL_OLD_PATH) + replayFile(level, JOURNAL_PATH);
+}
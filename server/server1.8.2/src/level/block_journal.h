@@ -0,0 +1,72 @@
+// block_journal.h: append-only log of block changes made since the last
+// full save. Not in the real source, whose only persistence is rewriting
+// all of server_level.dat every autosave, so anything edited since the
+// last one is lost on a crash. Every real block write is recorded here,
+// flushed to disk every few ticks, and replayed on top of the last full
+// save by Level_load; a full save then "compacts" it by rotating the
+// records it covers out of the live journal
+//
+// server_level.journal     records since the last save started
+// server_level.journal.old records a started (or failed) save covers,
+//                          deleted once that save is safely on disk
+
+#ifndef BLOCK_JOURNAL_H
+#define BLOCK_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+struct Level;
+
+// records past this since the last full save trigger one early, regardless
+// of the autosave interval (12 bytes each, so about 12MB on disk)
+#define JOURNAL_COMPACT_RECORDS (1 << 20)
+
+typedef struct BlockJournal {
+    FILE* file;
+    int width, height, depth; // the level this journal belongs to, checked on replay
+
+    // records since the last sync, written out and fsynced all at once
+    unsigned char* buf;
+    int bufLen, bufCapacity;
+
+    long long recordsSinceRotate; // used to trigger compaction early
+    bool failing;                 // the last sync couldn't write, buf is kept for the next
+    long long dropped;            // records lost to a failed buffer grow, logged on sync
+} BlockJournal;
+
+// opens (appending to) the live journal for level, cutting off a record
+// a crash left half written. A live journal for other dimensions is set
+// aside, as BlockJournal_setAside does
+bool BlockJournal_open(BlockJournal* j, const struct Level* level);
+
+// call when no save could be loaded, before generating a new level (and
+// its first save, which would rotate them away). Whatever journal files
+// are left may be all that remains of the lost level's edits, so they're
+// renamed to <name>.orphaned-<unix time> rather than thrown away or
+// replayed onto the new map; files without any records are just removed.
+// false if one couldn't be moved, and then the server shouldn't start
+bool BlockJournal_setAside(void);
+
+// buffers one record, no I/O until the next sync
+void BlockJournal_append(BlockJournal* j, int x, int y, int z, int type, int tick);
+// writes buffered records and forces them to disk. How often this runs is
+// how much a crash can lose. If that fails the file is cut back to where
+// it was and the records stay buffered for the next call, logged once
+void BlockJournal_sync(BlockJournal* j);
+
+// call as a full save's snapshot is taken: everything journaled so far is
+// covered by that save, so it moves to the .old file (appended, if a
+// previous save failed and left one behind). j may be NULL when
+// journaling is off, still moving aside whatever a previous run left
+void BlockJournal_rotate(BlockJournal* j);
+// call once that save has been written successfully
+void BlockJournal_discardRotated(void);
+
+// applies the .old then the live journal's records directly to
+// level->blocks (no neighbour/listener side effects, the same as loading
+// them from the save would). Files whose dimensions don't match are
+// skipped. Returns how many records were applied
+long long BlockJournal_replay(struct Level* level);
+
+#endif
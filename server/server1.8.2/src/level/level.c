@@ -3,13 +3,208 @@
 #include "level.h"
 #include "tile/tile.h"
 #include "levelgen/level_gen.h"
+#include "block_journal.h"
+#include "region_ticks.h"
+#include "level_sections.h"
+#include "level_native.h"
+#include "level_codec.h"
 #include "../log.h"
 
-#include <zlib.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <pthread.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#define LEVEL_SAVE_PATH      "server_level.dat"
+#define LEVEL_SAVE_TEMP_PATH "server_level.dat.tmp"
+#define LEVEL_NATIVE_PATH      "server_level.map"
+#define LEVEL_NATIVE_TEMP_PATH "server_level.map.tmp"
+
+// level-format=native, see Level_useNativeFormat
+static bool sNativeFormat = false;
+// save-codec and save-compression, see Level_setSaveCodec
+static int sSaveCodec = LEVEL_CODEC_GZIP;
+static int sSaveLevel = -1;
+
+static bool writeSaveFile(const Level* level);
+
+// one section's share of Level.spongeNear
+typedef struct SpongeSection {
+    byte* counts;  // LEVEL_SECTION_CELLS, laid out like a LevelSection's cells
+    int sponges;   // sponges whose cube reaches into this section, counts is freed at 0
+} SpongeSection;
+
+static int spongeSectionCount(const Level* level) {
+    int cols = (level->width + LEVEL_SECTION_SIZE - 1) >> LEVEL_SECTION_BITS;
+    int rows = (level->height + LEVEL_SECTION_SIZE - 1) >> LEVEL_SECTION_BITS;
+    int layers = (level->depth + LEVEL_SECTION_SIZE - 1) >> LEVEL_SECTION_BITS;
+    return cols * rows * layers;
+}
+
+static SpongeSection* spongeSectionAt(const Level* level, int x, int y, int z) {
+    int cols = (level->width + LEVEL_SECTION_SIZE - 1) >> LEVEL_SECTION_BITS;
+    int rows = (level->height + LEVEL_SECTION_SIZE - 1) >> LEVEL_SECTION_BITS;
+    return &level->spongeNear[((y >> LEVEL_SECTION_BITS) * rows + (z >> LEVEL_SECTION_BITS)) * cols + (x >> LEVEL_SECTION_BITS)];
+}
+
+static int spongeCellIndex(int x, int y, int z) {
+    const int mask = LEVEL_SECTION_SIZE - 1;
+    return (((y & mask) << LEVEL_SECTION_BITS) + (z & mask)) * LEVEL_SECTION_SIZE + (x & mask);
+}
+
+static void freeSpongeNear(Level* level) {
+    if (level->spongeNear) {
+        int count = spongeSectionCount(level);
+        for (int i = 0; i < count; i++) free(level->spongeNear[i].counts);
+    }
+    free(level->spongeNear);
+    level->spongeNear = NULL;
+    level->spongeCount = 0;
+}
+
+static void outOfSpongeMemory(void) {
+    Log_severe("Failed to allocate level memory");
+    exit(EXIT_FAILURE);
+}
+
+// adds delta to every count in the cube around the sponge at (x, y, z), a
+// section at a time, allocating a section's counts when the first sponge
+// comes near it and freeing them once the last one is gone
+static void adjustSpongeNear(Level* level, int x, int y, int z, int delta) {
+    int x0 = x - 2 < 0 ? 0 : x - 2, x1 = x + 2 >= level->width  ? level->width  - 1 : x + 2;
+    int y0 = y - 2 < 0 ? 0 : y - 2, y1 = y + 2 >= level->depth  ? level->depth  - 1 : y + 2;
+    int z0 = z - 2 < 0 ? 0 : z - 2, z1 = z + 2 >= level->height ? level->height - 1 : z + 2;
+    const int last = LEVEL_SECTION_SIZE - 1;
+    // (v | last) is the last cell of v's section, one past it the next section's first
+    for (int sy = y0; sy <= y1; sy = (sy | last) + 1)
+    for (int sz = z0; sz <= z1; sz = (sz | last) + 1)
+    for (int sx = x0; sx <= x1; sx = (sx | last) + 1) {
+        SpongeSection* sec = spongeSectionAt(level, sx, sy, sz);
+        if (!sec->counts) {
+            sec->counts = (byte*)calloc(LEVEL_SECTION_CELLS, 1);
+            if (!sec->counts) outOfSpongeMemory();
+        }
+        int ey = MIN(sy | last, y1), ez = MIN(sz | last, z1), ex = MIN(sx | last, x1);
+        for (int yy = sy; yy <= ey; yy++)
+            for (int zz = sz; zz <= ez; zz++) {
+                byte* row = sec->counts + spongeCellIndex(0, yy, zz);
+                for (int xx = sx; xx <= ex; xx++) row[xx & last] = (byte)(row[xx & last] + delta);
+            }
+        sec->sponges += delta;
+        if (sec->sponges == 0) {
+            free(sec->counts);
+            sec->counts = NULL;
+        }
+    }
+}
+
+// recounts from scratch, for after the whole block array was replaced
+static void rebuildSpongeNear(Level* level) {
+    freeSpongeNear(level);
+
+    int spongeCount = 0;
+    size_t total = (size_t)level->width * level->height * level->depth;
+    for (size_t i = 0; i < total; i++) {
+        if (level->blocks[i] == TILE_SPONGE.id) spongeCount++;
+    }
+    if (spongeCount == 0) return;
+
+    level->spongeNear = (SpongeSection*)calloc((size_t)spongeSectionCount(level), sizeof(SpongeSection));
+    if (!level->spongeNear) outOfSpongeMemory();
+    level->spongeCount = spongeCount;
+    for (int y = 0; y < level->depth; y++)
+        for (int z = 0; z < level->height; z++)
+            for (int x = 0; x < level->width; x++) {
+                if (level->blocks[(y * level->height + z) * level->width + x] == TILE_SPONGE.id) {
+                    adjustSpongeNear(level, x, y, z, 1);
+                }
+            }
+}
+
+// keeps spongeNear in step with a single block write
+static void noteSponge(Level* level, int x, int y, int z, int oldType, int newType) {
+    if (oldType == TILE_SPONGE.id && level->spongeNear) {
+        if (--level->spongeCount == 0) freeSpongeNear(level);
+        else adjustSpongeNear(level, x, y, z, -1);
+    }
+    if (newType == TILE_SPONGE.id) {
+        if (!level->spongeNear) {
+            level->spongeNear = (SpongeSection*)calloc((size_t)spongeSectionCount(level), sizeof(SpongeSection));
+            if (!level->spongeNear) outOfSpongeMemory();
+        }
+        level->spongeCount++;
+        adjustSpongeNear(level, x, y, z, 1);
+    }
+}
+
+// frees the flat block array, or unmaps it if it's still the file mapping
+// Level_load left it in
+static void freeBlocks(Level* level) {
+    if (level->blocksMapping) LevelNative_unmap(level->blocksMapping, level->blocksMappingLen);
+    else free(level->blocks);
+    level->blocks = NULL;
+    level->blocksMapping = NULL;
+    level->blocksMappingLen = 0;
+}
+
+// frees a packed level's sections, for code about to replace the blocks
+// wholesale with a fresh flat array. true if there were any, so it can
+// pack the new ones again after
+static bool dropSections(Level* level) {
+    if (!level->sections) return false;
+    LevelSections_destroy(level->sections);
+    free(level->sections);
+    level->sections = NULL;
+    return true;
+}
+
+// (re)allocates lightDepths, and blockerDepths in the same block, at the
+// level's current width and height
+static void allocLightDepths(Level* level) {
+    free(level->lightDepths);
+    size_t columns = (size_t)level->width * level->height;
+    level->lightDepths = (int*)malloc(columns * 2 * sizeof(int));
+    if (!level->lightDepths) {
+        Log_severe("Failed to allocate level memory");
+        exit(EXIT_FAILURE);
+    }
+    level->blockerDepths = level->lightDepths + columns;
+}
+
+// keeps one column's blocker depth in step with a block write at (x, y, z),
+// without rescanning it from the top: a light blocker now above the current
+// depth just raises it, and only clearing the topmost blocker needs a scan,
+// from there down to the next one. Looks at what's in the cell now, so it's
+// also right for a write whose cell has changed again since. y 0 never
+// counts (see calcLightDepths)
+static void updateLightColumn(Level* level, int x, int y, int z) {
+    if (y <= 0) return;
+    int* depth = &level->blockerDepths[x + z * level->width];
+    if (Level_isLightBlocker(level, x, y, z)) {
+        if (y + 1 > *depth) *depth = y + 1;
+    } else if (y + 1 == *depth) {
+        int d = y - 1;
+        while (d > 0 && !Level_isLightBlocker(level, x, d, z)) d--;
+        *depth = d + 1;
+    }
+}
+
+// where the real source calls calcLightDepths(level, x, z, 1, 1): the
+// column's light catches up with every write to it so far
+static void relightColumn(Level* level, int x, int z) {
+    int i = x + z * level->width;
+    level->lightDepths[i] = level->blockerDepths[i];
+}
 
 void Level_init(Level* level, int width, int height, int depth) {
     level->width = width;
@@ -22,25 +217,32 @@ void Level_init(Level* level, int width, int height, int depth) {
     level->rotSpawn = 0.0f;
     level->tickRandom = (unsigned int)rand();
     level->tickCount = 0;
-    level->tickList = NULL;
-    level->tickListSize = 0;
-    level->tickListCapacity = 0;
+    TickQueue_init(&level->tickQueue);
+    level->spongeNear = NULL;
+    level->spongeCount = 0;
+    level->region = NULL;
+    level->changeGeneration = 0;
+    level->journal = NULL;
+    level->sections = NULL;
+    level->blocksMapping = NULL;
+    level->blocksMappingLen = 0;
 
     level->blocks = (byte*)malloc((size_t)width * height * depth);
-    level->lightDepths = (int*)malloc((size_t)width * height * sizeof(int));
-    if (!level->blocks || !level->lightDepths) {
+    if (!level->blocks) {
         Log_severe("Failed to allocate level memory");
         exit(EXIT_FAILURE);
     }
+    level->lightDepths = NULL;
+    allocLightDepths(level);
 
     // Level_load frees and reallocates blocks/lightDepths at the file's own
     // dimensions if they differ from the boot size passed in above
     bool mapLoaded = Level_load(level);
     if (!mapLoaded) {
         Level_generateMap(level);
+        calcLightDepths(level, 0, 0, level->width, level->height);
     }
 
-    calcLightDepths(level, 0, 0, level->width, level->height);
     if (level->xSpawn == 0 && level->ySpawn == 0 && level->zSpawn == 0) Level_findSpawn(level);
 }
 
@@ -50,9 +252,9 @@ void Level_resize(Level* level, int width, int height, int depth) {
     LevelBlockChangeListener listener = level->listener;
     void* listenerCtx = level->listenerCtx;
     level->listener = NULL; // detached during regeneration, restored below
+    bool packed = dropSections(level);
 
-    free(level->blocks);
-    free(level->lightDepths);
+    freeBlocks(level);
 
     level->width = width;
     level->height = height;
@@ -60,20 +262,20 @@ void Level_resize(Level* level, int width, int height, int depth) {
     level->unprocessed = 0;
     level->xSpawn = level->ySpawn = level->zSpawn = 0;
     level->rotSpawn = 0.0f;
-    free(level->tickList);
-    level->tickList = NULL;
-    level->tickListSize = level->tickListCapacity = 0;
+    TickQueue_destroy(&level->tickQueue);
+    level->changeGeneration++;
 
     level->blocks = (byte*)malloc((size_t)width * height * depth);
-    level->lightDepths = (int*)malloc((size_t)width * height * sizeof(int));
-    if (!level->blocks || !level->lightDepths) {
+    if (!level->blocks) {
         Log_severe("Failed to allocate level memory");
         exit(EXIT_FAILURE);
     }
+    allocLightDepths(level);
 
     Level_generateMap(level);
     calcLightDepths(level, 0, 0, width, height);
     Level_findSpawn(level);
+    if (packed) Level_packSections(level, false);
 
     level->listener = listener;
     level->listenerCtx = listenerCtx;
@@ -87,19 +289,74 @@ void Level_setListener(Level* level, LevelBlockChangeListener fn, void* ctx) {
 void calcLightDepths(Level* level, int minX, int minZ, int maxX, int maxZ) {
     // the client also compares against the previous depth here to notify its
     // renderer of a chunk mesh rebuild; the server has no mesh, so it doesn't
-    for (int x = minX; x < minX + maxX; x++) {
+    if (maxX * maxZ <= 1) {
+        for (int x = minX; x < minX + maxX; x++) {
+            for (int z = minZ; z < minZ + maxZ; z++) {
+                int d = level->depth - 1;
+                while (d > 0 && !Level_isLightBlocker(level, x, d, z)) d--;
+                level->lightDepths[x + z * level->width] = d + 1;
+                level->blockerDepths[x + z * level->width] = d + 1;
+            }
+        }
+        return;
+    }
+
+    // not in the real source: anything bigger than a column (a whole map
+    // on load) is scanned a horizontal layer at a time from the top,
+    // following the block array's own layout instead of striding a full
+    // layer per step down each column, with blocksLight looked up from a
+    // table rather than called per block. Same result: each column's depth
+    // is one above its highest light blocker, never checking y 0
+    byte blocks[256];
+    for (int id = 0; id < 256; id++) {
+        const Tile* t = gTiles[id];
+        blocks[id] = (t && t->blocksLight(t)) ? 1 : 0;
+    }
+
+    for (int z = minZ; z < minZ + maxZ; z++) {
+        memset(level->lightDepths + z * level->width + minX, 0, (size_t)maxX * sizeof(int)); // 0 = not found yet
+    }
+    // a packed level's rows get copied out one at a time instead
+    byte* rowCopy = NULL;
+    if (!level->blocks) {
+        rowCopy = (byte*)malloc((size_t)level->width);
+        if (!rowCopy) {
+            Log_severe("Failed to allocate level memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    int unresolved = maxX * maxZ;
+    for (int y = level->depth - 1; y > 0 && unresolved > 0; y--) {
+        for (int z = minZ; z < minZ + maxZ; z++) {
+            const byte* row = rowCopy;
+            if (rowCopy) LevelSections_copyRow(level->sections, y, z, rowCopy);
+            else row = level->blocks + (size_t)(y * level->height + z) * level->width;
+            int* depths = level->lightDepths + z * level->width;
+            for (int x = minX; x < minX + maxX; x++) {
+                if (depths[x] == 0 && blocks[row[x]]) {
+                    depths[x] = y + 1;
+                    unresolved--;
+                }
+            }
+        }
+    }
+    if (unresolved > 0) {
         for (int z = minZ; z < minZ + maxZ; z++) {
-            int d = level->depth - 1;
-            while (d > 0 && !Level_isLightBlocker(level, x, d, z)) d--;
-            level->lightDepths[x + z * level->width] = d + 1;
+            int* depths = level->lightDepths + z * level->width;
+            for (int x = minX; x < minX + maxX; x++) if (depths[x] == 0) depths[x] = 1;
         }
     }
+    free(rowCopy);
+    for (int z = minZ; z < minZ + maxZ; z++) {
+        memcpy(level->blockerDepths + z * level->width + minX, level->lightDepths + z * level->width + minX, (size_t)maxX * sizeof(int));
+    }
 }
 
 void Level_generateMap(Level* level) {
     // c0.0.13a replaced the old Perlin hills generator with flat terrain,
     // carved caves and flood filled lakes (see level_gen.h for why it's flat).
     LevelGen_generateMap(level);
+    rebuildSpongeNear(level);
 }
 
 bool Level_isLightBlocker(const Level* level, int x, int y, int z) {
@@ -163,9 +420,11 @@ bool Level_containsLiquid(const Level* level, const AABB* box, int liquidId) {
 }
 
 void Level_destroy(Level* level) {
-    free(level->blocks);
+    dropSections(level);
+    freeBlocks(level);
     free(level->lightDepths);
-    free(level->tickList);
+    TickQueue_destroy(&level->tickQueue);
+    freeSpongeNear(level);
 }
 
 ArrayList_AABB Level_getCubes(const Level* level, const AABB* aabb) {
@@ -208,7 +467,8 @@ ArrayList_AABB Level_getCubes(const Level* level, const AABB* aabb) {
     return out;
 }
 
-// server_level.dat is gzipped: a 4 byte magic, a version byte, then a real
+// server_level.dat is gzipped (or, not in the real source, zstd or LZ4
+// compressed, see level_codec.h): a 4 byte magic, a version byte, then a real
 // Java serialized Level object (the server always writes version 2, unlike
 // the client's simpler hand rolled version 1 level.dat; these are NOT the
 // same format despite sharing the magic/version wrapper convention). Byte
@@ -274,41 +534,41 @@ static const unsigned char EMPTY_ENTITIES_TEMPLATE[54] = {
     0x04, 0x00, 0x00, 0x00, 0x00, 0x78
 };
 
-static void writeJavaInt(gzFile f, int v) {
+static void writeJavaInt(LevelCodecFile* f, int v) {
     unsigned char b[4] = { (unsigned char)(v >> 24), (unsigned char)(v >> 16),
                             (unsigned char)(v >> 8),  (unsigned char)v };
-    gzwrite(f, b, 4);
+    LevelCodecFile_write(f, b, 4);
 }
 
-static int readJavaInt(gzFile f, int* out) {
+static int readJavaInt(LevelCodecFile* f, int* out) {
     unsigned char b[4];
-    if (gzread(f, b, 4) != 4) return 0;
+    if (LevelCodecFile_read(f, b, 4) != 4) return 0;
     *out = ((int)b[0] << 24) | ((int)b[1] << 16) | ((int)b[2] << 8) | (int)b[3];
     return 1;
 }
 
-static void writeJavaLong(gzFile f, long long v) {
+static void writeJavaLong(LevelCodecFile* f, long long v) {
     unsigned char b[8];
     for (int i = 0; i < 8; ++i) b[i] = (unsigned char)(v >> (56 - i * 8));
-    gzwrite(f, b, 8);
+    LevelCodecFile_write(f, b, 8);
 }
 
-static int readJavaLong(gzFile f, long long* out) {
+static int readJavaLong(LevelCodecFile* f, long long* out) {
     unsigned char b[8];
-    if (gzread(f, b, 8) != 8) return 0;
+    if (LevelCodecFile_read(f, b, 8) != 8) return 0;
     long long v = 0;
     for (int i = 0; i < 8; ++i) v = (v << 8) | b[i];
     *out = v;
     return 1;
 }
 
-static void writeJavaFloat(gzFile f, float v) {
+static void writeJavaFloat(LevelCodecFile* f, float v) {
     unsigned int bits;
     memcpy(&bits, &v, sizeof bits);
     writeJavaInt(f, (int)bits);
 }
 
-static int readJavaFloat(gzFile f, float* out) {
+static int readJavaFloat(LevelCodecFile* f, float* out) {
     int bits;
     if (!readJavaInt(f, &bits)) return 0;
     unsigned int ubits = (unsigned int)bits;
@@ -319,13 +579,13 @@ static int readJavaFloat(gzFile f, float* out) {
 // TC_STRING: 1 byte tag (0x74), 2 byte big endian length, then that many
 // modified UTF-8 bytes. Plain ASCII strings (all this port ever writes) are
 // valid modified UTF-8 as-is, no special encoding needed
-static void writeJavaString(gzFile f, const char* s) {
+static void writeJavaString(LevelCodecFile* f, const char* s) {
     unsigned char tag = 0x74;
-    gzwrite(f, &tag, 1);
+    LevelCodecFile_write(f, &tag, 1);
     size_t len = strlen(s);
     unsigned char lenBytes[2] = { (unsigned char)(len >> 8), (unsigned char)len };
-    gzwrite(f, lenBytes, 2);
-    gzwrite(f, s, (unsigned)len);
+    LevelCodecFile_write(f, lenBytes, 2);
+    LevelCodecFile_write(f, s, (unsigned)len);
 }
 
 // handles TC_STRING normally. A field VALUE could in principle also be a
@@ -335,75 +595,73 @@ static void writeJavaString(gzFile f, const char* s) {
 // the header's fixed type descriptor strings, which do alias each other and
 // are already baked into the hardcoded template above). Falls back to an
 // empty string rather than actually resolving the handle table in that case
-static int readJavaString(gzFile f, char* out, size_t outCapacity) {
+static int readJavaString(LevelCodecFile* f, char* out, size_t outCapacity) {
     unsigned char tag;
-    if (gzread(f, &tag, 1) != 1) return 0;
+    if (LevelCodecFile_read(f, &tag, 1) != 1) return 0;
     if (tag == 0x71) { // TC_REFERENCE, see comment above
         unsigned char handle[4];
-        if (gzread(f, handle, 4) != 4) return 0;
+        if (LevelCodecFile_read(f, handle, 4) != 4) return 0;
         out[0] = '\0';
         return 1;
     }
     if (tag != 0x74) return 0;
     unsigned char lenBytes[2];
-    if (gzread(f, lenBytes, 2) != 2) return 0;
+    if (LevelCodecFile_read(f, lenBytes, 2) != 2) return 0;
     size_t len = ((size_t)lenBytes[0] << 8) | lenBytes[1];
     size_t toCopy = (len < outCapacity - 1) ? len : outCapacity - 1;
-    if (toCopy > 0 && gzread(f, out, (unsigned)toCopy) != (int)toCopy) return 0;
+    if (toCopy > 0 && LevelCodecFile_read(f, out, (unsigned)toCopy) != (int)toCopy) return 0;
     out[toCopy] = '\0';
     size_t remaining = len - toCopy;
     char discard[64];
     while (remaining > 0) {
         size_t chunk = remaining < sizeof(discard) ? remaining : sizeof(discard);
-        if (gzread(f, discard, (unsigned)chunk) != (int)chunk) return 0;
+        if (LevelCodecFile_read(f, discard, (unsigned)chunk) != (int)chunk) return 0;
         remaining -= chunk;
     }
     return 1;
 }
 
-bool Level_load(Level* level) {
-    gzFile f = gzopen("server_level.dat", "rb");
+// reads server_level.dat: info and a malloc'd *blocksOut, or false if
+// it's missing or not a save this port understands
+static bool readJavaFile(LevelFileInfo* info, byte** blocksOut) {
+    LevelCodecFile* f = LevelCodecFile_openRead(LEVEL_SAVE_PATH);
     if (!f) return false;
 
     unsigned char header[sizeof LEVEL_HEADER_TEMPLATE];
-    if (gzread(f, header, sizeof header) != (int)sizeof header ||
+    if (LevelCodecFile_read(f, header, sizeof header) != (int)sizeof header ||
         memcmp(header, LEVEL_HEADER_TEMPLATE, sizeof header) != 0) {
-        gzclose(f);
+        LevelCodecFile_close(f);
         return false;
     }
 
-    long long createTime;
-    int depth, height, tickCount, unprocessed, width, xSpawn, ySpawn, zSpawn;
-    float rotSpawn;
-    if (!readJavaLong(f, &createTime)  || !readJavaInt(f, &depth)   ||
-        !readJavaInt(f, &height)       || !readJavaFloat(f, &rotSpawn) ||
-        !readJavaInt(f, &tickCount)    || !readJavaInt(f, &unprocessed) ||
-        !readJavaInt(f, &width)        || !readJavaInt(f, &xSpawn)  ||
-        !readJavaInt(f, &ySpawn)       || !readJavaInt(f, &zSpawn)) {
-        gzclose(f);
+    if (!readJavaLong(f, &info->createTime)  || !readJavaInt(f, &info->depth)   ||
+        !readJavaInt(f, &info->height)       || !readJavaFloat(f, &info->rotSpawn) ||
+        !readJavaInt(f, &info->tickCount)    || !readJavaInt(f, &info->unprocessed) ||
+        !readJavaInt(f, &info->width)        || !readJavaInt(f, &info->xSpawn)  ||
+        !readJavaInt(f, &info->ySpawn)       || !readJavaInt(f, &info->zSpawn)) {
+        LevelCodecFile_close(f);
         return false;
     }
 
     unsigned char blocksHeader[sizeof BLOCKS_ARRAY_HEADER];
     int blockCount;
-    if (gzread(f, blocksHeader, sizeof blocksHeader) != (int)sizeof blocksHeader ||
+    if (LevelCodecFile_read(f, blocksHeader, sizeof blocksHeader) != (int)sizeof blocksHeader ||
         memcmp(blocksHeader, BLOCKS_ARRAY_HEADER, sizeof blocksHeader) != 0 ||
-        !readJavaInt(f, &blockCount) || blockCount != width * height * depth) {
-        gzclose(f);
+        !readJavaInt(f, &blockCount) || blockCount != info->width * info->height * info->depth) {
+        LevelCodecFile_close(f);
         return false;
     }
 
     size_t total = (size_t)blockCount;
     byte* blocks = (byte*)malloc(total);
-    if (!blocks || gzread(f, blocks, (unsigned)total) != (int)total) {
+    if (!blocks || LevelCodecFile_read(f, blocks, (unsigned)total) != (int)total) {
         free(blocks);
-        gzclose(f);
+        LevelCodecFile_close(f);
         return false;
     }
 
-    char creator[64], name[64];
-    if (!readJavaString(f, creator, sizeof creator)) {
-        free(blocks); gzclose(f); return false;
+    if (!readJavaString(f, info->creator, sizeof info->creator)) {
+        free(blocks); LevelCodecFile_close(f); return false;
     }
 
     // entities: skip past the ArrayList object rather than assuming it's
@@ -411,14 +669,14 @@ bool Level_load(Level* level) {
     // still parses correctly (their contents are just not imported, nothing
     // in this port reads Level.entities for anything)
     unsigned char entitiesTag;
-    if (gzread(f, &entitiesTag, 1) != 1 || entitiesTag != 0x73) { free(blocks); gzclose(f); return false; }
+    if (LevelCodecFile_read(f, &entitiesTag, 1) != 1 || entitiesTag != 0x73) { free(blocks); LevelCodecFile_close(f); return false; }
     // ArrayList's class descriptor (TC_CLASSDESC through TC_NULL), the tag
     // byte just read excluded: 42 bytes, verified directly against
     // EMPTY_ENTITIES_TEMPLATE's own layout, not a derived/computed size
     unsigned char skipBuf[42];
-    if (gzread(f, skipBuf, sizeof skipBuf) != (int)sizeof skipBuf) { free(blocks); gzclose(f); return false; }
+    if (LevelCodecFile_read(f, skipBuf, sizeof skipBuf) != (int)sizeof skipBuf) { free(blocks); LevelCodecFile_close(f); return false; }
     int entitySize;
-    if (!readJavaInt(f, &entitySize)) { free(blocks); gzclose(f); return false; }
+    if (!readJavaInt(f, &entitySize)) { free(blocks); LevelCodecFile_close(f); return false; }
     (void)entitySize; // consumed to advance the stream, not stored anywhere
 
     // only handles the short block form (TC_BLOCKDATASHORT, <256 bytes of
@@ -427,46 +685,118 @@ bool Level_load(Level* level) {
     // would appear here instead for a real save with enough entities to
     // exceed that, and isn't handled
     unsigned char blockTag, blockLen;
-    if (gzread(f, &blockTag, 1) != 1 || blockTag != 0x77 || gzread(f, &blockLen, 1) != 1) {
-        free(blocks); gzclose(f); return false;
+    if (LevelCodecFile_read(f, &blockTag, 1) != 1 || blockTag != 0x77 || LevelCodecFile_read(f, &blockLen, 1) != 1) {
+        free(blocks); LevelCodecFile_close(f); return false;
     }
     char blockDiscard[256];
-    if (blockLen > 0 && gzread(f, blockDiscard, blockLen) != blockLen) { free(blocks); gzclose(f); return false; }
+    if (blockLen > 0 && LevelCodecFile_read(f, blockDiscard, blockLen) != blockLen) { free(blocks); LevelCodecFile_close(f); return false; }
     unsigned char endTag;
-    if (gzread(f, &endTag, 1) != 1 || endTag != 0x78) { free(blocks); gzclose(f); return false; }
+    if (LevelCodecFile_read(f, &endTag, 1) != 1 || endTag != 0x78) { free(blocks); LevelCodecFile_close(f); return false; }
 
-    if (!readJavaString(f, name, sizeof name)) {
-        free(blocks); gzclose(f); return false;
+    if (!readJavaString(f, info->name, sizeof info->name)) {
+        free(blocks); LevelCodecFile_close(f); return false;
     }
-    gzclose(f);
+    LevelCodecFile_close(f);
 
-    free(level->blocks);
-    free(level->lightDepths);
+    *blocksOut = blocks;
+    return true;
+}
+
+// modification time of path, false if it isn't there
+static bool fileTime(const char* path, time_t* out) {
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+    *out = st.st_mtime;
+    return true;
+}
+
+bool Level_load(Level* level) {
+    // not in the real source: either format loads, the newer file if both
+    // are there, the configured one on a tie (see level_native.h)
+    time_t javaTime = 0, nativeTime = 0;
+    bool haveJava = fileTime(LEVEL_SAVE_PATH, &javaTime);
+    bool haveNative = fileTime(LEVEL_NATIVE_PATH, &nativeTime);
+    bool native = haveNative && (!haveJava || nativeTime > javaTime || (nativeTime == javaTime && sNativeFormat));
+
+    LevelFileInfo info;
+    byte* blocks = NULL;
+    void* mapping = NULL;
+    size_t mappingLen = 0;
+    bool ok = native ? LevelNative_open(LEVEL_NATIVE_PATH, &info, &blocks, &mapping, &mappingLen)
+                     : readJavaFile(&info, &blocks);
+    if (!ok && haveJava && haveNative) {
+        // the chosen one is unreadable, the other may still be good
+        native = !native;
+        ok = native ? LevelNative_open(LEVEL_NATIVE_PATH, &info, &blocks, &mapping, &mappingLen)
+                    : readJavaFile(&info, &blocks);
+    }
+    if (!ok) return false;
 
-    level->width = width; level->height = height; level->depth = depth;
+    bool packed = dropSections(level);
+    freeBlocks(level);
+
+    level->width = info.width; level->height = info.height; level->depth = info.depth;
     level->blocks = blocks;
-    memcpy(level->name, name, sizeof(level->name));
-    memcpy(level->creator, creator, sizeof(level->creator));
-    level->createTime = createTime;
-    level->xSpawn = xSpawn; level->ySpawn = ySpawn; level->zSpawn = zSpawn;
-    level->rotSpawn = rotSpawn;
-    level->tickCount = tickCount;
-    level->unprocessed = unprocessed;
-
-    level->lightDepths = (int*)malloc((size_t)width * height * sizeof(int));
-    if (!level->lightDepths) {
-        Log_severe("Failed to allocate level memory");
-        exit(EXIT_FAILURE);
+    level->blocksMapping = mapping;
+    level->blocksMappingLen = mappingLen;
+    memcpy(level->name, info.name, sizeof(level->name));
+    memcpy(level->creator, info.creator, sizeof(level->creator));
+    level->createTime = info.createTime;
+    level->xSpawn = info.xSpawn; level->ySpawn = info.ySpawn; level->zSpawn = info.zSpawn;
+    level->rotSpawn = info.rotSpawn;
+    level->tickCount = info.tickCount;
+    level->unprocessed = info.unprocessed;
+    level->changeGeneration++;
+
+    long long replayed = BlockJournal_replay(level);
+    if (replayed > 0) Log_info("Replayed %lld journaled block changes", replayed);
+
+    allocLightDepths(level);
+    rebuildSpongeNear(level);
+    calcLightDepths(level, 0, 0, info.width, info.height);
+
+    if (native != sNativeFormat) {
+        // written straight away, so the next start loads the new format
+        // even if nothing changes before then
+        Log_info("Converting %s to %s", native ? LEVEL_NATIVE_PATH : LEVEL_SAVE_PATH,
+                 sNativeFormat ? LEVEL_NATIVE_PATH : LEVEL_SAVE_PATH);
+        if (!writeSaveFile(level)) Log_warn("Failed to convert the level");
     }
+    if (packed) Level_packSections(level, replayed == 0 && native == sNativeFormat);
 
     return true;
 }
 
-void Level_save(const Level* level) {
-    gzFile f = gzopen("server_level.dat", "wb");
-    if (!f) return;
+// a save is written to a temp file next to the real one and only renamed
+// over it once it's fully written, synced to disk and closed, so a crash
+// or full disk mid-save leaves the previous save intact instead of a
+// truncated one. The rename itself is synced too before this returns true:
+// the rotated journal is deleted right after, and until the directory
+// entry is on disk that journal is the only durable copy of its edits
+static bool replaceFile(bool written, const char* temp, const char* path) {
+    if (!written) {
+        remove(temp);
+        return false;
+    }
+#if defined(_WIN32)
+    // plain rename() refuses to replace an existing file on Windows, and
+    // write-through makes it return only once the move is on disk
+    return MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(temp, path) != 0) return false;
+    int dir = open(".", O_RDONLY);
+    if (dir < 0) return false;
+    bool synced = fsync(dir) == 0;
+    close(dir);
+    return synced;
+#endif
+}
+
+static bool writeLevelFile(const Level* level) {
+    LevelCodecFile* f = LevelCodecFile_openWrite(LEVEL_SAVE_TEMP_PATH, sSaveCodec, sSaveLevel);
+    if (!f) return false;
 
-    gzwrite(f, LEVEL_HEADER_TEMPLATE, sizeof LEVEL_HEADER_TEMPLATE);
+    LevelCodecFile_write(f, LEVEL_HEADER_TEMPLATE, sizeof LEVEL_HEADER_TEMPLATE);
 
     writeJavaLong(f, level->createTime);
     writeJavaInt(f, level->depth);
@@ -479,16 +809,201 @@ void Level_save(const Level* level) {
     writeJavaInt(f, level->ySpawn);
     writeJavaInt(f, level->zSpawn);
 
-    gzwrite(f, BLOCKS_ARRAY_HEADER, sizeof BLOCKS_ARRAY_HEADER);
+    LevelCodecFile_write(f, BLOCKS_ARRAY_HEADER, sizeof BLOCKS_ARRAY_HEADER);
     size_t total = (size_t)level->width * level->height * level->depth;
     writeJavaInt(f, (int)total);
-    gzwrite(f, level->blocks, (unsigned)total);
+    bool ok = true;
+    if (level->blocks) {
+        LevelCodecFile_write(f, level->blocks, (unsigned)total);
+    } else {
+        byte* row = (byte*)malloc((size_t)level->width);
+        ok = row != NULL;
+        for (int y = 0; y < level->depth && ok; y++)
+            for (int z = 0; z < level->height && ok; z++) {
+                LevelSections_copyRow(level->sections, y, z, row);
+                LevelCodecFile_write(f, row, (unsigned)level->width);
+            }
+        free(row);
+    }
 
     writeJavaString(f, level->creator);
-    gzwrite(f, EMPTY_ENTITIES_TEMPLATE, sizeof EMPTY_ENTITIES_TEMPLATE);
+    LevelCodecFile_write(f, EMPTY_ENTITIES_TEMPLATE, sizeof EMPTY_ENTITIES_TEMPLATE);
     writeJavaString(f, level->name);
 
-    gzclose(f);
+    if (!LevelCodecFile_close(f)) ok = false;
+    return replaceFile(ok, LEVEL_SAVE_TEMP_PATH, LEVEL_SAVE_PATH);
+}
+
+// the configured format's file, written the same temp-then-rename way
+static bool writeSaveFile(const Level* level) {
+    if (!sNativeFormat) return writeLevelFile(level);
+    return replaceFile(LevelNative_write(LEVEL_NATIVE_TEMP_PATH, level), LEVEL_NATIVE_TEMP_PATH, LEVEL_NATIVE_PATH);
+}
+
+void Level_useNativeFormat(bool native) {
+    sNativeFormat = native;
+}
+
+void Level_setSaveCodec(int codec, int level) {
+    sSaveCodec = codec;
+    sSaveLevel = level;
+}
+
+bool Level_save(const Level* level) {
+    BlockJournal_rotate(level->journal);
+    if (!writeSaveFile(level)) {
+        Log_warn("Failed to save level");
+        return false;
+    }
+    BlockJournal_discardRotated();
+    return true;
+}
+
+/* background autosave */
+
+// true from Level_saveAsync handing off a snapshot until the writer thread
+// has finished with it. Guarded by sSaveLock
+static bool sSaveInProgress = false;
+static int sSavesFinished = 0;
+// the section dirty flags the running save's snapshot cleared, freed once
+// it's written. Left set by a failed save, for the next Level_saveAsync to
+// put back. Also guarded by sSaveLock while a save is running
+static unsigned char* sSaveDirty = NULL;
+static int sSaveDirtyCount = 0;
+
+#if defined(_WIN32)
+static CRITICAL_SECTION sSaveLock;
+static int sSaveLockInited = 0;
+#else
+static pthread_mutex_t sSaveLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void saveLock(void) {
+#if defined(_WIN32)
+    if (!sSaveLockInited) { InitializeCriticalSection(&sSaveLock); sSaveLockInited = 1; }
+    EnterCriticalSection(&sSaveLock);
+#else
+    pthread_mutex_lock(&sSaveLock);
+#endif
+}
+static void saveUnlock(void) {
+#if defined(_WIN32)
+    LeaveCriticalSection(&sSaveLock);
+#else
+    pthread_mutex_unlock(&sSaveLock);
+#endif
+}
+
+// snapshot is a shallow Level copy owning its own blocks copy, and
+// nothing else (lightDepths, the tick queue and the
+// other derived arrays are cleared, a save never reads them)
+static void runSave(Level* snapshot) {
+    // the journal was already rotated when this snapshot was taken
+    bool saved = writeSaveFile(snapshot);
+    if (saved) BlockJournal_discardRotated();
+    else Log_warn("Failed to save level");
+    free(snapshot->blocks);
+    free(snapshot);
+
+    saveLock();
+    if (saved) {
+        free(sSaveDirty);
+        sSaveDirty = NULL;
+    }
+    sSaveInProgress = false;
+    sSavesFinished++;
+    saveUnlock();
+}
+
+bool Level_isSaving(void) {
+    saveLock();
+    bool saving = sSaveInProgress;
+    saveUnlock();
+    return saving;
+}
+
+int Level_savesFinished(void) {
+    saveLock();
+    int finished = sSavesFinished;
+    saveUnlock();
+    return finished;
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI saveThreadMain(LPVOID arg) { runSave((Level*)arg); return 0; }
+#else
+static void* saveThreadMain(void* arg) { runSave((Level*)arg); return NULL; }
+#endif
+
+bool Level_saveAsync(const Level* level) {
+    saveLock();
+    bool busy = sSaveInProgress;
+    if (!busy) sSaveInProgress = true;
+    saveUnlock();
+    if (busy) return false;
+
+    // the last save failed: what it would have written is still unsaved
+    if (sSaveDirty) {
+        if (level->sections) LevelSections_restoreDirty(level->sections, sSaveDirty, sSaveDirtyCount);
+        free(sSaveDirty);
+        sSaveDirty = NULL;
+    }
+
+    // a packed level knows which sections changed: with none, the file on
+    // disk is already current and there's nothing to copy or write
+    if (level->sections && LevelSections_countDirty(level->sections) == 0) {
+        saveLock();
+        sSaveInProgress = false;
+        saveUnlock();
+        return true;
+    }
+
+    size_t total = (size_t)level->width * level->height * level->depth;
+    Level* snapshot = (Level*)malloc(sizeof *snapshot);
+    byte* blocks = snapshot ? (byte*)malloc(total) : NULL;
+    // cleared now, as later edits aren't in this snapshot, but kept until
+    // it's written in case it never is
+    unsigned char* dirty = blocks && level->sections ? LevelSections_takeDirty(level->sections) : NULL;
+    if (!blocks || (level->sections && !dirty)) {
+        free(blocks);
+        free(snapshot);
+        saveLock();
+        sSaveInProgress = false;
+        saveUnlock();
+        return false;
+    }
+    *snapshot = *level;
+    Level_copyBlocks(level, blocks);
+    if (dirty) {
+        saveLock();
+        sSaveDirty = dirty;
+        sSaveDirtyCount = level->sections->cols * level->sections->rows * level->sections->layers;
+        saveUnlock();
+    }
+    snapshot->blocks = blocks;
+    snapshot->blocksMapping = NULL;
+    snapshot->sections = NULL;
+    snapshot->lightDepths = NULL;
+    snapshot->blockerDepths = NULL;
+    snapshot->spongeNear = NULL;
+    TickQueue_init(&snapshot->tickQueue);
+    snapshot->listener = NULL;
+    snapshot->journal = NULL;
+
+    // everything journaled up to now is in this snapshot
+    BlockJournal_rotate(level->journal);
+
+#if defined(_WIN32)
+    HANDLE h = CreateThread(NULL, 0, saveThreadMain, snapshot, 0, NULL);
+    if (h) { CloseHandle(h); return true; } // detached: nothing needs to join it
+#else
+    pthread_t t;
+    if (pthread_create(&t, NULL, saveThreadMain, snapshot) == 0) { pthread_detach(t); return true; }
+#endif
+
+    // no thread, so save inline rather than skip it altogether
+    runSave(snapshot);
+    return true;
 }
 
 static void notifyNeighborChanged(Level* level, int x, int y, int z, int type) {
@@ -499,13 +1014,22 @@ static void notifyNeighborChanged(Level* level, int x, int y, int z, int type) {
 }
 
 bool level_setTile(Level* level, int x, int y, int z, int type) {
+    if (level->region) return RegionTicks_setTile(level, x, y, z, type, true);
     if (x < 0 || y < 0 || z < 0 || x >= level->width || y >= level->depth || z >= level->height) return false;
 
-    int index = (y * level->height + z) * level->width + x;
-    int oldType = level->blocks[index];
+    int oldType = Level_getTile(level, x, y, z);
     if (oldType == (byte)type) return false;
 
-    level->blocks[index] = (byte)type;
+    if (!Level_storeTile(level, x, y, z, type)) return false;
+    Level_finishSetTile(level, x, y, z, oldType, type);
+    return true;
+}
+
+void Level_finishSetTile(Level* level, int x, int y, int z, int oldType, int type) {
+    level->changeGeneration++;
+    if (level->journal) BlockJournal_append(level->journal, x, y, z, type, level->tickCount);
+    noteSponge(level, x, y, z, oldType, type);
+    updateLightColumn(level, x, y, z);
 
     const Tile* oldTile = (oldType >= 0 && oldType < 256) ? gTiles[oldType] : NULL;
     if (oldTile && oldTile->onRemoved) oldTile->onRemoved(oldTile, level, x, y, z);
@@ -519,25 +1043,46 @@ bool level_setTile(Level* level, int x, int y, int z, int type) {
     notifyNeighborChanged(level, x, y, z - 1, type);
     notifyNeighborChanged(level, x, y, z + 1, type);
 
-    calcLightDepths(level, x, z, 1, 1);
+    relightColumn(level, x, z);
     if (level->listener) level->listener(level->listenerCtx, x, y, z);
-    return true;
 }
 
 void Level_updateNeighborsAt(Level* level, int x, int y, int z) {
     notifyNeighborChanged(level, x, y, z, Level_getTile(level, x, y, z));
 }
 
+bool Level_isNearSponge(const Level* level, int x, int y, int z) {
+    if (!level->spongeNear) return false;
+    if (x >= 0 && y >= 0 && z >= 0 && x < level->width && y < level->depth && z < level->height) {
+        const SpongeSection* sec = spongeSectionAt(level, x, y, z);
+        return sec->counts && sec->counts[spongeCellIndex(x, y, z)] > 0;
+    }
+    // off the map only the in-bounds part of the cube can hold one
+    for (int dx = -2; dx <= 2; ++dx)
+    for (int dy = -2; dy <= 2; ++dy)
+    for (int dz = -2; dz <= 2; ++dz) {
+        if (Level_getTile(level, x + dx, y + dy, z + dz) == TILE_SPONGE.id) return true;
+    }
+    return false;
+}
+
 // No neighbor notification, no light recalc. Used by liquid tick reactions
 // to avoid cascading recursion, matching Java exactly, but the listener
 // still fires, since a connected client needs to see this change too even
 // when it doesn't cascade locally (e.g. liquid meeting liquid turning to
-// rock), confirmed against the real server's setTileNoNeighborChange
+// rock), confirmed against the real server's setTileNoNeighborChange.
+// The column's lightDepths stays as it was, as in Java, until its next
+// level_setTile or swap relights it (grass and flowers read it in between)
 bool Level_setTileNoUpdate(Level* level, int x, int y, int z, int type) {
+    if (level->region) return RegionTicks_setTile(level, x, y, z, type, false);
     if (x < 0 || y < 0 || z < 0 || x >= level->width || y >= level->depth || z >= level->height) return false;
-    int index = (y * level->height + z) * level->width + x;
-    if (level->blocks[index] == (byte)type) return false;
-    level->blocks[index] = (byte)type;
+    int oldType = Level_getTile(level, x, y, z);
+    if (oldType == (byte)type) return false;
+    if (!Level_storeTile(level, x, y, z, type)) return false;
+    level->changeGeneration++;
+    if (level->journal) BlockJournal_append(level->journal, x, y, z, type, level->tickCount);
+    noteSponge(level, x, y, z, oldType, type);
+    updateLightColumn(level, x, y, z);
     if (level->listener) level->listener(level->listenerCtx, x, y, z);
     return true;
 }
@@ -545,10 +1090,34 @@ bool Level_setTileNoUpdate(Level* level, int x, int y, int z, int type) {
 int Level_getTile(const Level* level, int x, int y, int z) {
     if (x < 0 || y < 0 || z < 0 || x >= level->width || y >= level->depth || z >= level->height)
         return 0;
+    if (!level->blocks) return LevelSections_get(level->sections, x, y, z);
     int index = (y * level->height + z) * level->width + x;
     return level->blocks[index];
 }
 
+bool Level_storeTile(Level* level, int x, int y, int z, int type) {
+    if (!level->blocks) return LevelSections_set(level->sections, x, y, z, type);
+    level->blocks[(y * level->height + z) * level->width + x] = (byte)type;
+    return true;
+}
+
+bool Level_packSections(Level* level, bool matchesSave) {
+    if (!level->blocks) return true;
+    LevelSections* sections = (LevelSections*)malloc(sizeof *sections);
+    if (!sections || !LevelSections_build(sections, level->blocks, level->width, level->height, level->depth, !matchesSave)) {
+        free(sections);
+        return false;
+    }
+    freeBlocks(level);
+    level->sections = sections;
+    return true;
+}
+
+void Level_copyBlocks(const Level* level, byte* out) {
+    if (level->blocks) memcpy(out, level->blocks, (size_t)level->width * level->height * level->depth);
+    else LevelSections_flatten(level->sections, out);
+}
+
 AABB Level_getTilePickAABB(const Level* level, int x, int y, int z) {
     (void)level;
     return AABB_create(x, y, z, x+1, y+1, z+1);
@@ -629,42 +1198,44 @@ void Level_swap(Level* level, int x1, int y1, int z1, int x2, int y2, int z2) {
     notifyNeighborChanged(level, x2, y2, z2 - 1, a);
     notifyNeighborChanged(level, x2, y2, z2 + 1, a);
 
-    calcLightDepths(level, x1, z1, 1, 1);
-    calcLightDepths(level, x2, z2, 1, 1);
+    relightColumn(level, x1, z1);
+    relightColumn(level, x2, z2);
     if (level->listener) {
         level->listener(level->listenerCtx, x1, y1, z1);
         level->listener(level->listenerCtx, x2, y2, z2);
     }
 }
 
-static void pushTickEntry(Level* level, TickEntry entry) {
-    if (level->tickListSize == level->tickListCapacity) {
-        level->tickListCapacity = level->tickListCapacity ? level->tickListCapacity * 2 : 16;
-        level->tickList = (TickEntry*)realloc(level->tickList, (size_t)level->tickListCapacity * sizeof(TickEntry));
-    }
-    level->tickList[level->tickListSize++] = entry;
-}
-
 void Level_addToTickNextTick(Level* level, int x, int y, int z, int tileId) {
+    if (level->region) {
+        RegionTicks_schedule(level, x, y, z, tileId);
+        return;
+    }
     TickEntry e = { x, y, z, tileId, 0 };
     if (tileId > 0 && tileId < 256 && gTiles[tileId]) e.delay = gTiles[tileId]->tickDelay;
-    pushTickEntry(level, e);
+    if (!TickQueue_push(&level->tickQueue, e)) Log_warn("Out of memory queueing a tile tick, dropped it");
 }
 
 void Level_onTick(Level* level) {
+    Level_runTickList(level);
+    Level_runRandomTicks(level);
+}
+
+void Level_runTickList(Level* level) {
     level->tickCount++;
 
-    if (level->tickCount % 5 == 0 && level->tickListSize > 0) {
-        int n = level->tickListSize;
+    if (level->tickCount % 5 == 0) {
         // drain the queue snapshot from the front, matching the Java
         // ArrayList.remove(0) fifo drain of everything queued so far. An
         // entry still delayed (lava) gets decremented and pushed back to
         // the tail instead of firing.
+        int n = level->tickQueue.count;
         for (int i = 0; i < n; ++i) {
-            TickEntry e = level->tickList[i];
+            TickEntry e;
+            TickQueue_pop(&level->tickQueue, &e);
             if (e.delay > 0) {
                 e.delay--;
-                pushTickEntry(level, e);
+                TickQueue_push(&level->tickQueue, e); // can't fail, the pop made room
                 continue;
             }
             if (e.x < 0 || e.y < 0 || e.z < 0 || e.x >= level->width || e.y >= level->depth || e.z >= level->height) continue;
@@ -674,10 +1245,11 @@ void Level_onTick(Level* level) {
                 if (t && t->onTick) t->onTick(t, level, e.x, e.y, e.z);
             }
         }
-        int remaining = level->tickListSize - n;
-        memmove(level->tickList, level->tickList + n, (size_t)remaining * sizeof(TickEntry));
-        level->tickListSize = remaining;
     }
+}
+
+void Level_runRandomTicks(Level* level) {
+    if (RegionTicks_run(level)) return;
 
     level->unprocessed += level->width * level->height * level->depth;
     int ticks = level->unprocessed / 200; // c0.0.13a halved TILE_UPDATE_INTERVAL from 400
@@ -701,4 +1273,8 @@ void Level_onTick(Level* level) {
         const Tile* t = (id >= 0 && id < 256) ? gTiles[id] : NULL;
         if (t && t->onTick) t->onTick(t, level, x, y, z);
     }
-}
\ No newline at end of file
+}
+int Level_random(Level* level) {
+    if (level->region) return RegionTicks_random(level);
+    return rand();
+}
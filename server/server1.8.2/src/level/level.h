@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "../phys/aabb.h"
+#include "tick_queue.h"
 #include <math.h>
 
 typedef unsigned char byte;
@@ -19,19 +20,18 @@ typedef unsigned char byte;
 // MinecraftServer instance per Level, so a single callback slot is enough
 typedef void (*LevelBlockChangeListener)(void* ctx, int x, int y, int z);
 
-// a pending liquid/gravity-tile reaction scheduled for a future tick, see
-// Level_addToTickNextTick. delay is extra 5-tick drain cycles to wait before
-// firing (c0.0.16a_02, lava only, see Tile.tickDelay).
-typedef struct {
-    int x, y, z;
-    int tileId;
-    int delay;
-} TickEntry;
-
 typedef struct Level {
     int   width, height, depth;
+    // NULL once Level_packSections has moved the blocks into sections
     byte* blocks;
+    // one above each column's highest light blocker, as of the column's
+    // last level_setTile or swap: like the real source, no-update writes
+    // leave it stale until then, and Level_isLit answers from it
     int*  lightDepths;
+    // not in the real source: the same depths kept exact through every
+    // write (shares lightDepths' allocation), so bringing a column's light
+    // up to date is a copy rather than a rescan
+    int*  blockerDepths;
     LevelBlockChangeListener listener;
     void* listenerCtx;
     int unprocessed;
@@ -50,9 +50,43 @@ typedef struct Level {
     unsigned int tickRandom;
     int tickCount;
 
-    TickEntry* tickList;
-    int tickListSize;
-    int tickListCapacity;
+    // pending liquid/gravity-tile reactions, see Level_addToTickNextTick
+    TickQueue tickQueue;
+
+    // not in the real source: per cell, how many Sponges sit within the
+    // 5x5x5 cube around it, kept up to date on every block write so the
+    // liquid spread check is one lookup instead of a 125 cell scan. Split
+    // into the same 16x16x16 sections as level_sections.h, each with its
+    // counts only allocated while a sponge is near it. NULL while the
+    // level has no sponges at all
+    struct SpongeSection* spongeNear;
+    int spongeCount;
+
+    // not in the real source: set only on a region tick worker's own copy
+    // of the Level, routing its writes through region_ticks.c. NULL on the
+    // real one
+    struct RegionTickContext* region;
+
+    // not in the real source: bumped on every actual block write (and on
+    // load/regenerate), so anything derived from the whole block array,
+    // like level_send.c's shared compressed snapshot, can tell cheaply
+    // whether it's still current
+    unsigned int changeGeneration;
+
+    // not in the real source: when set, every real block write is also
+    // appended here (see block_journal.h). NULL = journaling off
+    struct BlockJournal* journal;
+
+    // not in the real source: the blocks in 16x16x16 sections instead of
+    // the flat array (level-storage=sections), see level_sections.h. NULL
+    // = flat, the default
+    struct LevelSections* sections;
+
+    // not in the real source: set while blocks points into a mapping of
+    // server_level.map (see level_native.h), released with it instead of
+    // freed
+    void* blocksMapping;
+    size_t blocksMappingLen;
 } Level;
 
 typedef struct {
@@ -79,15 +113,56 @@ void  calcLightDepths(Level* level, int minX, int minZ, int maxX, int maxZ);
 
 void  Level_generateMap(Level* level);
 
+// loads server_level.dat or server_level.map, whichever is newer, and
+// rewrites it in the configured format straight away if that differs
 bool  Level_load(Level* level);
-void  Level_save(const Level* level);
+// the format saves are written in: the native, mappable server_level.map
+// (level-format=native) or the real source's server_level.dat (default)
+void  Level_useNativeFormat(bool native);
+// the codec and compression level server_level.dat saves use (save-codec
+// and save-compression), see level_codec.h. gzip at -1 (its default) if
+// never called
+void  Level_setSaveCodec(int codec, int level);
+// synchronous, blocks until server_level.dat is fully rewritten. false if
+// it couldn't be
+bool  Level_save(const Level* level);
+// copies the block array and returns immediately, leaving the gzip and
+// disk write to a background thread, so an autosave doesn't stall the
+// tick loop. Returns false (and saves nothing) if the previous background
+// save hasn't finished yet
+bool  Level_saveAsync(const Level* level);
+// not in the real source: whether a background save is still writing, and
+// how many have finished (written or failed) so far, for save metrics
+bool  Level_isSaving(void);
+int   Level_savesFinished(void);
 
 bool  level_setTile(Level* level, int x, int y, int z, int type);
+// everything level_setTile does after the block itself is written (from
+// oldType to type): journal, neighbor notifications, light, listener. For
+// region ticks, which write the block on a worker and finish it later
+void  Level_finishSetTile(Level* level, int x, int y, int z, int oldType, int type);
 bool  Level_setTileNoUpdate(Level* level, int x, int y, int z, int type);
 int   Level_getTile(const Level* level, int x, int y, int z);
+// just stores the block, in whichever layout the level uses: no journal,
+// light, notifications or listener. (x, y, z) must be in bounds. false if
+// storing it needed memory that wasn't there. For region ticks, which
+// finish the rest later through Level_finishSetTile
+bool  Level_storeTile(Level* level, int x, int y, int z, int type);
+
+// moves the blocks into 16x16x16 sections and frees the flat array.
+// Sections start out dirty unless matchesSave (the level was just loaded
+// and nothing changed since). Level_load and Level_resize keep a packed
+// level packed. false (and still flat) if out of memory
+bool  Level_packSections(Level* level, bool matchesSave);
+// the whole block array in the flat layout, width*height*depth bytes,
+// whichever layout the level actually uses
+void  Level_copyBlocks(const Level* level, byte* out);
+
 // server1.6: re-runs neighborChanged at (x,y,z) without touching the block
 // there, added for Sponge's onRemoved to re-trigger nearby water flow
 void  Level_updateNeighborsAt(Level* level, int x, int y, int z);
+// server1.6: true if a Sponge exists within the 5x5x5 cube centered on (x,y,z)
+bool  Level_isNearSponge(const Level* level, int x, int y, int z);
 
 AABB Level_getTilePickAABB(const Level* level, int x, int y, int z);
 
@@ -98,6 +173,15 @@ bool  Level_containsAnyLiquid(const Level* level, const AABB* box);
 bool  Level_containsLiquid(const Level* level, const AABB* box, int liquidId);
 
 void  Level_onTick(Level* level);
+// Level_onTick's two halves, in the order it runs them: every 5th tick the
+// scheduled tile ticks due, then the random ones. Not in the real source,
+// split so the server can time each on its own (see tick_profiler.h).
+// Level_runTickList bumps tickCount, so call it even on ticks it skips
+void  Level_runTickList(Level* level);
+void  Level_runRandomTicks(Level* level);
+// the random number source for tile reactions, rand() except on a region
+// tick worker, where it's that region's own stream
+int   Level_random(Level* level);
 
 int   Level_getHighestTile(const Level* level, int x, int z);
 float Level_getGroundLevel(const Level* level);
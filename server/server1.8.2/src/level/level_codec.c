@@ -0,0 +1,537 @@
+// level/level_codec.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "level_codec.h"
+#include "../log.h"
+#include <zlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(HAVE_ZSTD)
+  #include <zstd.h>
+#endif
+#if defined(HAVE_LZ4)
+  #include <lz4frame.h>
+#endif
+
+#if defined(_WIN32)
+  #include <windows.h>
+  #include <io.h>
+#else
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+// file buffer size for the zstd and LZ4 streams, either direction
+#define CODEC_CHUNK (64 * 1024)
+
+static const char* const CODEC_NAMES[LEVEL_CODEC_COUNT] = { "gzip", "zstd", "lz4" };
+
+const char* LevelCodec_name(int codec) {
+    return (codec >= 0 && codec < LEVEL_CODEC_COUNT) ? CODEC_NAMES[codec] : "?";
+}
+
+int LevelCodec_byName(const char* name) {
+    for (int i = 0; i < LEVEL_CODEC_COUNT; i++) {
+        if (strcmp(name, CODEC_NAMES[i]) == 0) return i;
+    }
+    return -1;
+}
+
+bool LevelCodec_available(int codec) {
+    switch (codec) {
+        case LEVEL_CODEC_GZIP: return true;
+#if defined(HAVE_ZSTD)
+        case LEVEL_CODEC_ZSTD: return true;
+#endif
+#if defined(HAVE_LZ4)
+        case LEVEL_CODEC_LZ4: return true;
+#endif
+        default: return false;
+    }
+}
+
+int LevelCodec_clampLevel(int codec, int level) {
+    switch (codec) {
+        case LEVEL_CODEC_GZIP:
+            return (level < 0 || level > 9) ? 6 : level; // 6 = Z_DEFAULT_COMPRESSION
+#if defined(HAVE_ZSTD)
+        case LEVEL_CODEC_ZSTD:
+            return (level < 1 || level > ZSTD_maxCLevel()) ? ZSTD_CLEVEL_DEFAULT : level;
+#endif
+        case LEVEL_CODEC_LZ4:
+            return (level < 0 || level > 12) ? 0 : level;
+        default:
+            return level;
+    }
+}
+
+struct LevelCodecFile {
+    int codec;
+    bool failed;
+    bool writing;
+    gzFile gz;  // gzip
+    FILE* fp;   // the others, through buf. Written gzip files have one
+                // too, only to sync it to disk before closing
+    unsigned char* buf;
+    size_t bufCapacity, bufPos, bufLen;
+#if defined(HAVE_ZSTD)
+    ZSTD_CStream* zc;
+    ZSTD_DStream* zd;
+#endif
+#if defined(HAVE_LZ4)
+    LZ4F_cctx* lc;
+    LZ4F_dctx* ld;
+#endif
+};
+
+static void freeFile(LevelCodecFile* f) {
+#if defined(HAVE_ZSTD)
+    if (f->zc) ZSTD_freeCStream(f->zc);
+    if (f->zd) ZSTD_freeDStream(f->zd);
+#endif
+#if defined(HAVE_LZ4)
+    if (f->lc) LZ4F_freeCompressionContext(f->lc);
+    if (f->ld) LZ4F_freeDecompressionContext(f->ld);
+#endif
+    free(f->buf);
+    free(f);
+}
+
+// true once everything written to f is on the disk itself, not just
+// handed to the OS
+static bool syncToDisk(FILE* f) {
+    if (fflush(f) != 0) return false;
+#if defined(_WIN32)
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+static void putBytes(LevelCodecFile* f, const void* data, size_t len) {
+    if (len > 0 && fwrite(data, 1, len, f->fp) != len) f->failed = true;
+}
+#endif
+
+LevelCodecFile* LevelCodecFile_openRead(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    unsigned char magic[4] = { 0, 0, 0, 0 };
+    size_t got = fread(magic, 1, sizeof magic, fp);
+    rewind(fp);
+
+    int codec = LEVEL_CODEC_GZIP;
+    if (got == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) codec = LEVEL_CODEC_ZSTD;
+    else if (got == 4 && magic[0] == 0x04 && magic[1] == 0x22 && magic[2] == 0x4d && magic[3] == 0x18) codec = LEVEL_CODEC_LZ4;
+    if (!LevelCodec_available(codec)) {
+        Log_warn("%s is %s compressed, which this build can't read", path, LevelCodec_name(codec));
+        fclose(fp);
+        return NULL;
+    }
+
+    LevelCodecFile* f = (LevelCodecFile*)calloc(1, sizeof *f);
+    if (!f) {
+        fclose(fp);
+        return NULL;
+    }
+    f->codec = codec;
+    if (codec == LEVEL_CODEC_GZIP) {
+        fclose(fp);
+        f->gz = gzopen(path, "rb");
+        if (!f->gz) {
+            freeFile(f);
+            return NULL;
+        }
+        return f;
+    }
+
+    f->fp = fp;
+    f->bufCapacity = CODEC_CHUNK;
+    f->buf = (unsigned char*)malloc(f->bufCapacity);
+    bool ok = f->buf != NULL;
+#if defined(HAVE_ZSTD)
+    if (ok && codec == LEVEL_CODEC_ZSTD) {
+        f->zd = ZSTD_createDStream();
+        ok = f->zd && !ZSTD_isError(ZSTD_initDStream(f->zd));
+    }
+#endif
+#if defined(HAVE_LZ4)
+    if (ok && codec == LEVEL_CODEC_LZ4) ok = !LZ4F_isError(LZ4F_createDecompressionContext(&f->ld, LZ4F_VERSION));
+#endif
+    if (!ok) {
+        fclose(fp);
+        freeFile(f);
+        return NULL;
+    }
+    return f;
+}
+
+LevelCodecFile* LevelCodecFile_openWrite(const char* path, int codec, int level) {
+    if (!LevelCodec_available(codec)) return NULL;
+    level = LevelCodec_clampLevel(codec, level);
+    LevelCodecFile* f = (LevelCodecFile*)calloc(1, sizeof *f);
+    if (!f) return NULL;
+    f->codec = codec;
+    f->writing = true;
+
+    f->fp = fopen(path, "wb");
+    if (!f->fp) {
+        freeFile(f);
+        return NULL;
+    }
+    if (codec == LEVEL_CODEC_GZIP) {
+        // zlib closes the descriptor it's given, so it gets its own copy
+        char mode[8];
+        snprintf(mode, sizeof mode, "wb%d", level);
+#if defined(_WIN32)
+        int fd = _dup(_fileno(f->fp));
+#else
+        int fd = dup(fileno(f->fp));
+#endif
+        f->gz = fd >= 0 ? gzdopen(fd, mode) : NULL;
+        if (!f->gz) {
+#if defined(_WIN32)
+            if (fd >= 0) _close(fd);
+#else
+            if (fd >= 0) close(fd);
+#endif
+            fclose(f->fp);
+            freeFile(f);
+            return NULL;
+        }
+        return f;
+    }
+    bool ok = true;
+#if defined(HAVE_ZSTD)
+    if (codec == LEVEL_CODEC_ZSTD) {
+        f->bufCapacity = ZSTD_CStreamOutSize();
+        f->zc = ZSTD_createCStream();
+        ok = f->zc && !ZSTD_isError(ZSTD_initCStream(f->zc, level));
+    }
+#endif
+#if defined(HAVE_LZ4)
+    LZ4F_preferences_t prefs;
+    if (codec == LEVEL_CODEC_LZ4) {
+        memset(&prefs, 0, sizeof prefs);
+        prefs.compressionLevel = level;
+        // room for the frame header, and for whatever one CODEC_CHUNK
+        // sized write (or the final flush) turns into
+        f->bufCapacity = LZ4F_compressBound(CODEC_CHUNK, &prefs) + LZ4F_HEADER_SIZE_MAX;
+        ok = !LZ4F_isError(LZ4F_createCompressionContext(&f->lc, LZ4F_VERSION));
+    }
+#endif
+    f->buf = ok ? (unsigned char*)malloc(f->bufCapacity) : NULL;
+    ok = ok && f->buf != NULL;
+#if defined(HAVE_LZ4)
+    if (ok && codec == LEVEL_CODEC_LZ4) {
+        size_t n = LZ4F_compressBegin(f->lc, f->buf, f->bufCapacity, &prefs);
+        ok = !LZ4F_isError(n);
+        if (ok) putBytes(f, f->buf, n);
+    }
+#endif
+    if (!ok) {
+        fclose(f->fp);
+        freeFile(f);
+        return NULL;
+    }
+    return f;
+}
+
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+// refills buf from the file once it's used up. false at the end of it
+static bool fillInput(LevelCodecFile* f) {
+    if (f->bufPos < f->bufLen) return true;
+    f->bufPos = 0;
+    f->bufLen = fread(f->buf, 1, f->bufCapacity, f->fp);
+    return f->bufLen > 0;
+}
+#endif
+
+int LevelCodecFile_read(LevelCodecFile* f, void* buf, unsigned len) {
+    if (f->codec == LEVEL_CODEC_GZIP) return gzread(f->gz, buf, len);
+    if (f->failed) return 0;
+
+    size_t produced = 0;
+#if defined(HAVE_ZSTD)
+    if (f->codec == LEVEL_CODEC_ZSTD) {
+        ZSTD_outBuffer out = { buf, len, 0 };
+        while (out.pos < out.size && fillInput(f)) {
+            ZSTD_inBuffer in = { f->buf, f->bufLen, f->bufPos };
+            size_t r = ZSTD_decompressStream(f->zd, &out, &in);
+            f->bufPos = in.pos;
+            if (ZSTD_isError(r)) {
+                f->failed = true;
+                break;
+            }
+        }
+        produced = out.pos;
+    }
+#endif
+#if defined(HAVE_LZ4)
+    if (f->codec == LEVEL_CODEC_LZ4) {
+        while (produced < len && fillInput(f)) {
+            size_t outSize = len - produced, inSize = f->bufLen - f->bufPos;
+            size_t r = LZ4F_decompress(f->ld, (unsigned char*)buf + produced, &outSize, f->buf + f->bufPos, &inSize, NULL);
+            if (LZ4F_isError(r)) {
+                f->failed = true;
+                break;
+            }
+            f->bufPos += inSize;
+            produced += outSize;
+            if (r == 0 && outSize == 0 && inSize == 0) break; // the frame has ended
+        }
+    }
+#endif
+    return (int)produced;
+}
+
+void LevelCodecFile_write(LevelCodecFile* f, const void* buf, unsigned len) {
+    if (f->codec == LEVEL_CODEC_GZIP) {
+        if (len > 0 && gzwrite(f->gz, buf, len) != (int)len) f->failed = true;
+        return;
+    }
+#if defined(HAVE_ZSTD)
+    if (f->codec == LEVEL_CODEC_ZSTD) {
+        ZSTD_inBuffer in = { buf, len, 0 };
+        while (in.pos < in.size && !f->failed) {
+            ZSTD_outBuffer out = { f->buf, f->bufCapacity, 0 };
+            size_t r = ZSTD_compressStream(f->zc, &out, &in);
+            if (ZSTD_isError(r)) f->failed = true;
+            else putBytes(f, f->buf, out.pos);
+        }
+    }
+#endif
+#if defined(HAVE_LZ4)
+    if (f->codec == LEVEL_CODEC_LZ4) {
+        const unsigned char* src = (const unsigned char*)buf;
+        while (len > 0 && !f->failed) {
+            unsigned n = len < CODEC_CHUNK ? len : CODEC_CHUNK;
+            size_t r = LZ4F_compressUpdate(f->lc, f->buf, f->bufCapacity, src, n, NULL);
+            if (LZ4F_isError(r)) f->failed = true;
+            else putBytes(f, f->buf, r);
+            src += n;
+            len -= n;
+        }
+    }
+#endif
+}
+
+bool LevelCodecFile_close(LevelCodecFile* f) {
+    bool ok = !f->failed;
+    if (f->codec == LEVEL_CODEC_GZIP) {
+        if (gzclose(f->gz) != Z_OK) ok = false;
+        if (f->fp) {
+            if (!syncToDisk(f->fp)) ok = false;
+            if (fclose(f->fp) != 0) ok = false;
+        }
+        freeFile(f);
+        return ok;
+    }
+#if defined(HAVE_ZSTD)
+    if (f->zc && ok) {
+        size_t left;
+        do {
+            ZSTD_outBuffer out = { f->buf, f->bufCapacity, 0 };
+            left = ZSTD_endStream(f->zc, &out);
+            if (ZSTD_isError(left)) {
+                f->failed = true;
+                break;
+            }
+            putBytes(f, f->buf, out.pos);
+        } while (left > 0 && !f->failed);
+    }
+#endif
+#if defined(HAVE_LZ4)
+    if (f->lc && ok) {
+        size_t r = LZ4F_compressEnd(f->lc, f->buf, f->bufCapacity, NULL);
+        if (LZ4F_isError(r)) f->failed = true;
+        else putBytes(f, f->buf, r);
+    }
+#endif
+    ok = !f->failed;
+    if (f->writing && ok && !syncToDisk(f->fp)) ok = false;
+    if (fclose(f->fp) != 0) ok = false;
+    freeFile(f);
+    return ok;
+}
+
+/* benchmark */
+
+static double nowSeconds(void) {
+#if defined(_WIN32)
+    static LARGE_INTEGER freq = {0};
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+// one gzip stream of src, the way level_send.c writes it. 0 on failure
+static size_t gzipBuffer(const unsigned char* src, size_t len, unsigned char* dst, size_t capacity, int level, int strategy) {
+    z_stream strm;
+    memset(&strm, 0, sizeof strm);
+    if (deflateInit2(&strm, level, Z_DEFLATED, 15 + 16, 8, strategy) != Z_OK) return 0;
+    strm.next_in = (unsigned char*)src;
+    strm.avail_in = (uInt)len;
+    strm.next_out = dst;
+    strm.avail_out = (uInt)capacity;
+    int r = deflate(&strm, Z_FINISH);
+    size_t out = capacity - strm.avail_out;
+    deflateEnd(&strm);
+    return r == Z_STREAM_END ? out : 0;
+}
+
+static bool gunzipBuffer(const unsigned char* src, size_t len, unsigned char* dst, size_t capacity) {
+    z_stream strm;
+    memset(&strm, 0, sizeof strm);
+    if (inflateInit2(&strm, 15 + 16) != Z_OK) return false;
+    strm.next_in = (unsigned char*)src;
+    strm.avail_in = (uInt)len;
+    strm.next_out = dst;
+    strm.avail_out = (uInt)capacity;
+    int r = inflate(&strm, Z_FINISH);
+    inflateEnd(&strm);
+    return r == Z_STREAM_END;
+}
+
+typedef struct {
+    int codec;
+    int level;
+    int strategy; // gzip only
+    const char* label;
+} BenchCase;
+
+static const BenchCase BENCH_CASES[] = {
+    { LEVEL_CODEC_GZIP, 1, Z_DEFAULT_STRATEGY, "gzip -1" },
+    { LEVEL_CODEC_GZIP, 6, Z_DEFAULT_STRATEGY, "gzip -6 (default)" },
+    { LEVEL_CODEC_GZIP, 9, Z_DEFAULT_STRATEGY, "gzip -9" },
+    { LEVEL_CODEC_GZIP, 6, Z_FILTERED, "gzip -6 filtered" },
+    { LEVEL_CODEC_GZIP, 6, Z_RLE, "gzip -6 rle" },
+    { LEVEL_CODEC_GZIP, 6, Z_HUFFMAN_ONLY, "gzip huffman only" },
+    { LEVEL_CODEC_ZSTD, 1, 0, "zstd -1" },
+    { LEVEL_CODEC_ZSTD, 3, 0, "zstd -3 (default)" },
+    { LEVEL_CODEC_ZSTD, 9, 0, "zstd -9" },
+    { LEVEL_CODEC_ZSTD, 19, 0, "zstd -19" },
+    { LEVEL_CODEC_LZ4, 0, 0, "lz4 (default)" },
+    { LEVEL_CODEC_LZ4, 9, 0, "lz4 -9 (hc)" },
+};
+
+void LevelCodec_benchmark(const unsigned char* blocks, size_t len) {
+    size_t capacity = compressBound((uLong)len) + 1024;
+#if defined(HAVE_ZSTD)
+    if (ZSTD_compressBound(len) > capacity) capacity = ZSTD_compressBound(len);
+#endif
+#if defined(HAVE_LZ4)
+    if (LZ4F_compressFrameBound(len, NULL) > capacity) capacity = LZ4F_compressFrameBound(len, NULL);
+#endif
+    unsigned char* packed = (unsigned char*)malloc(capacity);
+    unsigned char* unpacked = (unsigned char*)malloc(len);
+    if (!packed || !unpacked) {
+        free(packed);
+        free(unpacked);
+        Log_warn("Out of memory for the codec benchmark");
+        return;
+    }
+
+    Log_info("Codec benchmark on %d KB of blocks:", (int)(len / 1024));
+    for (size_t i = 0; i < sizeof BENCH_CASES / sizeof BENCH_CASES[0]; i++) {
+        const BenchCase* c = &BENCH_CASES[i];
+        if (!LevelCodec_available(c->codec)) continue;
+
+        double t0 = nowSeconds();
+        size_t packedLen = 0;
+        if (c->codec == LEVEL_CODEC_GZIP) packedLen = gzipBuffer(blocks, len, packed, capacity, c->level, c->strategy);
+#if defined(HAVE_ZSTD)
+        if (c->codec == LEVEL_CODEC_ZSTD) {
+            size_t r = ZSTD_compress(packed, capacity, blocks, len, c->level);
+            packedLen = ZSTD_isError(r) ? 0 : r;
+        }
+#endif
+#if defined(HAVE_LZ4)
+        LZ4F_preferences_t prefs;
+        memset(&prefs, 0, sizeof prefs);
+        prefs.compressionLevel = c->level;
+        if (c->codec == LEVEL_CODEC_LZ4) {
+            size_t r = LZ4F_compressFrame(packed, capacity, blocks, len, &prefs);
+            packedLen = LZ4F_isError(r) ? 0 : r;
+        }
+#endif
+        double t1 = nowSeconds();
+        if (packedLen == 0) {
+            Log_warn("  %-18s failed to compress", c->label);
+            continue;
+        }
+
+        bool ok = false;
+        if (c->codec == LEVEL_CODEC_GZIP) ok = gunzipBuffer(packed, packedLen, unpacked, len);
+#if defined(HAVE_ZSTD)
+        if (c->codec == LEVEL_CODEC_ZSTD) ok = ZSTD_decompress(unpacked, len, packed, packedLen) == len;
+#endif
+#if defined(HAVE_LZ4)
+        if (c->codec == LEVEL_CODEC_LZ4) {
+            LZ4F_dctx* dctx;
+            if (!LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION))) {
+                size_t outSize = len, inSize = packedLen;
+                ok = LZ4F_decompress(dctx, unpacked, &outSize, packed, &inSize, NULL) == 0 && outSize == len;
+                LZ4F_freeDecompressionContext(dctx);
+            }
+        }
+#endif
+        double t2 = nowSeconds();
+        ok = ok && memcmp(unpacked, blocks, len) == 0;
+
+        double mb = (double)len / (1024.0 * 1024.0);
+        Log_info("  %-18s %7d KB  %5.1f%%  compress %7.1f MB/s  decompress %7.1f MB/s%s",
+                 c->label, (int)(packedLen / 1024), 100.0 * (double)packedLen / (double)len,
+                 mb / (t1 - t0 > 1e-9 ? t1 - t0 : 1e-9), mb / (t2 - t1 > 1e-9 ? t2 - t1 : 1e-9),
+                 ok ? "" : "  MISMATCH");
+    }
+    free(packed);
+    free(unpacked);
+}
+
+typedef struct {
+    unsigned char* blocks;
+    size_t len;
+} BenchJob;
+
+static void runBenchJob(BenchJob* job) {
+    LevelCodec_benchmark(job->blocks, job->len);
+    free(job->blocks);
+    free(job);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI benchThreadMain(LPVOID arg) { runBenchJob((BenchJob*)arg); return 0; }
+#else
+static void* benchThreadMain(void* arg) { runBenchJob((BenchJob*)arg); return NULL; }
+#endif
+
+void LevelCodec_benchmarkAsync(unsigned char* blocks, size_t len) {
+    BenchJob* job = (BenchJob*)malloc(sizeof *job);
+    if (!job) {
+        free(blocks);
+        Log_warn("Out of memory for the codec benchmark");
+        return;
+    }
+    job->blocks = blocks;
+    job->len = len;
+#if defined(_WIN32)
+    HANDLE h = CreateThread(NULL, 0, benchThreadMain, job, 0, NULL);
+    if (h) { CloseHandle(h); return; }
+#else
+    pthread_t t;
+    if (pthread_create(&t, NULL, benchThreadMain, job) == 0) { pthread_detach(t); return; }
+#endif
+    runBenchJob(job);
+}
@@ -0,0 +1,53 @@
+// level/level_codec.h: the compression server_level.dat is written with.
+// Not in the real source, which always gzips it at the default level. The
+// Java serialized contents are the same whichever codec wraps them, and
+// reading sniffs the codec from the file's first bytes, so changing
+// save-codec (or save-compression) only affects saves from then on. Only a
+// gzip save is readable by the real Java server
+//
+// zstd and LZ4 are only there when the build found their headers (the
+// Makefile's ZSTD/LZ4 switches), gzip always is
+
+#ifndef LEVEL_CODEC_H
+#define LEVEL_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum {
+    LEVEL_CODEC_GZIP,
+    LEVEL_CODEC_ZSTD,
+    LEVEL_CODEC_LZ4,
+    LEVEL_CODEC_COUNT
+};
+
+// "gzip", "zstd", "lz4"
+const char* LevelCodec_name(int codec);
+// -1 if name isn't one of the above
+int  LevelCodec_byName(const char* name);
+bool LevelCodec_available(int codec);
+// a compression level the codec accepts: gzip 0..9, zstd 1..its max, LZ4
+// 0..12. -1 (or anything out of range) picks the codec's own default
+int  LevelCodec_clampLevel(int codec, int level);
+
+typedef struct LevelCodecFile LevelCodecFile;
+
+// NULL if path can't be opened (or the codec isn't available)
+LevelCodecFile* LevelCodecFile_openRead(const char* path);
+LevelCodecFile* LevelCodecFile_openWrite(const char* path, int codec, int level);
+// like gzread: bytes actually read, short at the end or on an error
+int  LevelCodecFile_read(LevelCodecFile* f, void* buf, unsigned len);
+void LevelCodecFile_write(LevelCodecFile* f, const void* buf, unsigned len);
+// false if anything written since opening didn't make it to the file
+bool LevelCodecFile_close(LevelCodecFile* f);
+
+// compresses and decompresses blocks with every available codec at a few
+// levels, plus the level transfer's gzip at each deflate strategy, and
+// logs ratio and throughput for each. Takes a while on a big map, so run
+// it off the main thread
+void LevelCodec_benchmark(const unsigned char* blocks, size_t len);
+// the same on a background thread, taking ownership of blocks (a malloc'd
+// copy, freed once it's done). Runs inline if no thread can be started
+void LevelCodec_benchmarkAsync(unsigned char* blocks, size_t len);
+
+#endif
@@ -0,0 +1,179 @@
+// level/level_native.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "level_native.h"
+#include "level.h"
+#include "level_sections.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+  #include <io.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#define NATIVE_MAGIC "MCLV"
+#define NATIVE_VERSION 1
+
+static void putInt(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static unsigned int getInt(const unsigned char* p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void putLong(unsigned char* p, unsigned long long v) {
+    putInt(p, (unsigned int)v);
+    putInt(p + 4, (unsigned int)(v >> 32));
+}
+
+static unsigned long long getLong(const unsigned char* p) {
+    return (unsigned long long)getInt(p) | ((unsigned long long)getInt(p + 4) << 32);
+}
+
+// false if the header isn't one this version wrote
+static bool parseHeader(const unsigned char* h, size_t fileLen, LevelFileInfo* info) {
+    if (memcmp(h, NATIVE_MAGIC, 4) != 0 || getInt(h + 4) != NATIVE_VERSION) return false;
+    info->width = (int)getInt(h + 8);
+    info->height = (int)getInt(h + 12);
+    info->depth = (int)getInt(h + 16);
+    info->xSpawn = (int)getInt(h + 20);
+    info->ySpawn = (int)getInt(h + 24);
+    info->zSpawn = (int)getInt(h + 28);
+    unsigned int rotBits = getInt(h + 32);
+    memcpy(&info->rotSpawn, &rotBits, sizeof rotBits);
+    info->tickCount = (int)getInt(h + 36);
+    info->unprocessed = (int)getInt(h + 40);
+    info->createTime = (long long)getLong(h + 44);
+    memcpy(info->name, h + 52, 64);
+    info->name[63] = '\0';
+    memcpy(info->creator, h + 116, 64);
+    info->creator[63] = '\0';
+
+    if (info->width <= 0 || info->height <= 0 || info->depth <= 0) return false;
+    unsigned long long count = (unsigned long long)info->width * info->height * info->depth;
+    return getLong(h + 180) == count && fileLen >= LEVEL_NATIVE_DATA_OFFSET + count;
+}
+
+#if defined(_WIN32)
+
+// a file mapped on Windows can't be replaced until it's unmapped, which
+// every save does, so the blocks are read in instead. Still no inflate
+bool LevelNative_open(const char* path, LevelFileInfo* info, unsigned char** blocks, void** mapping, size_t* mappingLen) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    unsigned char header[LEVEL_NATIVE_DATA_OFFSET];
+    bool ok = fread(header, 1, sizeof header, f) == sizeof header;
+    long fileLen = 0;
+    if (ok && fseek(f, 0, SEEK_END) == 0) fileLen = ftell(f);
+    ok = ok && fileLen > 0 && parseHeader(header, (size_t)fileLen, info);
+
+    size_t count = ok ? (size_t)info->width * info->height * info->depth : 0;
+    unsigned char* data = ok ? (unsigned char*)malloc(count) : NULL;
+    ok = data && fseek(f, LEVEL_NATIVE_DATA_OFFSET, SEEK_SET) == 0 && fread(data, 1, count, f) == count;
+    fclose(f);
+    if (!ok) {
+        free(data);
+        return false;
+    }
+    *blocks = data;
+    *mapping = NULL;
+    *mappingLen = 0;
+    return true;
+}
+
+void LevelNative_unmap(void* mapping, size_t mappingLen) {
+    (void)mapping;
+    (void)mappingLen;
+}
+
+#else
+
+bool LevelNative_open(const char* path, LevelFileInfo* info, unsigned char** blocks, void** mapping, size_t* mappingLen) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < LEVEL_NATIVE_DATA_OFFSET) {
+        close(fd);
+        return false;
+    }
+    size_t len = (size_t)st.st_size;
+    // private: writes land in copies of the touched pages, never the file
+    void* base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (base == MAP_FAILED) return false;
+
+    if (!parseHeader((const unsigned char*)base, len, info)) {
+        munmap(base, len);
+        return false;
+    }
+    *blocks = (unsigned char*)base + LEVEL_NATIVE_DATA_OFFSET;
+    *mapping = base;
+    *mappingLen = len;
+    return true;
+}
+
+void LevelNative_unmap(void* mapping, size_t mappingLen) {
+    if (mapping) munmap(mapping, mappingLen);
+}
+
+#endif
+
+bool LevelNative_write(const char* path, const Level* level) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+
+    unsigned char header[LEVEL_NATIVE_DATA_OFFSET];
+    memset(header, 0, sizeof header);
+    memcpy(header, NATIVE_MAGIC, 4);
+    putInt(header + 4, NATIVE_VERSION);
+    putInt(header + 8, (unsigned int)level->width);
+    putInt(header + 12, (unsigned int)level->height);
+    putInt(header + 16, (unsigned int)level->depth);
+    putInt(header + 20, (unsigned int)level->xSpawn);
+    putInt(header + 24, (unsigned int)level->ySpawn);
+    putInt(header + 28, (unsigned int)level->zSpawn);
+    unsigned int rotBits;
+    memcpy(&rotBits, &level->rotSpawn, sizeof rotBits);
+    putInt(header + 32, rotBits);
+    putInt(header + 36, (unsigned int)level->tickCount);
+    putInt(header + 40, (unsigned int)level->unprocessed);
+    putLong(header + 44, (unsigned long long)level->createTime);
+    strncpy((char*)header + 52, level->name, 63);
+    strncpy((char*)header + 116, level->creator, 63);
+    size_t count = (size_t)level->width * level->height * level->depth;
+    putLong(header + 180, count);
+    bool ok = fwrite(header, 1, sizeof header, f) == sizeof header;
+
+    if (level->blocks) {
+        ok = ok && fwrite(level->blocks, 1, count, f) == count;
+    } else {
+        unsigned char* row = (unsigned char*)malloc((size_t)level->width);
+        ok = ok && row != NULL;
+        for (int y = 0; y < level->depth && ok; y++)
+            for (int z = 0; z < level->height && ok; z++) {
+                LevelSections_copyRow(level->sections, y, z, row);
+                ok = fwrite(row, 1, (size_t)level->width, f) == (size_t)level->width;
+            }
+        free(row);
+    }
+    // on the disk before it's renamed over the previous save
+    ok = ok && fflush(f) == 0;
+#if defined(_WIN32)
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    if (fclose(f) != 0) ok = false;
+    return ok;
+}
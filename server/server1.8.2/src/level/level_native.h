@@ -0,0 +1,53 @@
+// level/level_native.h: server_level.map, a native uncompressed level
+// format (level-format=native in server.properties). Not in the real
+// source, whose only format is the gzipped Java serialized
+// server_level.dat, all of which has to be inflated on every start. Here
+// a fixed little endian header fills the first LEVEL_NATIVE_DATA_OFFSET
+// bytes and the block array follows as is, page aligned, so loading is
+// just mapping the file: pages come in as they're first touched and stay
+// copy on write, the file itself is only ever replaced whole by a save
+//
+// Either format loads whatever the configured one is (the newer file
+// wins), so switching level-format and restarting converts the level
+//
+// Layout, all integers little endian:
+//   0  "MCLV"           8  int width          20 int xSpawn
+//   4  u32 version (1)  12 int height         24 int ySpawn
+//                       16 int depth          28 int zSpawn
+//   32 f32 rotSpawn     36 int tickCount      40 int unprocessed
+//   44 i64 createTime   52 char name[64]      116 char creator[64]
+//   180 u64 block count, then zero padding up to the blocks
+
+#ifndef LEVEL_NATIVE_H
+#define LEVEL_NATIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct Level;
+
+// where the blocks start, a multiple of any common page size
+#define LEVEL_NATIVE_DATA_OFFSET 4096
+
+// everything a save records besides the blocks, in either format
+typedef struct {
+    int width, height, depth;
+    int xSpawn, ySpawn, zSpawn;
+    float rotSpawn;
+    int tickCount, unprocessed;
+    long long createTime;
+    char name[64];
+    char creator[64];
+} LevelFileInfo;
+
+// opens a native level file. *blocks points at width*height*depth writable
+// blocks: inside *mapping (*mappingLen bytes, release with
+// LevelNative_unmap) where the platform can map files privately, or its
+// own malloc (*mapping NULL) where it can't
+bool LevelNative_open(const char* path, LevelFileInfo* info, unsigned char** blocks, void** mapping, size_t* mappingLen);
+void LevelNative_unmap(void* mapping, size_t mappingLen);
+
+// writes level (flat or packed) to path in the native format
+bool LevelNative_write(const char* path, const struct Level* level);
+
+#endif
@@ -0,0 +1,178 @@
+// level/level_sections.c
+
+#include "level_sections.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTION_MASK (LEVEL_SECTION_SIZE - 1)
+
+static int cellIndex(int x, int y, int z) {
+    return (((y & SECTION_MASK) << LEVEL_SECTION_BITS) + (z & SECTION_MASK)) * LEVEL_SECTION_SIZE + (x & SECTION_MASK);
+}
+
+static LevelSection* sectionAt(const LevelSections* s, int x, int y, int z) {
+    int col = x >> LEVEL_SECTION_BITS, row = z >> LEVEL_SECTION_BITS, layer = y >> LEVEL_SECTION_BITS;
+    return &s->sections[(layer * s->rows + row) * s->cols + col];
+}
+
+// the cells of a section that are actually inside the level, fewer than
+// LEVEL_SECTION_CELLS along a far edge whose size isn't a multiple of 16
+static int cellsInside(const LevelSections* s, int col, int row, int layer) {
+    int w = s->width - col * LEVEL_SECTION_SIZE, h = s->height - row * LEVEL_SECTION_SIZE, d = s->depth - layer * LEVEL_SECTION_SIZE;
+    if (w > LEVEL_SECTION_SIZE) w = LEVEL_SECTION_SIZE;
+    if (h > LEVEL_SECTION_SIZE) h = LEVEL_SECTION_SIZE;
+    if (d > LEVEL_SECTION_SIZE) d = LEVEL_SECTION_SIZE;
+    return w * h * d;
+}
+
+bool LevelSections_build(LevelSections* s, const unsigned char* blocks, int width, int height, int depth, bool dirty) {
+    memset(s, 0, sizeof *s);
+    s->width = width;
+    s->height = height;
+    s->depth = depth;
+    s->cols = (width + SECTION_MASK) >> LEVEL_SECTION_BITS;
+    s->rows = (height + SECTION_MASK) >> LEVEL_SECTION_BITS;
+    s->layers = (depth + SECTION_MASK) >> LEVEL_SECTION_BITS;
+    s->sections = (LevelSection*)calloc((size_t)s->cols * s->rows * s->layers, sizeof *s->sections);
+    if (!s->sections) return false;
+
+    for (int layer = 0; layer < s->layers; layer++)
+        for (int row = 0; row < s->rows; row++)
+            for (int col = 0; col < s->cols; col++) {
+                LevelSection* sec = &s->sections[(layer * s->rows + row) * s->cols + col];
+                sec->dirty = dirty;
+                int x0 = col * LEVEL_SECTION_SIZE, z0 = row * LEVEL_SECTION_SIZE, y0 = layer * LEVEL_SECTION_SIZE;
+                int x1 = x0 + LEVEL_SECTION_SIZE < width ? x0 + LEVEL_SECTION_SIZE : width;
+                int z1 = z0 + LEVEL_SECTION_SIZE < height ? z0 + LEVEL_SECTION_SIZE : height;
+                int y1 = y0 + LEVEL_SECTION_SIZE < depth ? y0 + LEVEL_SECTION_SIZE : depth;
+
+                unsigned char first = blocks[((size_t)y0 * height + z0) * width + x0];
+                bool uniform = true;
+                for (int y = y0; y < y1 && uniform; y++)
+                    for (int z = z0; z < z1 && uniform; z++) {
+                        const unsigned char* src = blocks + ((size_t)y * height + z) * width;
+                        for (int x = x0; x < x1; x++) {
+                            if (src[x] != first) {
+                                uniform = false;
+                                break;
+                            }
+                        }
+                    }
+                if (uniform) {
+                    sec->uniform = first;
+                    continue;
+                }
+
+                sec->cells = (unsigned char*)calloc(LEVEL_SECTION_CELLS, 1);
+                if (!sec->cells) {
+                    LevelSections_destroy(s);
+                    return false;
+                }
+                for (int y = y0; y < y1; y++)
+                    for (int z = z0; z < z1; z++) {
+                        const unsigned char* src = blocks + ((size_t)y * height + z) * width;
+                        unsigned char* dst = sec->cells + cellIndex(x0, y, z);
+                        memcpy(dst, src + x0, (size_t)(x1 - x0));
+                        for (int x = x0; x < x1; x++) {
+                            if (src[x] != 0) sec->nonAir++;
+                        }
+                    }
+            }
+    return true;
+}
+
+void LevelSections_destroy(LevelSections* s) {
+    if (s->sections) {
+        int count = s->cols * s->rows * s->layers;
+        for (int i = 0; i < count; i++) free(s->sections[i].cells);
+        free(s->sections);
+    }
+    memset(s, 0, sizeof *s);
+}
+
+int LevelSections_get(const LevelSections* s, int x, int y, int z) {
+    const LevelSection* sec = sectionAt(s, x, y, z);
+    return sec->cells ? sec->cells[cellIndex(x, y, z)] : sec->uniform;
+}
+
+bool LevelSections_set(LevelSections* s, int x, int y, int z, int type) {
+    LevelSection* sec = sectionAt(s, x, y, z);
+    if (!sec->cells) {
+        if (sec->uniform == (unsigned char)type) return true;
+        sec->cells = (unsigned char*)malloc(LEVEL_SECTION_CELLS);
+        if (!sec->cells) return false;
+        memset(sec->cells, sec->uniform, LEVEL_SECTION_CELLS);
+        sec->nonAir = (unsigned short)(sec->uniform != 0 ? cellsInside(s, x >> LEVEL_SECTION_BITS, z >> LEVEL_SECTION_BITS, y >> LEVEL_SECTION_BITS) : 0);
+    }
+    unsigned char* cell = &sec->cells[cellIndex(x, y, z)];
+    if (*cell != 0) sec->nonAir--;
+    if (type != 0) sec->nonAir++;
+    *cell = (unsigned char)type;
+    sec->dirty = true;
+
+    if (sec->nonAir == 0) {
+        // all air again, the usual way a dug out section ends
+        free(sec->cells);
+        sec->cells = NULL;
+        sec->uniform = 0;
+    }
+    return true;
+}
+
+void LevelSections_copyRow(const LevelSections* s, int y, int z, unsigned char* out) {
+    int row = z >> LEVEL_SECTION_BITS, layer = y >> LEVEL_SECTION_BITS;
+    const LevelSection* sec = &s->sections[(layer * s->rows + row) * s->cols];
+    int offset = cellIndex(0, y, z);
+    for (int col = 0; col < s->cols; col++, sec++) {
+        int x0 = col * LEVEL_SECTION_SIZE;
+        int n = s->width - x0 < LEVEL_SECTION_SIZE ? s->width - x0 : LEVEL_SECTION_SIZE;
+        if (sec->cells) memcpy(out + x0, sec->cells + offset, (size_t)n);
+        else memset(out + x0, sec->uniform, (size_t)n);
+    }
+}
+
+void LevelSections_flatten(const LevelSections* s, unsigned char* out) {
+    for (int y = 0; y < s->depth; y++)
+        for (int z = 0; z < s->height; z++) {
+            LevelSections_copyRow(s, y, z, out + ((size_t)y * s->height + z) * s->width);
+        }
+}
+
+int LevelSections_countDirty(const LevelSections* s) {
+    int count = s->cols * s->rows * s->layers, dirty = 0;
+    for (int i = 0; i < count; i++) {
+        if (s->sections[i].dirty) dirty++;
+    }
+    return dirty;
+}
+
+unsigned char* LevelSections_takeDirty(LevelSections* s) {
+    int count = s->cols * s->rows * s->layers;
+    unsigned char* dirty = (unsigned char*)malloc((size_t)count);
+    if (!dirty) return NULL;
+    for (int i = 0; i < count; i++) {
+        dirty[i] = s->sections[i].dirty;
+        s->sections[i].dirty = false;
+    }
+    return dirty;
+}
+
+void LevelSections_restoreDirty(LevelSections* s, const unsigned char* dirty, int count) {
+    if (count != s->cols * s->rows * s->layers) return;
+    for (int i = 0; i < count; i++) {
+        if (dirty[i]) s->sections[i].dirty = true;
+    }
+}
+
+int LevelSections_countExpanded(const LevelSections* s) {
+    int count = s->cols * s->rows * s->layers, expanded = 0;
+    for (int i = 0; i < count; i++) {
+        if (s->sections[i].cells) expanded++;
+    }
+    return expanded;
+}
+
+size_t LevelSections_residentBytes(const LevelSections* s) {
+    size_t count = (size_t)s->cols * s->rows * s->layers;
+    return count * sizeof(LevelSection) + (size_t)LevelSections_countExpanded(s) * LEVEL_SECTION_CELLS;
+}
@@ -0,0 +1,68 @@
+// level/level_sections.h: optional 16x16x16 section storage for a Level's
+// blocks (level-storage=sections in server.properties). Not in the real
+// source, which keeps one width*height*depth byte array. A section that's
+// one tile throughout (open sky, solid rock) holds no array at all, just
+// that tile, so a sky-heavy map only keeps its terrain resident. Every
+// section also has a dirty flag, set by each write to it
+//
+// The level goes through here for every block read and write once
+// Level_packSections has converted it (Level.blocks is NULL from then on).
+// Generation, loading and journal replay still fill a flat array first
+
+#ifndef LEVEL_SECTIONS_H
+#define LEVEL_SECTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LEVEL_SECTION_BITS 4
+#define LEVEL_SECTION_SIZE (1 << LEVEL_SECTION_BITS)
+#define LEVEL_SECTION_CELLS (LEVEL_SECTION_SIZE * LEVEL_SECTION_SIZE * LEVEL_SECTION_SIZE)
+
+typedef struct {
+    // LEVEL_SECTION_CELLS tiles laid out like the flat array, (y*16+z)*16+x.
+    // NULL while every cell holds uniform
+    unsigned char* cells;
+    unsigned char uniform;
+    bool dirty;
+    // non-air cells, only kept while cells is set: dropping to 0 frees the
+    // array again. A section filled with anything else stays expanded until
+    // the next full rebuild
+    unsigned short nonAir;
+} LevelSection;
+
+typedef struct LevelSections {
+    int width, height, depth; // the level's, in blocks
+    int cols, rows, layers;   // sections along x, z and y, edge sections may be partial
+    LevelSection* sections;   // (layer * rows + row) * cols + col
+} LevelSections;
+
+// builds the sections from a flat block array, each one starting out with
+// its dirty flag set to dirty. false if out of memory (s is left empty)
+bool LevelSections_build(LevelSections* s, const unsigned char* blocks, int width, int height, int depth, bool dirty);
+void LevelSections_destroy(LevelSections* s);
+
+// (x, y, z) must be in bounds for both
+int  LevelSections_get(const LevelSections* s, int x, int y, int z);
+// false if the section needed expanding and that ran out of memory, in
+// which case nothing was written
+bool LevelSections_set(LevelSections* s, int x, int y, int z, int type);
+
+// the width tiles of the row at (y, z), as the flat array has them
+void LevelSections_copyRow(const LevelSections* s, int y, int z, unsigned char* out);
+// the whole level in the flat array's layout, width*height*depth bytes
+void LevelSections_flatten(const LevelSections* s, unsigned char* out);
+
+int  LevelSections_countDirty(const LevelSections* s);
+// clears every dirty flag, returning what they were (one byte per section,
+// in sections order) so a save that then fails can put them back. NULL,
+// with nothing cleared, if out of memory
+unsigned char* LevelSections_takeDirty(LevelSections* s);
+// sets the flag again on every section set in dirty, a takeDirty result for
+// count sections. Ignored if the level has been rebuilt at another size since
+void LevelSections_restoreDirty(LevelSections* s, const unsigned char* dirty, int count);
+// how many sections hold an array, and the bytes those take
+int  LevelSections_countExpanded(const LevelSections* s);
+size_t LevelSections_residentBytes(const LevelSections* s);
+
+#endif
@@ -0,0 +1,313 @@
+// level/region_ticks.c
+
+#include "region_ticks.h"
+#include "level.h"
+#include "tile/tile.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <pthread.h>
+#endif
+
+#define REGION_TICKS_PHASES 4
+
+// the region grid, rebuilt whenever the level's dimensions change. Only
+// ever touched from the main thread, except for each worker's own region
+static RegionTickContext* sRegions = NULL;
+static int sRegionCount = 0;
+static int sGridWidth = 0, sGridHeight = 0, sGridDepth = 0;
+static RegionTickContext** sPhases[REGION_TICKS_PHASES];
+static int sPhaseCounts[REGION_TICKS_PHASES];
+
+// the phase being run: workers take regions sJobs[sJobNext..sJobEnd) one
+// at a time, and the last to finish one wakes the main thread
+static struct Level* sJobLevel = NULL;
+static RegionTickContext** sJobs = NULL;
+static int sJobNext = 0, sJobEnd = 0;
+static int sJobsLeft = 0;
+static int sWorkerCount = 0;
+
+#if defined(_WIN32)
+static CRITICAL_SECTION sLock;
+static CONDITION_VARIABLE sJobReady;
+static CONDITION_VARIABLE sPhaseDone;
+#else
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sJobReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sPhaseDone = PTHREAD_COND_INITIALIZER;
+#endif
+
+static void lock(void) {
+#if defined(_WIN32)
+    EnterCriticalSection(&sLock);
+#else
+    pthread_mutex_lock(&sLock);
+#endif
+}
+static void unlock(void) {
+#if defined(_WIN32)
+    LeaveCriticalSection(&sLock);
+#else
+    pthread_mutex_unlock(&sLock);
+#endif
+}
+
+static unsigned int nextSample(unsigned int* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8; // the low bits of a power of two LCG barely vary
+}
+
+static bool pushOp(RegionTickContext* ctx, int kind, int x, int y, int z, int oldType, int type) {
+    if (ctx->opCount == ctx->opCapacity) {
+        int newCapacity = ctx->opCapacity ? ctx->opCapacity * 2 : 64;
+        RegionTickOp* grown = (RegionTickOp*)realloc(ctx->ops, (size_t)newCapacity * sizeof *grown);
+        if (!grown) return false;
+        ctx->ops = grown;
+        ctx->opCapacity = newCapacity;
+    }
+    RegionTickOp* op = &ctx->ops[ctx->opCount++];
+    op->kind = kind;
+    op->x = x;
+    op->y = y;
+    op->z = z;
+    op->oldType = oldType;
+    op->type = type;
+    return true;
+}
+
+bool RegionTicks_setTile(Level* view, int x, int y, int z, int type, bool update) {
+    if (x < 0 || y < 0 || z < 0 || x >= view->width || y >= view->depth || z >= view->height) return false;
+    RegionTickContext* ctx = view->region;
+    int oldType = Level_getTile(view, x, y, z);
+    if (oldType == (byte)type) return false;
+
+    if (update && x >= ctx->x0 && x < ctx->x1 && z >= ctx->z0 && z < ctx->z1) {
+        if (!pushOp(ctx, REGION_OP_FINISH, x, y, z, oldType, type)) return false;
+        // regions are whole sections, so on a packed level the sections
+        // written here are this worker's alone too
+        if (!Level_storeTile(view, x, y, z, type)) {
+            ctx->opCount--;
+            return false;
+        }
+        return true;
+    }
+    // a neighbor region's cell may be being read right now, and a no
+    // update write has no side effects to split off, so both wait
+    return pushOp(ctx, update ? REGION_OP_SET : REGION_OP_SET_NO_UPDATE, x, y, z, oldType, type);
+}
+
+void RegionTicks_schedule(Level* view, int x, int y, int z, int tileId) {
+    pushOp(view->region, REGION_OP_SCHEDULE, x, y, z, 0, tileId);
+}
+
+int RegionTicks_random(Level* view) {
+    // same range as rand() guarantees everywhere, 0..32767
+    return (int)(nextSample(&view->region->tileRandom) >> 9) & 0x7fff;
+}
+
+static void runRegion(Level* level, RegionTickContext* ctx) {
+    // the tiles ticked here get this view, so their writes come back
+    // through RegionTicks_setTile instead of touching shared state
+    Level view = *level;
+    view.region = ctx;
+
+    int w = ctx->x1 - ctx->x0, h = ctx->z1 - ctx->z0;
+    ctx->unprocessed += w * h * level->depth;
+    int samples = ctx->unprocessed / 200; // same rate as the sequential loop
+    ctx->unprocessed -= samples * 200;
+
+    for (int i = 0; i < samples; ++i) {
+        int x = ctx->x0 + (int)(nextSample(&ctx->sampleRandom) % (unsigned int)w);
+        int z = ctx->z0 + (int)(nextSample(&ctx->sampleRandom) % (unsigned int)h);
+        int y = (int)(nextSample(&ctx->sampleRandom) % (unsigned int)level->depth);
+        int id = Level_getTile(level, x, y, z);
+        const Tile* t = gTiles[id];
+        if (!t || !t->onTick) continue;
+        if (t->tickIsLocal) t->onTick(t, &view, x, y, z);
+        else pushOp(ctx, REGION_OP_FIRE, x, y, z, 0, id);
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI workerMain(LPVOID arg) {
+#else
+static void* workerMain(void* arg) {
+#endif
+    (void)arg;
+    lock();
+    for (;;) {
+        while (sJobNext >= sJobEnd) {
+#if defined(_WIN32)
+            SleepConditionVariableCS(&sJobReady, &sLock, INFINITE);
+#else
+            pthread_cond_wait(&sJobReady, &sLock);
+#endif
+        }
+        RegionTickContext* ctx = sJobs[sJobNext++];
+        Level* level = sJobLevel;
+        unlock();
+
+        runRegion(level, ctx);
+
+        lock();
+        if (--sJobsLeft == 0) {
+#if defined(_WIN32)
+            WakeConditionVariable(&sPhaseDone);
+#else
+            pthread_cond_signal(&sPhaseDone);
+#endif
+        }
+    }
+#if defined(_WIN32)
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+void RegionTicks_init(int workerCount) {
+    if (workerCount < 1) return;
+    if (workerCount > REGION_TICKS_MAX_WORKERS) workerCount = REGION_TICKS_MAX_WORKERS;
+#if defined(_WIN32)
+    InitializeCriticalSection(&sLock);
+    InitializeConditionVariable(&sJobReady);
+    InitializeConditionVariable(&sPhaseDone);
+#endif
+    for (int i = 0; i < workerCount; i++) {
+#if defined(_WIN32)
+        HANDLE h = CreateThread(NULL, 0, workerMain, NULL, 0, NULL);
+        if (!h) break;
+        CloseHandle(h); // detached: the pool lives as long as the process
+#else
+        pthread_t t;
+        if (pthread_create(&t, NULL, workerMain, NULL) != 0) break;
+        pthread_detach(t);
+#endif
+        sWorkerCount++;
+    }
+}
+
+static void freeGrid(void) {
+    for (int i = 0; i < sRegionCount; i++) free(sRegions[i].ops);
+    free(sRegions);
+    for (int p = 0; p < REGION_TICKS_PHASES; p++) {
+        free(sPhases[p]);
+        sPhases[p] = NULL;
+        sPhaseCounts[p] = 0;
+    }
+    sRegions = NULL;
+    sRegionCount = 0;
+    sGridWidth = sGridHeight = sGridDepth = 0;
+}
+
+static bool buildGrid(const Level* level) {
+    freeGrid();
+    int cols = (level->width + REGION_TICKS_SIZE - 1) / REGION_TICKS_SIZE;
+    int rows = (level->height + REGION_TICKS_SIZE - 1) / REGION_TICKS_SIZE;
+    sRegions = (RegionTickContext*)calloc((size_t)(cols * rows), sizeof *sRegions);
+    if (!sRegions) return false;
+    for (int p = 0; p < REGION_TICKS_PHASES; p++) {
+        sPhases[p] = (RegionTickContext**)malloc((size_t)(cols * rows) * sizeof *sPhases[p]);
+        if (!sPhases[p]) {
+            freeGrid();
+            return false;
+        }
+    }
+    sRegionCount = cols * rows;
+
+    for (int rz = 0; rz < rows; rz++)
+        for (int rx = 0; rx < cols; rx++) {
+            int i = rz * cols + rx;
+            RegionTickContext* ctx = &sRegions[i];
+            ctx->x0 = rx * REGION_TICKS_SIZE;
+            ctx->z0 = rz * REGION_TICKS_SIZE;
+            ctx->x1 = ctx->x0 + REGION_TICKS_SIZE < level->width ? ctx->x0 + REGION_TICKS_SIZE : level->width;
+            ctx->z1 = ctx->z0 + REGION_TICKS_SIZE < level->height ? ctx->z0 + REGION_TICKS_SIZE : level->height;
+            // independent streams per region, seeded off the level's own
+            ctx->sampleRandom = level->tickRandom ^ ((unsigned int)i * 0x9E3779B9u);
+            ctx->tileRandom = (unsigned int)rand() ^ ((unsigned int)i * 0x85EBCA6Bu);
+
+            int phase = (rx & 1) | ((rz & 1) << 1);
+            sPhases[phase][sPhaseCounts[phase]++] = ctx;
+        }
+    sGridWidth = level->width;
+    sGridHeight = level->height;
+    sGridDepth = level->depth;
+    return true;
+}
+
+static void runPhase(Level* level, RegionTickContext** regions, int count) {
+    lock();
+    sJobLevel = level;
+    sJobs = regions;
+    sJobNext = 0;
+    sJobEnd = count;
+    sJobsLeft = count;
+#if defined(_WIN32)
+    WakeAllConditionVariable(&sJobReady);
+#else
+    pthread_cond_broadcast(&sJobReady);
+#endif
+    // the main thread takes regions too rather than just waiting
+    while (sJobNext < sJobEnd) {
+        RegionTickContext* ctx = sJobs[sJobNext++];
+        unlock();
+        runRegion(level, ctx);
+        lock();
+        sJobsLeft--;
+    }
+    while (sJobsLeft > 0) {
+#if defined(_WIN32)
+        SleepConditionVariableCS(&sPhaseDone, &sLock, INFINITE);
+#else
+        pthread_cond_wait(&sPhaseDone, &sLock);
+#endif
+    }
+    unlock();
+}
+
+static void mergeRegion(Level* level, RegionTickContext* ctx) {
+    for (int i = 0; i < ctx->opCount; i++) {
+        const RegionTickOp* op = &ctx->ops[i];
+        switch (op->kind) {
+            case REGION_OP_FINISH:
+                Level_finishSetTile(level, op->x, op->y, op->z, op->oldType, op->type);
+                break;
+            case REGION_OP_SET:
+                if (Level_getTile(level, op->x, op->y, op->z) == op->oldType) {
+                    level_setTile(level, op->x, op->y, op->z, op->type);
+                }
+                break;
+            case REGION_OP_SET_NO_UPDATE:
+                if (Level_getTile(level, op->x, op->y, op->z) == op->oldType) {
+                    Level_setTileNoUpdate(level, op->x, op->y, op->z, op->type);
+                }
+                break;
+            case REGION_OP_SCHEDULE:
+                Level_addToTickNextTick(level, op->x, op->y, op->z, op->type);
+                break;
+            case REGION_OP_FIRE:
+                if (Level_getTile(level, op->x, op->y, op->z) == op->type) {
+                    const Tile* t = gTiles[op->type];
+                    t->onTick(t, level, op->x, op->y, op->z);
+                }
+                break;
+        }
+    }
+    ctx->opCount = 0;
+}
+
+bool RegionTicks_run(Level* level) {
+    if (sWorkerCount == 0) return false;
+    if (level->width != sGridWidth || level->height != sGridHeight || level->depth != sGridDepth) {
+        if (!buildGrid(level)) return false;
+    }
+
+    for (int p = 0; p < REGION_TICKS_PHASES; p++) runPhase(level, sPhases[p], sPhaseCounts[p]);
+    for (int p = 0; p < REGION_TICKS_PHASES; p++)
+        for (int i = 0; i < sPhaseCounts[p]; i++) mergeRegion(level, sPhases[p][i]);
+    return true;
+}
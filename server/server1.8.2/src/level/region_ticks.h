@@ -0,0 +1,79 @@
+// level/region_ticks.h: optional multithreaded random tile ticks. Not in
+// the real source, which samples width*height*depth/200 random cells per
+// tick one after another on the game thread. With tile-tick-workers set,
+// the map is cut into square column regions instead, each with its own
+// sample rate share and its own LCG streams, and regions run on a worker
+// pool in four checkerboard phases (by the parity of their region x and z),
+// so two regions running at once are always at least a whole region apart
+// and nothing one reads can be written by another
+//
+// Only tiles with Tile.tickIsLocal set (grass and the bush family) run on
+// the workers. Their block writes inside the region land immediately (so
+// later samples in the same region see them) with the side effects
+// (neighbor notifications, light, journal, the listener) held back, and
+// writes that fall outside the region are held back whole. Samples that
+// hit any other ticking tile are just recorded. Once every phase is done,
+// the main thread merges region by region, in order: finishing the held
+// back side effects, applying the held back writes if the cell still holds
+// what the tick saw there, and firing the recorded ticks
+//
+// Results differ from the sequential mode in where the samples land and
+// in the same tick's writes not being visible across regions until the
+// merge, so it's off (tile-tick-workers=0) by default
+
+#ifndef REGION_TICKS_H
+#define REGION_TICKS_H
+
+#include <stdbool.h>
+
+struct Level;
+
+// upper bound on tile-tick-workers, anything past this is clamped
+#define REGION_TICKS_MAX_WORKERS 16
+
+// region edge length in blocks (x and z, always the full height)
+#define REGION_TICKS_SIZE 64
+
+enum {
+    REGION_OP_FINISH,   // a write already made in the region, side effects pending
+    REGION_OP_SET,      // a level_setTile outside the region
+    REGION_OP_SET_NO_UPDATE, // a Level_setTileNoUpdate outside the region
+    REGION_OP_SCHEDULE, // a Level_addToTickNextTick
+    REGION_OP_FIRE      // a sample that hit a tile not safe to tick off the main thread
+};
+
+typedef struct {
+    int kind;
+    int x, y, z;
+    int oldType; // FINISH/SET/SET_NO_UPDATE: what the cell held when the tick wrote it
+    int type;    // the new tile, or the scheduled/sampled tile id
+} RegionTickOp;
+
+// one region's state, also what a worker's Level view points at (see
+// Level.region) while it runs that region
+typedef struct RegionTickContext {
+    int x0, z0, x1, z1; // the columns it owns, [x0, x1) by [z0, z1)
+    unsigned int sampleRandom; // picks the cells to tick
+    unsigned int tileRandom; // backs Level_random for the tiles being ticked
+    int unprocessed;
+
+    RegionTickOp* ops;
+    int opCount, opCapacity;
+} RegionTickContext;
+
+// starts workerCount threads (tile-tick-workers in server.properties). 0
+// leaves region ticks off. Call once, from Server_init
+void RegionTicks_init(int workerCount);
+
+// runs this tick's random tile ticks for level region by region. Returns
+// false without doing anything if region ticks are off, for the caller to
+// run the sequential loop instead
+bool RegionTicks_run(struct Level* level);
+
+// called by level.c when a tile write or schedule happens on a worker's
+// Level view. Returns what the sequential call would have
+bool RegionTicks_setTile(struct Level* view, int x, int y, int z, int type, bool update);
+void RegionTicks_schedule(struct Level* view, int x, int y, int z, int tileId);
+int  RegionTicks_random(struct Level* view);
+
+#endif
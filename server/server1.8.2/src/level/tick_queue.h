@@ -0,0 +1,38 @@
+// level/tick_queue.h: the scheduled tile tick list behind
+// Level_addToTickNextTick, as a growable ring instead of the real source's
+// ArrayList drained with remove(0). Same FIFO and the same entries (a
+// cell queued twice fires twice, lava's extra tickDelay drains are still
+// counted down by re-queueing at the tail), so tiles fire in exactly the
+// order they always did: only taking from the front and putting back at
+// the tail are O(1) now, instead of shifting everything that's left
+
+#ifndef TICK_QUEUE_H
+#define TICK_QUEUE_H
+
+#include <stdbool.h>
+
+// a pending liquid/gravity-tile reaction scheduled for a future tick, see
+// Level_addToTickNextTick. delay is extra 5-tick drain cycles to wait before
+// firing (c0.0.16a_02, lava only, see Tile.tickDelay).
+typedef struct {
+    int x, y, z;
+    int tileId;
+    int delay;
+} TickEntry;
+
+typedef struct TickQueue {
+    TickEntry* entries;
+    int capacity; // a power of two, 0 until the first push
+    int head;     // index of the oldest entry
+    int count;
+} TickQueue;
+
+void TickQueue_init(TickQueue* queue);
+void TickQueue_destroy(TickQueue* queue); // frees everything, leaves it re-initialized
+
+// appends at the tail. false (and nothing queued) if growing ran out of memory
+bool TickQueue_push(TickQueue* queue, TickEntry e);
+// removes the oldest entry into *out, false if there is none
+bool TickQueue_pop(TickQueue* queue, TickEntry* out);
+
+#endif
@@ -28,6 +28,7 @@ static void registerTile(Tile* t, int id, int tex) {
     t->xx0 = t->yy0 = t->zz0 = 0.0f;
     t->xx1 = t->yy1 = t->zz1 = 1.0f;
     t->onTick = NULL;
+    t->tickIsLocal = 0;
     t->isSolid     = Tile_default_isSolid;
     t->blocksLight = Tile_default_blocksLight;
     t->getAABB     = Tile_default_getAABB;
@@ -42,14 +43,10 @@ static void registerTile(Tile* t, int id, int tex) {
 // server1.6: true if a Sponge exists within a 5x5x5 cube centered on
 // (x,y,z). Used to stop water (not lava) from falling or spreading into a
 // sponge's dry zone, working together with Sponge's own onPlace/onRemoved
-// hooks to keep water from re-flooding the area it just dried
+// hooks to keep water from re-flooding the area it just dried. Answered from
+// the level's precomputed sponge counts rather than scanning the cube here
 static int hasNearbySponge(Level* lvl, int x, int y, int z) {
-    for (int dx = -2; dx <= 2; ++dx)
-    for (int dy = -2; dy <= 2; ++dy)
-    for (int dz = -2; dz <= 2; ++dz) {
-        if (Level_getTile(lvl, x + dx, y + dy, z + dz) == TILE_SPONGE.id) return 1;
-    }
-    return 0;
+    return Level_isNearSponge(lvl, x, y, z) ? 1 : 0;
 }
 
 Tile TILE_ROCK;
@@ -82,7 +79,7 @@ Tile TILE_GOLD_BLOCK;
 
 static void Grass_onTick(const Tile* self, Level* lvl, int x, int y, int z) {
     (void)self;
-    if (rand() % 4 != 0) return; // c0.0.13a throttles grass ticks to 25%
+    if (Level_random(lvl) % 4 != 0) return; // c0.0.13a throttles grass ticks to 25%
 
     if (!Level_isLit(lvl, x, y + 1, z)) {
         // no sunlight reaching the block above: turn into dirt
@@ -90,9 +87,9 @@ static void Grass_onTick(const Tile* self, Level* lvl, int x, int y, int z) {
     } else {
         // try 4 random neighbors, matching Java's skewed vertical range
         for (int i = 0; i < 4; ++i) {
-            int tx = x + (rand() % 3) - 1;
-            int ty = y + (rand() % 5) - 3;
-            int tz = z + (rand() % 3) - 1;
+            int tx = x + (Level_random(lvl) % 3) - 1;
+            int ty = y + (Level_random(lvl) % 5) - 3;
+            int tz = z + (Level_random(lvl) % 3) - 1;
             if (Level_getTile(lvl, tx, ty, tz) == TILE_DIRT.id && Level_isLit(lvl, tx, ty + 1, tz)) {
                 level_setTile(lvl, tx, ty, tz, TILE_GRASS.id);
             }
@@ -259,11 +256,13 @@ void Tile_registerAll(void) {
     registerTile(&TILE_BEDROCK,    7, 17);
 
     TILE_GRASS.onTick     = Grass_onTick;
+    TILE_GRASS.tickIsLocal = 1;
 
     TILE_BUSH.isSolid     = Bush_isSolid;
     TILE_BUSH.blocksLight = Bush_blocksLight;
     TILE_BUSH.getAABB     = Bush_getAABB;
     TILE_BUSH.onTick      = Bush_onTick;
+    TILE_BUSH.tickIsLocal = 1;
 
     // tex 14 = water, tex 30 = lava (terrain.png atlas slots, matching LiquidTile.java)
     registerTile(&TILE_WATER,      8, 14);
@@ -360,6 +359,7 @@ void Tile_registerAll(void) {
         plants[i]->blocksLight = Bush_blocksLight;
         plants[i]->getAABB     = Bush_getAABB;
         plants[i]->onTick      = Bush_onTick;
+        plants[i]->tickIsLocal = 1;
     }
 
     // server1.8.2: Gold Block, plain tile, no special behavior
@@ -33,6 +33,11 @@ struct Tile {
     float xx0, yy0, zz0, xx1, yy1, zz1;
 
     void (*onTick)(const Tile* self, Level* lvl, int x, int y, int z);
+    // not in the real source: 1 if onTick only looks at blocks within one
+    // column of (x,z) and only touches the level through Level_getTile,
+    // Level_isLit, level_setTile and Level_random, so region ticks (see
+    // level/region_ticks.h) can run it on a worker thread
+    int tickIsLocal;
 
     int  (*isSolid)(const Tile* self);
     int  (*blocksLight)(const Tile* self);
@@ -2,31 +2,228 @@
 // shared Log_info/Log_warn helpers used everywhere else. The server has no
 // GUI, so LevelGen's title/status/progress calls just become console lines
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "log.h"
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-// new in server1.4.1: the real source adds a second log handler writing to
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <pthread.h>
+#endif
+
+// not in the real source: lines are formatted by whichever thread logs
+// them and handed to a writer thread through a bounded ring, Vyukov style.
+// Each slot carries a sequence number: a producer claims a position with a
+// CAS on sEnqueuePos, fills the slot and publishes it by bumping the slot's
+// sequence, so producers never wait on each other or on the writer. The
+// writer is the only consumer and only touches sDequeuePos itself
+#define LOG_RING_SLOTS 1024      // power of two
+#define LOG_LINE_MAX   544       // severity, stamp and a 511 character message
+#define LOG_BATCH_MAX  (64*1024) // written out with one fwrite per stream
+#define LOG_IDLE_MILLIS 10       // writer's nap when the ring is empty
+#define LOG_FLUSH_TIMEOUT_MILLIS 2000
+
+typedef struct {
+    unsigned int seq;            // atomic
+    int len;
+    char text[LOG_LINE_MAX];
+} LogSlot;
+
+static LogSlot sRing[LOG_RING_SLOTS];
+static unsigned int sEnqueuePos; // atomic, next position a producer claims
+static unsigned int sDequeuePos; // writer thread only
+static unsigned int sWritten;    // atomic, every line before this is out
+static unsigned int sDropped;    // atomic, lines lost to a full ring since last reported
+static int sRunning;             // atomic, set once the writer thread is up
+
+// server1.4.1: the real source adds a second log handler writing to
 // server.log alongside the existing console output. Opened lazily so a
-// server that never logs anything doesn't create an empty file
+// server that never logs anything doesn't create an empty file. Only the
+// writer thread touches these once it's running
 static FILE* logFile = NULL;
+static long long sFileBytes;
+static long long sMaxBytes;      // log-max-kb, 0 = never rotate
+static int sKeepFiles;           // log-files, rotated copies kept
 
-static void logLine(const char* severity, const char* fmt, va_list args) {
+static char sBatch[LOG_BATCH_MAX];
+
+static void sleepMillis(int ms) {
+#if defined(_WIN32)
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void openFile(void) {
+    logFile = fopen("server.log", "a");
+    if (!logFile) return;
+    fseek(logFile, 0, SEEK_END);
+    sFileBytes = ftell(logFile);
+    if (sFileBytes < 0) sFileBytes = 0;
+}
+
+// server.log becomes server.log.1, .1 becomes .2 and so on, the oldest
+// past log-files is deleted. Removed first so the renames never land on an
+// existing file, which Windows won't do
+static void rotate(void) {
+    fclose(logFile);
+    logFile = NULL;
+    char from[32], to[32];
+    snprintf(to, sizeof to, "server.log.%d", sKeepFiles);
+    remove(sKeepFiles > 0 ? to : "server.log");
+    for (int i = sKeepFiles - 1; i >= 0; i--) {
+        if (i == 0) snprintf(from, sizeof from, "server.log");
+        else snprintf(from, sizeof from, "server.log.%d", i);
+        snprintf(to, sizeof to, "server.log.%d", i + 1);
+        rename(from, to);
+    }
+    openFile();
+}
+
+static void writeOut(const char* text, int len) {
+    fwrite(text, 1, (size_t)len, stderr);
+    fflush(stderr);
+
+    if (!logFile) openFile();
+    if (logFile && sMaxBytes > 0 && sFileBytes > 0 && sFileBytes + len > sMaxBytes) rotate();
+    if (logFile) {
+        fwrite(text, 1, (size_t)len, logFile);
+        fflush(logFile);
+        sFileBytes += len;
+    }
+}
+
+// localtime itself isn't safe to call from several threads at once
+static void stampNow(char* out, size_t size) {
     time_t now = time(NULL);
-    struct tm* t = localtime(&now);
+    struct tm t;
+#if defined(_WIN32)
+    localtime_s(&t, &now);
+#else
+    localtime_r(&now, &t);
+#endif
+    strftime(out, size, "%H:%M:%S", &t);
+}
+
+static int formatLine(char* out, const char* severity, const char* fmt, va_list args) {
     char stamp[16];
-    strftime(stamp, sizeof stamp, "%H:%M:%S", t);
+    stampNow(stamp, sizeof stamp);
 
     char msg[512];
     vsnprintf(msg, sizeof msg, fmt, args);
 
-    fprintf(stderr, "%s  %s  %s\n", severity, stamp, msg);
+    int n = snprintf(out, LOG_LINE_MAX, "%s  %s  %s\n", severity, stamp, msg);
+    return n < LOG_LINE_MAX ? n : LOG_LINE_MAX - 1;
+}
 
-    if (!logFile) logFile = fopen("server.log", "a");
-    if (logFile) {
-        fprintf(logFile, "%s  %s  %s\n", severity, stamp, msg);
-        fflush(logFile);
+// false if the ring is full, the line is then just counted as dropped
+static bool enqueue(const char* severity, const char* fmt, va_list args) {
+    unsigned int pos = __atomic_load_n(&sEnqueuePos, __ATOMIC_RELAXED);
+    LogSlot* slot;
+    for (;;) {
+        slot = &sRing[pos & (LOG_RING_SLOTS - 1)];
+        int diff = (int)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&sEnqueuePos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+        } else if (diff < 0) {
+            return false; // the writer hasn't freed this slot yet
+        } else {
+            pos = __atomic_load_n(&sEnqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+    slot->len = formatLine(slot->text, severity, fmt, args);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// moves every published line that fits into sBatch, returns its length
+static int drain(void) {
+    int len = 0;
+    for (;;) {
+        LogSlot* slot = &sRing[sDequeuePos & (LOG_RING_SLOTS - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != sDequeuePos + 1) break;
+        if (len + slot->len > LOG_BATCH_MAX) break;
+        memcpy(sBatch + len, slot->text, (size_t)slot->len);
+        len += slot->len;
+        __atomic_store_n(&slot->seq, sDequeuePos + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+        sDequeuePos++;
+    }
+    return len;
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI writerMain(LPVOID arg) {
+#else
+static void* writerMain(void* arg) {
+#endif
+    (void)arg;
+    for (;;) {
+        int len = drain();
+        unsigned int dropped = __atomic_exchange_n(&sDropped, 0, __ATOMIC_RELAXED);
+        if (dropped && len + LOG_LINE_MAX <= LOG_BATCH_MAX) {
+            char stamp[16];
+            stampNow(stamp, sizeof stamp);
+            len += snprintf(sBatch + len, LOG_LINE_MAX, "  !  %s  %u log lines dropped, the log writer fell behind\n", stamp, dropped);
+        } else if (dropped) {
+            __atomic_fetch_add(&sDropped, dropped, __ATOMIC_RELAXED); // next batch then
+        }
+        if (len == 0) {
+            sleepMillis(LOG_IDLE_MILLIS);
+            continue;
+        }
+        writeOut(sBatch, len);
+        __atomic_store_n(&sWritten, sDequeuePos, __ATOMIC_RELEASE);
+    }
+#if defined(_WIN32)
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+void Log_start(long long maxBytes, int keepFiles) {
+    sMaxBytes = maxBytes;
+    sKeepFiles = keepFiles;
+    for (int i = 0; i < LOG_RING_SLOTS; i++) sRing[i].seq = (unsigned int)i;
+#if defined(_WIN32)
+    HANDLE h = CreateThread(NULL, 0, writerMain, NULL, 0, NULL);
+    if (!h) return; // lines keep being written on the spot
+    CloseHandle(h);
+#else
+    pthread_t t;
+    if (pthread_create(&t, NULL, writerMain, NULL) != 0) return;
+    pthread_detach(t);
+#endif
+    __atomic_store_n(&sRunning, 1, __ATOMIC_RELEASE);
+    atexit(Log_flush);
+}
+
+void Log_flush(void) {
+    if (!__atomic_load_n(&sRunning, __ATOMIC_ACQUIRE)) return;
+    unsigned int target = __atomic_load_n(&sEnqueuePos, __ATOMIC_ACQUIRE);
+    for (int waited = 0; waited < LOG_FLUSH_TIMEOUT_MILLIS; waited++) {
+        if ((int)(__atomic_load_n(&sWritten, __ATOMIC_ACQUIRE) - target) >= 0) return;
+        sleepMillis(1);
+    }
+}
+
+static void logLine(const char* severity, const char* fmt, va_list args) {
+    if (!__atomic_load_n(&sRunning, __ATOMIC_ACQUIRE)) {
+        // before Log_start (or if its thread couldn't be started) the
+        // calling thread writes the line itself, as the real source does
+        char line[LOG_LINE_MAX];
+        writeOut(line, formatLine(line, severity, fmt, args));
+        return;
     }
+    if (!enqueue(severity, fmt, args)) __atomic_fetch_add(&sDropped, 1, __ATOMIC_RELAXED);
 }
 
 void Log_info(const char* fmt, ...) {
@@ -43,11 +240,13 @@ void Log_warn(const char* fmt, ...) {
     va_end(args);
 }
 
+// usually followed by giving up, so it waits until the line is out
 void Log_severe(const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
     logLine("***", fmt, args);
     va_end(args);
+    Log_flush();
 }
 
 void Server_beginLevelLoading(const char* title) {
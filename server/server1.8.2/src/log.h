@@ -11,4 +11,15 @@ void Log_info(const char* fmt, ...);
 void Log_warn(const char* fmt, ...);
 void Log_severe(const char* fmt, ...);
 
+// not in the real source: from here on lines are handed to a background
+// writer thread instead of being written by whoever logs them (see log.c),
+// and server.log is rotated once it would grow past maxBytes (0 = never),
+// keeping keepFiles old ones as server.log.1, .2, ... Until this is called,
+// or if the thread can't be started, lines are written on the spot
+void Log_start(long long maxBytes, int keepFiles);
+
+// waits (up to a couple of seconds) until every line logged so far is out.
+// Log_severe does this itself, and it runs at exit
+void Log_flush(void);
+
 #endif
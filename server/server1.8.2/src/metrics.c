@@ -0,0 +1,255 @@
+// metrics.c
+
+#include "metrics.h"
+#include "server.h"
+#include "net/connection.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a scrape that hasn't finished by then is dropped
+#define METRICS_CLIENT_TIMEOUT_NANOS 5000000000LL
+
+void ServerStats_countKick(ServerStats* stats, const char* reason) {
+    for (int i = 0; i < stats->kickReasonCount; i++) {
+        if (strcmp(stats->kickReasons[i], reason) == 0) {
+            stats->kickCounts[i]++;
+            return;
+        }
+    }
+    if (stats->kickReasonCount == METRICS_MAX_KICK_REASONS) {
+        stats->kicksOther++;
+        return;
+    }
+    snprintf(stats->kickReasons[stats->kickReasonCount], sizeof stats->kickReasons[0], "%s", reason);
+    stats->kickCounts[stats->kickReasonCount++] = 1;
+}
+
+bool Metrics_listen(MinecraftServer* srv, int port) {
+    MetricsServer* m = &srv->metrics;
+    if (!NetSocket_listen(&m->listenSock, port)) return false;
+    m->listening = true;
+    NetPoller_add(&srv->poller, m->listenSock, &m->listenSock);
+    return true;
+}
+
+static void closeClient(MinecraftServer* srv, MetricsClient* cl) {
+    NetPoller_remove(&srv->poller, cl->sock);
+    NetSocket_close(cl->sock);
+    free(cl->response);
+    memset(cl, 0, sizeof *cl);
+}
+
+/* response body */
+
+typedef struct {
+    char* data;
+    int len, capacity;
+} TextBuf;
+
+static void appendf(TextBuf* b, const char* fmt, ...) {
+    for (;;) {
+        int room = b->capacity - b->len;
+        va_list args;
+        va_start(args, fmt);
+        int n = room > 0 ? vsnprintf(b->data + b->len, (size_t)room, fmt, args) : -1;
+        va_end(args);
+        if (n >= 0 && n < room) {
+            b->len += n;
+            return;
+        }
+        int capacity = b->capacity ? b->capacity * 2 : 8192;
+        char* grown = (char*)realloc(b->data, (size_t)capacity);
+        if (!grown) return; // out of memory, the line is just missing
+        b->data = grown;
+        b->capacity = capacity;
+    }
+}
+
+static void header(TextBuf* b, const char* name, const char* type, const char* help) {
+    appendf(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// a label value with \, " and newlines escaped
+static void appendLabel(TextBuf* b, const char* value) {
+    for (const char* p = value; *p; p++) {
+        if (*p == '\\' || *p == '"') appendf(b, "\\%c", *p);
+        else if (*p == '\n') appendf(b, "\\n");
+        else appendf(b, "%c", *p);
+    }
+}
+
+static void writeMetrics(MinecraftServer* srv, TextBuf* b, long long now) {
+    const ServerStats* st = &srv->stats;
+
+    int open = 0, joining = 0, playing = 0;
+    for (int i = 0; i < srv->maxPlayers; i++) {
+        const Connection* c = srv->playerSlots[i];
+        if (!c || !c->open) continue;
+        open++;
+        if (c->spawned) playing++;
+        else if (c->loggedIn) joining++;
+    }
+    header(b, "mc_players_connected", "gauge", "Players that have finished joining.");
+    appendf(b, "mc_players_connected %d\n", playing);
+    header(b, "mc_connections", "gauge", "Open game connections, joined or not.");
+    appendf(b, "mc_connections %d\n", open);
+    header(b, "mc_level_sends_pending", "gauge", "Logged in connections still waiting for or receiving the level.");
+    appendf(b, "mc_level_sends_pending %d\n", joining);
+
+    header(b, "mc_bytes_received_total", "counter", "Bytes read from game connections.");
+    appendf(b, "mc_bytes_received_total %lld\n", st->bytesIn);
+    header(b, "mc_bytes_sent_total", "counter", "Bytes written to game connections.");
+    appendf(b, "mc_bytes_sent_total %lld\n", st->bytesOut);
+    header(b, "mc_packets_received_total", "counter", "Packets received from clients, by packet id.");
+    for (int i = 0; i < PACKET_COUNT; i++)
+        appendf(b, "mc_packets_received_total{packet=\"%s\"} %lld\n", PacketName[i], st->packetsIn[i]);
+
+    // cumulative buckets at every power of two from 128us to ~1s, each a
+    // bucket edge in the profiler's own histogram (see tick_profiler.h)
+    const PerfHistogram* tick = &srv->profiler.total[PERF_TICK];
+    header(b, "mc_tick_duration_seconds", "histogram", "Time spent running each 50ms game tick.");
+    long long below = 0;
+    int bucket = 0;
+    for (int log2 = 7; log2 <= 20; log2++) {
+        long long edgeMicros = 1LL << log2;
+        while (bucket < PERF_BUCKETS && TickProfiler_bucketMicros(bucket) < edgeMicros) below += tick->buckets[bucket++];
+        appendf(b, "mc_tick_duration_seconds_bucket{le=\"%g\"} %lld\n", (double)edgeMicros / 1e6, below);
+    }
+    appendf(b, "mc_tick_duration_seconds_bucket{le=\"+Inf\"} %lld\n", tick->count);
+    appendf(b, "mc_tick_duration_seconds_sum %.6f\n", (double)tick->totalNanos / 1e9);
+    appendf(b, "mc_tick_duration_seconds_count %lld\n", tick->count);
+    header(b, "mc_tick_overruns_total", "counter", "Ticks that took longer than their 50ms budget.");
+    appendf(b, "mc_tick_overruns_total %lld\n", srv->profiler.overruns);
+
+    header(b, "mc_tick_list_length", "gauge", "Scheduled tile ticks waiting to fire.");
+    appendf(b, "mc_tick_list_length %d\n", srv->level.tickQueue.count);
+
+    header(b, "mc_saves_total", "counter", "Completed level saves.");
+    appendf(b, "mc_saves_total %lld\n", st->saves);
+    header(b, "mc_save_seconds_total", "counter", "Time spent in completed level saves.");
+    appendf(b, "mc_save_seconds_total %.6f\n", (double)st->saveTotalNanos / 1e9);
+    header(b, "mc_last_save_duration_seconds", "gauge", "How long the last completed level save took.");
+    appendf(b, "mc_last_save_duration_seconds %.6f\n", (double)st->lastSaveNanos / 1e9);
+    header(b, "mc_save_in_progress_seconds", "gauge", "How long the running level save has been going, 0 if none is.");
+    appendf(b, "mc_save_in_progress_seconds %.6f\n", st->saveStart ? (double)(now - st->saveStart) / 1e9 : 0.0);
+
+    header(b, "mc_kicks_total", "counter", "Players kicked, by the reason they were sent.");
+    for (int i = 0; i < st->kickReasonCount; i++) {
+        appendf(b, "mc_kicks_total{reason=\"");
+        appendLabel(b, st->kickReasons[i]);
+        appendf(b, "\"} %lld\n", st->kickCounts[i]);
+    }
+    if (st->kicksOther) appendf(b, "mc_kicks_total{reason=\"other\"} %lld\n", st->kicksOther);
+}
+
+/* HTTP */
+
+static void respond(MinecraftServer* srv, MetricsClient* cl, long long now) {
+    bool found = strncmp(cl->request, "GET /metrics ", 13) == 0 || strncmp(cl->request, "GET /metrics?", 13) == 0;
+    TextBuf body = { NULL, 0, 0 };
+    if (found) writeMetrics(srv, &body, now);
+    else appendf(&body, "not found, try /metrics\n");
+
+    TextBuf out = { NULL, 0, 0 };
+    appendf(&out, "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n%.*s",
+            found ? "200 OK" : "404 Not Found", body.len, body.len, body.data ? body.data : "");
+    free(body.data);
+    if (!out.data) {
+        closeClient(srv, cl);
+        return;
+    }
+    cl->response = out.data;
+    cl->responseLen = out.len;
+    cl->responseSent = 0;
+}
+
+static void writeResponse(MinecraftServer* srv, MetricsClient* cl) {
+    while (cl->responseSent < cl->responseLen) {
+        int n = NetSocket_write(cl->sock, cl->response + cl->responseSent, cl->responseLen - cl->responseSent);
+        if (n < 0) {
+            closeClient(srv, cl);
+            return;
+        }
+        if (n == 0) {
+            NetPoller_setWantWrite(&srv->poller, cl->sock, cl, true);
+            return;
+        }
+        cl->responseSent += n;
+    }
+    closeClient(srv, cl);
+}
+
+static void readRequest(MinecraftServer* srv, MetricsClient* cl, long long now) {
+    for (;;) {
+        int room = METRICS_REQUEST_MAX - 1 - cl->requestLen;
+        if (room <= 0) {
+            closeClient(srv, cl); // no request is this long
+            return;
+        }
+        int n = NetSocket_read(cl->sock, cl->request + cl->requestLen, room);
+        if (n < 0) {
+            closeClient(srv, cl);
+            return;
+        }
+        if (n == 0) break;
+        cl->requestLen += n;
+    }
+    cl->request[cl->requestLen] = '\0';
+    if (!strstr(cl->request, "\r\n\r\n") && !strstr(cl->request, "\n\n")) return; // headers not all here yet
+
+    respond(srv, cl, now);
+    if (cl->used) writeResponse(srv, cl);
+}
+
+static void acceptClients(MinecraftServer* srv, long long now) {
+    MetricsServer* m = &srv->metrics;
+    sock_t sock;
+    while (NetSocket_accept(m->listenSock, &sock)) {
+        MetricsClient* cl = NULL;
+        for (int i = 0; i < METRICS_MAX_CLIENTS && !cl; i++)
+            if (!m->clients[i].used) cl = &m->clients[i];
+        NetSocket_configure(sock);
+        if (!cl) {
+            NetSocket_close(sock);
+            continue;
+        }
+        memset(cl, 0, sizeof *cl);
+        cl->used = true;
+        cl->sock = sock;
+        cl->opened = now;
+        NetPoller_add(&srv->poller, sock, cl);
+        readRequest(srv, cl, now); // the request may well be here already
+    }
+}
+
+bool Metrics_handleEvent(MinecraftServer* srv, void* userData, bool readable, bool writable, long long now) {
+    MetricsServer* m = &srv->metrics;
+    if (!m->listening) return false;
+    if (userData == &m->listenSock) {
+        acceptClients(srv, now);
+        return true;
+    }
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        MetricsClient* cl = &m->clients[i];
+        if (userData != cl) continue;
+        if (!cl->used) return true;
+        if (cl->response) {
+            if (writable || readable) writeResponse(srv, cl);
+        } else if (readable) {
+            readRequest(srv, cl, now);
+        }
+        return true;
+    }
+    return false;
+}
+
+void Metrics_tick(MinecraftServer* srv, long long now) {
+    MetricsServer* m = &srv->metrics;
+    if (!m->listening) return;
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        MetricsClient* cl = &m->clients[i];
+        if (cl->used && now - cl->opened > METRICS_CLIENT_TIMEOUT_NANOS) closeClient(srv, cl);
+    }
+}
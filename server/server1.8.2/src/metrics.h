@@ -0,0 +1,70 @@
+// metrics.h: server counters, and an optional plain HTTP endpoint serving
+// them in the Prometheus text format (metrics-port in server.properties,
+// default 0 = off). Not in the real source. The endpoint's sockets sit on
+// the main loop's own poller next to the game ones, and a scrape is
+// answered right there on the main thread: everything it reads belongs to
+// that thread anyway, and a response is a few KB
+//
+// GET /metrics answers with the metrics, anything else with a 404. Every
+// connection is closed once answered, and dropped after a few seconds if
+// it never sends a complete request
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "net/net_socket.h"
+#include "net/packet.h"
+#include <stdbool.h>
+
+struct MinecraftServer;
+
+// kick reasons are counted by their exact text, up to this many distinct ones
+#define METRICS_MAX_KICK_REASONS 32
+// scrapes being answered at once, any more wait in the listen backlog
+#define METRICS_MAX_CLIENTS 8
+#define METRICS_REQUEST_MAX 2048
+
+typedef struct {
+    long long bytesIn, bytesOut;
+    long long packetsIn[PACKET_COUNT];
+
+    char kickReasons[METRICS_MAX_KICK_REASONS][PACKET_STRING_LEN + 1];
+    long long kickCounts[METRICS_MAX_KICK_REASONS];
+    int kickReasonCount;
+    long long kicksOther; // past METRICS_MAX_KICK_REASONS distinct reasons
+
+    long long saves;
+    long long saveStart;      // nowNanos() the running save started, 0 if none is
+    long long lastSaveNanos;
+    long long saveTotalNanos;
+} ServerStats;
+
+void ServerStats_countKick(ServerStats* stats, const char* reason);
+
+typedef struct {
+    bool used;
+    sock_t sock;
+    long long opened;         // nowNanos() at accept
+    char request[METRICS_REQUEST_MAX];
+    int requestLen;
+    char* response;           // NULL until the request is complete
+    int responseLen, responseSent;
+} MetricsClient;
+
+typedef struct {
+    bool listening;
+    sock_t listenSock;
+    MetricsClient clients[METRICS_MAX_CLIENTS];
+} MetricsServer;
+
+// starts listening on port, registered with srv's poller. false if it can't
+bool Metrics_listen(struct MinecraftServer* srv, int port);
+
+// handles a poller event if it's one of the endpoint's sockets: accepts,
+// reads a request, writes a response. false if userData isn't one of them
+bool Metrics_handleEvent(struct MinecraftServer* srv, void* userData, bool readable, bool writable, long long now);
+
+// drops clients that have been connected too long. Once per loop iteration
+void Metrics_tick(struct MinecraftServer* srv, long long now);
+
+#endif
@@ -0,0 +1,67 @@
+// net/buffer_pool.c
+
+#include "buffer_pool.h"
+#include <stdlib.h>
+
+// 64, 128, ... 64KB
+#define CLASS_COUNT 11
+
+// how many bytes each size class may keep parked on its free list. Enough
+// for a burst of joins to hand blocks back and forth, not so much that a
+// past burst pins memory forever
+#define MAX_FREE_BYTES_PER_CLASS (512 * 1024)
+
+// a free block's first bytes hold the link to the next one
+typedef struct FreeBlock {
+    struct FreeBlock* next;
+} FreeBlock;
+
+static FreeBlock* sFree[CLASS_COUNT];
+static int sFreeCount[CLASS_COUNT];
+
+static int classFor(int size) {
+    int cls = 0;
+    int classSize = BUFFER_POOL_MIN_SIZE;
+    while (classSize < size) {
+        classSize <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+void* BufferPool_alloc(int size, int* outCapacity) {
+    if (size < 1) size = 1;
+    if (size > BUFFER_POOL_MAX_SIZE) {
+        *outCapacity = size;
+        return malloc((size_t)size);
+    }
+
+    int cls = classFor(size);
+    int classSize = BUFFER_POOL_MIN_SIZE << cls;
+    *outCapacity = classSize;
+    FreeBlock* block = sFree[cls];
+    if (block) {
+        sFree[cls] = block->next;
+        sFreeCount[cls]--;
+        return block;
+    }
+    return malloc((size_t)classSize);
+}
+
+void BufferPool_free(void* block, int capacity) {
+    if (!block) return;
+    if (capacity > BUFFER_POOL_MAX_SIZE) {
+        free(block);
+        return;
+    }
+
+    int cls = classFor(capacity);
+    if (sFreeCount[cls] >= MAX_FREE_BYTES_PER_CLASS / (BUFFER_POOL_MIN_SIZE << cls)) {
+        free(block);
+        return;
+    }
+    FreeBlock* fb = (FreeBlock*)block;
+    fb->next = sFree[cls];
+    sFree[cls] = fb;
+    sFreeCount[cls]++;
+}
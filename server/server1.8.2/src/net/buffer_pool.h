@@ -0,0 +1,27 @@
+// net/buffer_pool.h: recycled power of two sized byte blocks for
+// per-connection buffers (send chain slabs, read buffers, broadcast
+// packets). Not in the real source, which gives every connection its own
+// fixed size ByteBuffers for life. Freed blocks go back on a per size
+// free list instead of to malloc, up to a small cap per size, so
+// connections can start small, grow only while they actually need to
+// (mostly during the level transfer) and shrink back afterwards without
+// hammering the allocator.
+//
+// Main thread only, no locking
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+// smallest and largest pooled block. Requests past the largest still work,
+// they just go straight to malloc/free
+#define BUFFER_POOL_MIN_SIZE 64
+#define BUFFER_POOL_MAX_SIZE (64 * 1024)
+
+// returns a block of at least size bytes, and how big it really is in
+// *outCapacity (use all of it). NULL if out of memory
+void* BufferPool_alloc(int size, int* outCapacity);
+// capacity must be what BufferPool_alloc reported for this block. NULL is
+// a no-op
+void  BufferPool_free(void* block, int capacity);
+
+#endif
@@ -3,6 +3,7 @@
 #include "connection.h"
 #include "packet.h"
 #include "level_send.h"
+#include "buffer_pool.h"
 #include "../server.h"
 #include "../level/level.h"
 #include "../level/tile/tile.h"
@@ -18,7 +19,7 @@ extern void Commands_dispatch(MinecraftServer* srv, Connection* issuer, const ch
 /* wire format helpers, identical convention to the client's net/connection.c */
 
 static void writeByte(Connection* c, unsigned char v) {
-    if (c->writeLen < CONN_WRITE_BUFFER_SIZE) c->writeBuf[c->writeLen++] = v;
+    SendChain_pushCopy(&c->out, &v, 1);
 }
 static void writeU16(Connection* c, unsigned short v) {
     writeByte(c, (unsigned char)(v >> 8));
@@ -58,47 +59,77 @@ void Connection_init(Connection* c, MinecraftServer* server, sock_t sock) {
     c->open = true;
     c->server = server;
     c->playerId = -1;
+    c->gridNode.cell = -1;
+    c->gridNode.owner = c;
+    c->wireIdBySlot = (signed char*)malloc((size_t)server->maxPlayers);
+    if (c->wireIdBySlot) memset(c->wireIdBySlot, -1, (size_t)server->maxPlayers);
+    for (int i = 0; i < PROTOCOL_MAX_PLAYER_IDS; i++) c->slotByWireId[i] = -1;
+    SendChain_init(&c->out, CONN_WRITE_BUFFER_SIZE);
+    SendChain_init(&c->queued, CONN_QUEUE_BUFFER_SIZE);
+    c->readBuf = (unsigned char*)BufferPool_alloc(CONN_READ_INITIAL_SIZE, &c->readCapacity);
+    if (!c->readBuf) c->readCapacity = 0;
     NetSocket_getRemoteAddress(sock, c->remoteAddress, sizeof c->remoteAddress);
     NetSocket_configure(sock);
+    NetPoller_add(&server->poller, sock, c);
 }
 
 void Connection_close(Connection* c) {
     if (!c->open) return;
     c->open = false;
+    NetPoller_remove(&c->server->poller, c->sock);
     NetSocket_close(c->sock);
-    free((void*)c->pendingLevelBytes);
-    c->pendingLevelBytes = NULL;
+    LevelSend_release(c->levelSnapshot);
+    c->levelSnapshot = NULL;
+    SendChain_clear(&c->out);
+    SendChain_clear(&c->queued);
+    BufferPool_free(c->readBuf, c->readCapacity);
+    c->readBuf = NULL;
+    c->readCapacity = 0;
+    c->readLen = 0;
+    free(c->wireIdBySlot);
+    c->wireIdBySlot = NULL;
+    free(c->actionQueue);
+    c->actionQueue = NULL;
+    c->actionQueueCapacity = 0;
+    c->actionQueueCount = 0;
 }
 
 void Connection_sendDirect(Connection* c, const unsigned char* packetBytes, int len) {
-    for (int i = 0; i < len && c->writeLen < CONN_WRITE_BUFFER_SIZE; i++) {
-        c->writeBuf[c->writeLen++] = packetBytes[i];
-    }
+    SendChain_pushCopy(&c->out, packetBytes, len);
+}
+
+// a packet the chain had no room for is gone, and with it whatever it
+// changed: a client missing a SetBlock or a despawn never finds out, so
+// it's kicked rather than left playing on in a world that no longer
+// matches the server's. Not in the real source, whose buffer just
+// overflowed
+static void onSendDropped(Connection* c) {
+    Connection_kick(c, "Couldn't keep up with the server");
 }
 
 void Connection_queueOrSend(Connection* c, const unsigned char* packetBytes, int len) {
-    if (c->spawned) {
-        Connection_sendDirect(c, packetBytes, len);
-        return;
-    }
-    for (int i = 0; i < len && c->queuedLen < CONN_QUEUE_BUFFER_SIZE; i++) {
-        c->queuedBuf[c->queuedLen++] = packetBytes[i];
-    }
+    if (!SendChain_pushCopy(c->spawned ? &c->out : &c->queued, packetBytes, len)) onSendDropped(c);
+}
+
+void Connection_queueOrSendShared(Connection* c, SharedPacket* pkt) {
+    if (!SendChain_pushShared(c->spawned ? &c->out : &c->queued, pkt)) onSendDropped(c);
 }
 
 void Connection_kick(Connection* c, const char* reason) {
     if (c->pendingClose) return; // already kicked, don't restart the grace period
     Log_info("Kicking %s: %s", c->username[0] ? c->username : c->remoteAddress, reason);
+    ServerStats_countKick(&c->server->stats, reason);
 
     writeByte(c, (unsigned char)PACKET_DISCONNECT);
     writeString(c, reason);
 
     // matches PendingDisconnect: a 100 tick grace period (doubled from
     // server1.2's 40) rather than an immediate close, so this Disconnect
-    // packet actually reaches the client before the socket goes away.
-    // Connection_tick counts it down
+    // packet actually reaches the client before the socket goes away. Kept
+    // as a deadline rather than counted per Connection_tick, which now runs
+    // whenever the poller wakes rather than on a fixed 5ms sleep
     c->pendingClose = true;
-    c->closeGraceTicks = 100;
+    c->closeDeadline = Server_nowNanos() + CONN_CLOSE_GRACE_NANOS;
     c->loggedIn = false; // stop processing any further packets from this connection
 }
 
@@ -159,8 +190,31 @@ static void handleLogin(Connection* c, const unsigned char* f) {
     // Gates whether the client's own local Bedrock break guard allows it
     writeByte(c, PlayerList_contains(&c->server->admins, username) ? 100 : 0);
 
-    size_t total = (size_t)c->server->level.width * c->server->level.height * c->server->level.depth;
-    LevelSend_start(c, c->server->level.blocks, (int)total);
+    // may not attach right away if the compression pool is saturated,
+    // driveLevelSend keeps retrying until it does
+    LevelSend_start(c, &c->server->level);
+}
+
+// the next free slot at the back of the SetBlock/Move queue, growing the
+// ring first if it's full. NULL only if that allocation fails
+static QueuedAction* pushAction(Connection* c) {
+    if (c->actionQueueCount == c->actionQueueCapacity) {
+        int newCapacity = c->actionQueueCapacity ? c->actionQueueCapacity * 2 : CONN_ACTION_QUEUE_INITIAL;
+        if (newCapacity > CONN_ACTION_QUEUE_CAP) newCapacity = CONN_ACTION_QUEUE_CAP;
+        if (newCapacity == c->actionQueueCapacity) return NULL;
+        QueuedAction* grown = (QueuedAction*)malloc((size_t)newCapacity * sizeof *grown);
+        if (!grown) return NULL;
+        for (int i = 0; i < c->actionQueueCount; i++) {
+            grown[i] = c->actionQueue[(c->actionQueueHead + i) % c->actionQueueCapacity];
+        }
+        free(c->actionQueue);
+        c->actionQueue = grown;
+        c->actionQueueCapacity = newCapacity;
+        c->actionQueueHead = 0;
+    }
+    QueuedAction* a = &c->actionQueue[(c->actionQueueHead + c->actionQueueCount) % c->actionQueueCapacity];
+    c->actionQueueCount++;
+    return a;
 }
 
 // server1.6: enqueues a SetBlock item instead of validating/applying it
@@ -173,12 +227,12 @@ static void handleSetBlock(Connection* c, const unsigned char* f) {
         Connection_kick(c, "Cheat detected: Too much lag");
         return;
     }
-    QueuedAction* a = &c->actionQueue[(c->actionQueueHead + c->actionQueueCount) % CONN_ACTION_QUEUE_CAP];
+    QueuedAction* a = pushAction(c);
+    if (!a) return;
     a->isSetBlock = true;
     a->sbX = readU16(f); a->sbY = readU16(f + 2); a->sbZ = readU16(f + 4);
     a->sbMode = f[6];
     a->sbType = f[7];
-    c->actionQueueCount++;
 }
 
 // the real per-item SetBlock validation/apply logic, unchanged from before
@@ -261,11 +315,11 @@ static void handleTeleportSelf(Connection* c, const unsigned char* f) {
         Connection_kick(c, "Cheat detected: Too much lag");
         return;
     }
-    QueuedAction* a = &c->actionQueue[(c->actionQueueHead + c->actionQueueCount) % CONN_ACTION_QUEUE_CAP];
+    QueuedAction* a = pushAction(c);
+    if (!a) return;
     a->isSetBlock = false;
     a->mvX = (short)readU16(f + 1); a->mvY = (short)readU16(f + 3); a->mvZ = (short)readU16(f + 5);
     a->mvYaw = (signed char)f[7]; a->mvPitch = (signed char)f[8];
-    c->actionQueueCount++;
 }
 
 // the throttled movement rebroadcast: every other dequeued update is acted
@@ -310,45 +364,48 @@ static bool processMoveItem(Connection* c, int x, int y, int z, signed char yawB
     int n = 0;
     if (outOfDeltaRange || periodicResync) {
         pkt[n++] = (unsigned char)PACKET_TELEPORT;
-        pkt[n++] = (unsigned char)c->playerId;
+        pkt[n++] = 0; // per viewer id, see Server_broadcastPlayerPacket
         pkt[n++] = (unsigned char)(x >> 8); pkt[n++] = (unsigned char)x;
         pkt[n++] = (unsigned char)(y >> 8); pkt[n++] = (unsigned char)y;
         pkt[n++] = (unsigned char)(z >> 8); pkt[n++] = (unsigned char)z;
         pkt[n++] = (unsigned char)yawByte;
         pkt[n++] = (unsigned char)pitchByte;
-        Server_broadcastExcept(c->server, c, pkt, n);
+        Server_broadcastPlayerPacket(c->server, c, pkt, n);
         c->lastX = x; c->lastY = y; c->lastZ = z;
         c->lastYaw = yawByte; c->lastPitch = pitchByte;
+        Server_onPlayerMoved(c->server, c);
         return false; // a resync always stops the drain, even if position itself didn't change
     }
 
     if (posUnchanged) {
         pkt[n++] = (unsigned char)PACKET_LOOK;
-        pkt[n++] = (unsigned char)c->playerId;
+        pkt[n++] = 0; // per viewer id, see Server_broadcastPlayerPacket
         pkt[n++] = (unsigned char)yawByte;
         pkt[n++] = (unsigned char)pitchByte;
-        Server_broadcastExcept(c->server, c, pkt, n);
+        Server_broadcastPlayerPacket(c->server, c, pkt, n);
         c->lastYaw = yawByte; c->lastPitch = pitchByte;
         return true;
     }
 
     if (yawByte == c->lastYaw && pitchByte == c->lastPitch) {
         pkt[n++] = (unsigned char)PACKET_MOVE;
-        pkt[n++] = (unsigned char)c->playerId;
+        pkt[n++] = 0; // per viewer id, see Server_broadcastPlayerPacket
         pkt[n++] = (unsigned char)dx; pkt[n++] = (unsigned char)dy; pkt[n++] = (unsigned char)dz;
-        Server_broadcastExcept(c->server, c, pkt, n);
+        Server_broadcastPlayerPacket(c->server, c, pkt, n);
         c->lastX = x; c->lastY = y; c->lastZ = z;
+        Server_onPlayerMoved(c->server, c);
         return false;
     }
 
     pkt[n++] = (unsigned char)PACKET_MOVE_LOOK;
-    pkt[n++] = (unsigned char)c->playerId;
+    pkt[n++] = 0; // per viewer id, see Server_broadcastPlayerPacket
     pkt[n++] = (unsigned char)dx; pkt[n++] = (unsigned char)dy; pkt[n++] = (unsigned char)dz;
     pkt[n++] = (unsigned char)yawByte;
     pkt[n++] = (unsigned char)pitchByte;
-    Server_broadcastExcept(c->server, c, pkt, n);
+    Server_broadcastPlayerPacket(c->server, c, pkt, n);
     c->lastX = x; c->lastY = y; c->lastZ = z;
     c->lastYaw = yawByte; c->lastPitch = pitchByte;
+    Server_onPlayerMoved(c->server, c);
     return false;
 }
 
@@ -405,7 +462,9 @@ static void handleMessage(Connection* c, const unsigned char* f) {
     unsigned char pkt[1 + 1 + PACKET_STRING_LEN];
     int n = 0;
     pkt[n++] = (unsigned char)PACKET_MESSAGE;
-    pkt[n++] = (unsigned char)c->playerId;
+    // clients only check the sign (negative = system message), so past the
+    // signed byte range any non-negative id will do
+    pkt[n++] = (unsigned char)(c->playerId < PROTOCOL_MAX_PLAYER_IDS ? c->playerId : PROTOCOL_MAX_PLAYER_IDS - 1);
     size_t flen = strlen(formatted);
     if (flen > PACKET_STRING_LEN) flen = PACKET_STRING_LEN;
     for (size_t i = 0; i < (size_t)PACKET_STRING_LEN; i++) {
@@ -425,6 +484,7 @@ static int dispatchOne(Connection* c, const unsigned char* p, int available) {
 
     int need = PacketPayloadLen[id] + 1;
     if (available < need) return 0;
+    c->server->stats.packetsIn[id]++;
 
     const unsigned char* f = p + 1;
 
@@ -454,36 +514,56 @@ static int dispatchOne(Connection* c, const unsigned char* p, int available) {
     return need;
 }
 
-// drives the chunked level send once the background gzip thread has
-// published a result, matching PlayerConnection.flushLevelSend(). Runs a
+// drives the chunked level send as the background gzip workers publish
+// the stream, matching PlayerConnection.flushLevelSend(). Only full chunks
+// go out until the stream is complete, then the short last one. Runs a
 // bounded slice per call so a huge level doesn't stall the tick loop either
 static void driveLevelSend(Connection* c) {
-    if (!c->pendingLevelBytes) return;
+    if (!c->loggedIn || c->spawned) return;
+    if (!c->levelSnapshot && !LevelSend_start(c, &c->server->level)) return;
+    int levelLen;
+    int state = LevelSend_available(c->levelSnapshot, &levelLen);
+    if (state == LEVEL_SEND_FAILED) {
+        // nothing sent yet: just wait for a fresh snapshot. Otherwise the
+        // client already has the start of a stream that will never finish
+        if (c->levelSendOffset > 0) {
+            Connection_kick(c, "Failed to send the level");
+            return;
+        }
+        LevelSend_release(c->levelSnapshot);
+        c->levelSnapshot = NULL;
+        return;
+    }
+    bool complete = state == LEVEL_SEND_DONE;
+
+    int remaining = levelLen - c->levelSendOffset;
+    if (!complete && remaining < PACKET_ARRAY_LEN) return;
 
     if (c->levelSendOffset == 0) {
         writeByte(c, (unsigned char)PACKET_LEVEL_INIT);
     }
 
-    int remaining = c->pendingLevelLen - c->levelSendOffset;
     int chunksThisCall = 0;
     while (remaining > 0 && chunksThisCall < 20) {
+        if (!complete && remaining < PACKET_ARRAY_LEN) break;
         int chunkLen = remaining > PACKET_ARRAY_LEN ? PACKET_ARRAY_LEN : remaining;
-        writeByte(c, (unsigned char)PACKET_LEVEL_CHUNK);
-        writeU16(c, (unsigned short)chunkLen);
-        for (int i = 0; i < PACKET_ARRAY_LEN; i++) {
-            writeByte(c, i < chunkLen ? c->pendingLevelBytes[c->levelSendOffset + i] : 0);
-        }
+        unsigned char chunkPkt[1 + 2 + PACKET_ARRAY_LEN + 1];
+        chunkPkt[0] = (unsigned char)PACKET_LEVEL_CHUNK;
+        chunkPkt[1] = (unsigned char)(chunkLen >> 8);
+        chunkPkt[2] = (unsigned char)chunkLen;
+        LevelSend_copy(c->levelSnapshot, c->levelSendOffset, chunkPkt + 3, chunkLen);
+        memset(chunkPkt + 3 + chunkLen, 0, (size_t)(PACKET_ARRAY_LEN - chunkLen));
         c->levelSendOffset += chunkLen;
-        int percent = (c->levelSendOffset * 100) / c->pendingLevelLen;
-        writeByte(c, (unsigned char)percent);
+        chunkPkt[3 + PACKET_ARRAY_LEN] = (unsigned char)LevelSend_progress(c->levelSnapshot, c->levelSendOffset);
+        Connection_sendDirect(c, chunkPkt, (int)sizeof chunkPkt);
         remaining -= chunkLen;
         chunksThisCall++;
     }
 
-    if (remaining > 0) return; // more to send next tick
+    if (!complete || remaining > 0) return; // more to send next tick
 
-    free((void*)c->pendingLevelBytes);
-    c->pendingLevelBytes = NULL;
+    LevelSend_release(c->levelSnapshot);
+    c->levelSnapshot = NULL;
 
     Level* level = &c->server->level;
     writeByte(c, (unsigned char)PACKET_LEVEL_FINALIZE);
@@ -504,26 +584,10 @@ static void driveLevelSend(Connection* c) {
     c->lastYaw = 0; c->lastPitch = 0;
     c->hasLastPos = true;
 
-    // announce to everyone else with the real slot id, then tell the new
-    // client about everyone already online, matching the real join order
-    unsigned char spawnPkt[1 + 1 + PACKET_STRING_LEN + 2 + 2 + 2 + 1 + 1];
-    int n = 0;
-    spawnPkt[n++] = (unsigned char)PACKET_SPAWN_PLAYER;
-    spawnPkt[n++] = (unsigned char)c->playerId;
-    size_t ulen = strlen(c->username);
-    if (ulen > PACKET_STRING_LEN) ulen = PACKET_STRING_LEN;
-    for (size_t i = 0; i < (size_t)PACKET_STRING_LEN; i++) spawnPkt[n++] = (unsigned char)(i < ulen ? c->username[i] : ' ');
-    spawnPkt[n++] = (unsigned char)(sx >> 8); spawnPkt[n++] = (unsigned char)sx;
-    spawnPkt[n++] = (unsigned char)(sy >> 8); spawnPkt[n++] = (unsigned char)sy;
-    spawnPkt[n++] = (unsigned char)(sz >> 8); spawnPkt[n++] = (unsigned char)sz;
-    spawnPkt[n++] = (unsigned char)angleOut(level->rotSpawn);
-    spawnPkt[n++] = 0;
-    Server_broadcastExcept(c->server, c, spawnPkt, n);
-
     char joinMsg[80];
     snprintf(joinMsg, sizeof joinMsg, "%s joined the game", c->username);
     unsigned char joinPkt[1 + 1 + PACKET_STRING_LEN];
-    n = 0;
+    int n = 0;
     joinPkt[n++] = (unsigned char)PACKET_MESSAGE;
     joinPkt[n++] = (unsigned char)0xFF;
     size_t jlen = strlen(joinMsg);
@@ -531,27 +595,13 @@ static void driveLevelSend(Connection* c) {
     for (size_t i = 0; i < (size_t)PACKET_STRING_LEN; i++) joinPkt[n++] = (unsigned char)(i < jlen ? joinMsg[i] : ' ');
     Server_broadcastAll(c->server, joinPkt, n);
 
-    for (int i = 0; i < c->server->maxPlayers; i++) {
-        Connection* other = c->server->playerSlots[i];
-        if (!other || other == c || !other->spawned) continue;
-        unsigned char otherPkt[1 + 1 + PACKET_STRING_LEN + 2 + 2 + 2 + 1 + 1];
-        int m = 0;
-        otherPkt[m++] = (unsigned char)PACKET_SPAWN_PLAYER;
-        otherPkt[m++] = (unsigned char)other->playerId;
-        size_t olen = strlen(other->username);
-        if (olen > PACKET_STRING_LEN) olen = PACKET_STRING_LEN;
-        for (size_t i = 0; i < (size_t)PACKET_STRING_LEN; i++) otherPkt[m++] = (unsigned char)(i < olen ? other->username[i] : ' ');
-        otherPkt[m++] = (unsigned char)(other->lastX >> 8); otherPkt[m++] = (unsigned char)other->lastX;
-        otherPkt[m++] = (unsigned char)(other->lastY >> 8); otherPkt[m++] = (unsigned char)other->lastY;
-        otherPkt[m++] = (unsigned char)(other->lastZ >> 8); otherPkt[m++] = (unsigned char)other->lastZ;
-        otherPkt[m++] = (unsigned char)other->lastYaw;
-        otherPkt[m++] = (unsigned char)other->lastPitch;
-        Connection_sendDirect(c, otherPkt, m);
-    }
-
     c->spawned = true;
-    Connection_sendDirect(c, c->queuedBuf, c->queuedLen);
-    c->queuedLen = 0;
+    if (!SendChain_moveAll(&c->out, &c->queued)) onSendDropped(c);
+    c->shrinkPending = true;
+
+    // announce to everyone else, then tell the new client about everyone
+    // already online, each under whatever id that viewer knows them by
+    Server_spawnPlayer(c->server, c);
 }
 
 void Connection_tick(Connection* c) {
@@ -559,26 +609,35 @@ void Connection_tick(Connection* c) {
 
     if (c->pendingClose) {
         // just drain the outgoing buffer (the kick/ban Disconnect packet)
-        // and count down, matching PendingDisconnect, no more reading or
-        // dispatching packets from a connection that's on its way out
-        if (c->writeLen > 0) {
-            int n = NetSocket_write(c->sock, c->writeBuf, c->writeLen);
-            if (n > 0) {
-                memmove(c->writeBuf, c->writeBuf + n, (size_t)(c->writeLen - n));
-                c->writeLen -= n;
-            }
-        }
-        if (--c->closeGraceTicks <= 0) Connection_close(c);
+        // until the grace period is up, matching PendingDisconnect, no more
+        // reading or dispatching packets from a connection that's on its way out
+        int sent = SendChain_flush(&c->out, c->sock);
+        if (sent > 0) c->server->stats.bytesOut += sent;
+        if (Server_nowNanos() >= c->closeDeadline) Connection_close(c);
         return;
     }
 
     driveLevelSend(c);
 
-    int spaceLeft = CONN_READ_BUFFER_SIZE - c->readLen;
+    // grow before reading once it's half full, so a client that's got ahead
+    // of the 100 packet dispatch cap still gets read in big pieces
+    if (c->readLen > c->readCapacity / 2 && c->readCapacity < CONN_READ_BUFFER_SIZE) {
+        int grownCapacity;
+        unsigned char* grown = (unsigned char*)BufferPool_alloc(c->readCapacity * 2, &grownCapacity);
+        if (grown) {
+            memcpy(grown, c->readBuf, (size_t)c->readLen);
+            BufferPool_free(c->readBuf, c->readCapacity);
+            c->readBuf = grown;
+            c->readCapacity = grownCapacity;
+        }
+    }
+
+    int spaceLeft = c->readCapacity - c->readLen;
     if (spaceLeft > 0) {
         int n = NetSocket_read(c->sock, c->readBuf + c->readLen, spaceLeft);
         if (n > 0) {
             c->readLen += n;
+            c->server->stats.bytesIn += n;
         } else if (n < 0) {
             Log_warn("%s lost connection suddenly", c->username[0] ? c->username : c->remoteAddress);
             Connection_close(c);
@@ -587,7 +646,8 @@ void Connection_tick(Connection* c) {
     }
 
     int consumedTotal = 0;
-    for (int packets = 0; packets < 100 && consumedTotal < c->readLen; packets++) {
+    int packets = 0;
+    for (; packets < 100 && consumedTotal < c->readLen; packets++) {
         int consumed = dispatchOne(c, c->readBuf + consumedTotal, c->readLen - consumedTotal);
         if (consumed < 0) {
             Log_warn("%s: bad command, dropping connection", c->username[0] ? c->username : c->remoteAddress);
@@ -601,16 +661,44 @@ void Connection_tick(Connection* c) {
         memmove(c->readBuf, c->readBuf + consumedTotal, (size_t)(c->readLen - consumedTotal));
         c->readLen -= consumedTotal;
     }
-
-    if (c->writeLen > 0) {
-        int n = NetSocket_write(c->sock, c->writeBuf, c->writeLen);
-        if (n > 0) {
-            memmove(c->writeBuf, c->writeBuf + n, (size_t)(c->writeLen - n));
-            c->writeLen -= n;
-        } else if (n < 0) {
-            Connection_close(c);
+    c->readBacklog = (packets == 100 && c->readLen > 0);
+    if (c->readLen == 0 && c->readCapacity > CONN_READ_INITIAL_SIZE) {
+        int shrunkCapacity;
+        unsigned char* shrunk = (unsigned char*)BufferPool_alloc(CONN_READ_INITIAL_SIZE, &shrunkCapacity);
+        if (shrunk) {
+            BufferPool_free(c->readBuf, c->readCapacity);
+            c->readBuf = shrunk;
+            c->readCapacity = shrunkCapacity;
         }
     }
+
+    int sent = SendChain_flush(&c->out, c->sock);
+    if (sent < 0) {
+        Connection_close(c);
+        return;
+    }
+    c->server->stats.bytesOut += sent;
+
+    // the level transfer is what grows a connection's buffers the most;
+    // once it's entirely out the door, give that memory back
+    if (c->shrinkPending && c->out.pendingBytes == 0) {
+        c->shrinkPending = false;
+        SendChain_shrink(&c->out);
+        SendChain_clear(&c->queued); // never used again after the join
+    }
+}
+
+bool Connection_needsService(const Connection* c) {
+    if (!c->open) return false;
+    return c->pendingClose || c->readBacklog || (c->loggedIn && !c->spawned);
+}
+
+void Connection_syncPollInterest(Connection* c) {
+    if (!c->open) return;
+    bool want = c->out.pendingBytes > 0;
+    if (want == c->pollWantsWrite) return;
+    c->pollWantsWrite = want;
+    NetPoller_setWantWrite(&c->server->poller, c->sock, c, want);
 }
 
 void Connection_onGameTick(Connection* c) {
@@ -638,7 +726,7 @@ void Connection_onGameTick(Connection* c) {
     bool keepDraining = true;
     while (keepDraining && c->actionQueueCount > 0) {
         QueuedAction item = c->actionQueue[c->actionQueueHead];
-        c->actionQueueHead = (c->actionQueueHead + 1) % CONN_ACTION_QUEUE_CAP;
+        c->actionQueueHead = (c->actionQueueHead + 1) % c->actionQueueCapacity;
         c->actionQueueCount--;
 
         if (item.isSetBlock) {
@@ -648,4 +736,12 @@ void Connection_onGameTick(Connection* c) {
             keepDraining = processMoveItem(c, item.mvX, item.mvY, item.mvZ, item.mvYaw, item.mvPitch);
         }
     }
+
+    // a backlog that grew the ring past its starting size has cleared
+    if (c->actionQueueCount == 0 && c->actionQueueCapacity > CONN_ACTION_QUEUE_INITIAL) {
+        free(c->actionQueue);
+        c->actionQueue = NULL;
+        c->actionQueueCapacity = 0;
+        c->actionQueueHead = 0;
+    }
 }
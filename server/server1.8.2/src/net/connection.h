@@ -5,13 +5,22 @@
 #define NET_CONNECTION_H
 
 #include "net_socket.h"
+#include "send_chain.h"
+#include "packet.h"
+#include "../view_grid.h"
 #include <stdbool.h>
 
 // only ever used as a pointer here, kept opaque to avoid a circular full
 // include with server.h (which holds an array of Connection pointers)
 struct MinecraftServer;
 
+// the read buffer starts at CONN_READ_INITIAL_SIZE, doubles while a
+// client is sending faster than its packets get dispatched, up to
+// CONN_READ_BUFFER_SIZE, and drops back to the initial size once drained
+#define CONN_READ_INITIAL_SIZE  4096
 #define CONN_READ_BUFFER_SIZE   (256 * 1024)
+// most unsent bytes the outgoing chain holds before dropping packets, the
+// size the flat per-connection write buffer used to be
 #define CONN_WRITE_BUFFER_SIZE  (256 * 1024)
 // packets that arrive for this connection before its own join sequence
 // finishes get buffered here instead of interleaving mid-download, matching
@@ -24,9 +33,17 @@ struct MinecraftServer;
 // of being processed inline the moment they arrive. The real cap is checked
 // as "kick if size() > 400 before adding", so 400 is the largest the queue
 // is ever allowed to hold going into a tick; sized with headroom since
-// that's a soft cap enforced by the check, not a hard array bound
+// that's a soft cap enforced by the check, not a hard array bound. The
+// ring itself starts at CONN_ACTION_QUEUE_INITIAL and only grows (up to the
+// cap) while a backlog actually builds up
+#define CONN_ACTION_QUEUE_INITIAL 16
 #define CONN_ACTION_QUEUE_CAP 420
 
+// how long a kicked connection stays open for its Disconnect packet to
+// flush: the real source's 100 ticks of its network loop, which runs about
+// every 5ms
+#define CONN_CLOSE_GRACE_NANOS 500000000LL
+
 typedef struct {
     bool isSetBlock; // true: SetBlock item below is valid. false: Move/Teleport item is valid
     int sbX, sbY, sbZ, sbMode, sbType;
@@ -41,21 +58,43 @@ typedef struct Connection {
 
     struct MinecraftServer* server;
 
-    unsigned char readBuf[CONN_READ_BUFFER_SIZE];
-    int readLen;
-    unsigned char writeBuf[CONN_WRITE_BUFFER_SIZE];
-    int writeLen;
+    // from the buffer pool, see CONN_READ_INITIAL_SIZE
+    unsigned char* readBuf;
+    int readLen, readCapacity;
+    // outgoing bytes, mostly references to broadcast packets shared with
+    // every other recipient (see send_chain.h)
+    SendChain out;
+
+    // event loop bookkeeping, not in the real source. ioReady is set by the
+    // server when the poller reports this socket, readBacklog when the last
+    // tick hit its 100 packet dispatch cap with more already buffered, and
+    // pollWantsWrite mirrors what's currently registered with the poller so
+    // an unchanged interest set doesn't cost a syscall
+    bool ioReady;
+    bool readBacklog;
+    bool pollWantsWrite;
 
     bool loggedIn;
     bool spawned; // true once the join sequence (level send + spawn burst) fully completes
     char username[65];
     int playerId; // slot index once assigned, -1 until then
 
+    // the other players this client has spawned, and the wire id it knows
+    // each one by (see Server_showPlayer). wireIdBySlot has one entry per
+    // server slot, -1 = not spawned here; slotByWireId maps back, -1 = free
+    signed char* wireIdBySlot;
+    short slotByWireId[PROTOCOL_MAX_PLAYER_IDS];
+    int shownCount;
+    // this player's place in the server's view grid, only while in game
+    // with a view-distance set
+    ViewGridNode gridNode;
+
     // matches PendingDisconnect: a kick/ban writes its Disconnect packet then
-    // waits this many more ticks before actually closing, so the message has
-    // time to flush over the wire instead of closing out from under it
+    // waits until closeDeadline (Server_nowNanos()) before actually closing,
+    // so the message has time to flush over the wire instead of closing out
+    // from under it
     bool pendingClose;
-    int closeGraceTicks;
+    long long closeDeadline;
 
     // last position/rotation actually broadcast to other clients, 1/32 fixed
     // point and raw byte-angle units (not yet converted to degrees), used to
@@ -68,8 +107,8 @@ typedef struct Connection {
     // server1.6: shared FIFO for both SetBlock and Move/Teleport packets,
     // drained once per real game tick by Connection_onGameTick instead of
     // being processed the instant each packet arrives
-    QueuedAction actionQueue[CONN_ACTION_QUEUE_CAP];
-    int actionQueueHead, actionQueueCount;
+    QueuedAction* actionQueue; // ring buffer, NULL until first used
+    int actionQueueHead, actionQueueCount, actionQueueCapacity;
 
     // server1.6: chat mute counter ('p' in the real source). Incremented by
     // (message length + 15) * 4 on every chat line; muted once it exceeds
@@ -85,17 +124,17 @@ typedef struct Connection {
     bool solidMode;
 
     // outgoing packets for events that happen elsewhere while this
-    // connection hasn't finished joining yet
-    unsigned char queuedBuf[CONN_QUEUE_BUFFER_SIZE];
-    int queuedLen;
-
-    // background level gzip compression, handed off from a real OS thread
-    // (see level_send.h) once finished; consumed by the chunked send driver.
-    // The thread is detached (nothing needs to join it), so there's no
-    // handle to keep here, just the result it eventually publishes
-    volatile unsigned char* pendingLevelBytes;
-    volatile int pendingLevelLen;
-    int levelSendOffset; // how much of pendingLevelBytes has been chunked out so far
+    // connection hasn't finished joining yet, moved onto out once it has
+    SendChain queued;
+
+    // background level gzip compression (see level_send.h), shared with any
+    // other connection joining at the same level generation; consumed by
+    // the chunked send driver as the compressed stream is published
+    struct LevelSnapshot* levelSnapshot;
+    int levelSendOffset; // how much of the snapshot's bytes has been chunked out so far
+    // set once the join sequence is queued; the next time everything has
+    // actually been flushed, the buffers the transfer grew are handed back
+    bool shrinkPending;
 } Connection;
 
 void Connection_init(Connection* c, struct MinecraftServer* server, sock_t sock);
@@ -109,9 +148,23 @@ void Connection_tick(Connection* c);
 void Connection_onGameTick(Connection* c);
 void Connection_close(Connection* c);
 
+// true while this connection has work pending that no socket readiness
+// event will ever announce: a join in progress (background gzip, chunked
+// level send), a kick grace countdown, or an undispatched read backlog.
+// The server keeps ticking these at the old fixed cadence instead of
+// waiting on the poller
+bool Connection_needsService(const Connection* c);
+// registers write interest with the server's poller while there's unsent
+// data queued on out, and drops it again once flushed
+void Connection_syncPollInterest(Connection* c);
+
 // sends immediately if the join sequence is done, otherwise buffers into
-// queuedBuf, matching PlayerConnection.queueOrSend
+// queued, matching PlayerConnection.queueOrSend. Kicks the connection if
+// the packet doesn't fit
 void Connection_queueOrSend(Connection* c, const unsigned char* packetBytes, int len);
+// the same, queuing a reference to an already encoded broadcast packet
+// instead of a copy
+void Connection_queueOrSendShared(Connection* c, SharedPacket* pkt);
 // always sends immediately regardless of join state, used only for this
 // connection's own join sequence packets (login ack, level transfer, self spawn)
 void Connection_sendDirect(Connection* c, const unsigned char* packetBytes, int len);
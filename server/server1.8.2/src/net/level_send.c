@@ -2,9 +2,11 @@
 
 #include "level_send.h"
 #include "connection.h"
+#include "../level/level.h"
 #include <zlib.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #if defined(_WIN32)
   #include <windows.h>
@@ -12,75 +14,384 @@
   #include <pthread.h>
 #endif
 
-typedef struct {
-    Connection* conn;
-    unsigned char* blocks;
-    int len;
-} LevelSendJob;
+struct LevelSnapshot {
+    int refCount;           // guarded by sLock, the job queue holds one until compressed
+    unsigned int generation; // Level.changeGeneration this was copied at
 
-static void runJob(LevelSendJob* job) {
-    uLong bound = compressBound((uLong)job->len + 4) + 64;
-    unsigned char* out = (unsigned char*)malloc(bound);
-    if (!out) { free(job->blocks); free(job); return; }
+    // the uncompressed stream, the 4 byte length prefix then the blocks,
+    // freed once compressed
+    unsigned char* input;
+    int len;                 // block bytes, not counting the prefix
+
+    // the input split into LEVEL_SEND_PART_SIZE parts the workers deflate
+    // independently, guarded by sLock
+    int partCount;
+    int nextPart;            // the next one no worker has claimed yet
+    int partsDone;
+    int partsPublished;      // parts 0..this-1 are in the published stream
+    bool failed;
+    unsigned long* partCrcs;
+
+    // the compressed stream, a gzip header, the parts in order, then the
+    // trailer. Appended to only under sLock, and only ever read below
+    // `published`, so the main thread reads it without the lock. Each part
+    // (and partStarts/partLens for it) is set before published moves past it
+    unsigned char** parts;
+    int* partLens;
+    int* partStarts;         // where each part begins in the stream
+    unsigned char trailer[8];
+    int published;           // stream bytes readable, atomic
+    int state;               // LEVEL_SEND_STREAMING/_DONE/_FAILED, atomic
+};
+
+// gcc/clang builtins (MinGW included): a release store after the bytes it
+// publishes, an acquire load before reading them
+static int loadAcquire(const int* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void storeRelease(int* p, int v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+// the last part starting at or before offset. partStarts of parts not yet
+// published read as INT_MAX, and may be written while this searches, hence
+// the relaxed atomic loads
+static int findPart(const LevelSnapshot* snap, int offset) {
+    int lo = 0, hi = snap->partCount - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (__atomic_load_n(&snap->partStarts[mid], __ATOMIC_RELAXED) <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+// the 10 byte header zlib itself writes for a gzip stream: no name, no
+// mtime, unix
+static const unsigned char GZIP_HEADER[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+
+// the latest snapshot handed out, itself holding one reference so the
+// next joiner can reuse it. Only ever touched from the main thread
+static LevelSnapshot* sCurrent = NULL;
+
+// fixed worker pool. The job ring never needs more room than there are
+// workers, since LevelSend_start refuses new snapshots once sInFlight
+// (queued + being compressed) reaches sWorkerCount
+static LevelSnapshot* sJobs[LEVEL_SEND_MAX_WORKERS];
+static int sJobHead = 0, sJobCount = 0;
+static int sWorkerCount = 0;
+static int sInFlight = 0; // guarded by sLock, decremented by the workers
+static int sLevel = Z_DEFAULT_COMPRESSION;
+static int sStrategy = Z_DEFAULT_STRATEGY;
+
+#if defined(_WIN32)
+static CRITICAL_SECTION sLock;
+static CONDITION_VARIABLE sJobReady;
+#else
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sJobReady = PTHREAD_COND_INITIALIZER;
+#endif
+
+static void lock(void) {
+#if defined(_WIN32)
+    EnterCriticalSection(&sLock);
+#else
+    pthread_mutex_lock(&sLock);
+#endif
+}
+static void unlock(void) {
+#if defined(_WIN32)
+    LeaveCriticalSection(&sLock);
+#else
+    pthread_mutex_unlock(&sLock);
+#endif
+}
+
+static void freeParts(LevelSnapshot* snap) {
+    if (snap->parts)
+        for (int i = 0; i < snap->partCount; i++) free(snap->parts[i]);
+    free(snap->parts);
+    free(snap->partLens);
+    free(snap->partStarts);
+    free(snap->partCrcs);
+}
+
+void LevelSend_release(LevelSnapshot* snap) {
+    if (!snap) return;
+    lock();
+    int left = --snap->refCount;
+    unlock();
+    if (left > 0) return;
+    free(snap->input);
+    freeParts(snap);
+    free(snap);
+}
+
+int LevelSend_available(LevelSnapshot* snap, int* outLen) {
+    // state first: once it reads DONE, published is already final
+    int state = loadAcquire(&snap->state);
+    *outLen = loadAcquire(&snap->published);
+    return state;
+}
+
+void LevelSend_copy(LevelSnapshot* snap, int offset, unsigned char* out, int len) {
+    while (len > 0 && offset < (int)sizeof GZIP_HEADER) {
+        *out++ = GZIP_HEADER[offset++];
+        len--;
+    }
+    for (int i = findPart(snap, offset); len > 0 && i < snap->partCount; i++) {
+        int from = offset - snap->partStarts[i];
+        int n = snap->partLens[i] - from;
+        if (n <= 0) continue;
+        if (n > len) n = len;
+        memcpy(out, snap->parts[i] + from, (size_t)n);
+        out += n;
+        offset += n;
+        len -= n;
+    }
+    if (len > 0) {
+        int from = offset - (snap->partStarts[snap->partCount - 1] + snap->partLens[snap->partCount - 1]);
+        memcpy(out, snap->trailer + from, (size_t)len);
+    }
+}
+
+int LevelSend_progress(LevelSnapshot* snap, int offset) {
+    int state, published;
+    state = LevelSend_available(snap, &published);
+    if (state == LEVEL_SEND_DONE && offset >= published) return 100;
+    int lo = findPart(snap, offset);
+    // through part lo's input, scaled by how far into its output offset is
+    long long total = (long long)snap->len + 4;
+    long long inputDone = (long long)lo * LEVEL_SEND_PART_SIZE;
+    long long partInput = total - inputDone < LEVEL_SEND_PART_SIZE ? total - inputDone : LEVEL_SEND_PART_SIZE;
+    int into = offset - snap->partStarts[lo];
+    if (into > 0 && snap->partLens[lo] > 0) {
+        if (into > snap->partLens[lo]) into = snap->partLens[lo];
+        inputDone += partInput * into / snap->partLens[lo];
+    }
+    int percent = (int)(inputDone * 100 / total);
+    return percent > 99 ? 99 : percent;
+}
+
+// deflates one part of the input as a raw deflate fragment, pigz style.
+// Not in the real source, which runs the whole map through one
+// GZIPOutputStream on one thread. Priming the dictionary with the 32K
+// before the part keeps the ratio close to a single stream's, and ending
+// every part but the last on a sync flush leaves it byte aligned without
+// a final block, so the parts concatenate into one valid deflate stream.
+// NULL if it fails
+static unsigned char* compressPart(LevelSnapshot* snap, int part, int* outLen, unsigned long* outCrc) {
+    size_t total = (size_t)snap->len + 4;
+    size_t start = (size_t)part * LEVEL_SEND_PART_SIZE;
+    size_t partLen = total - start < LEVEL_SEND_PART_SIZE ? total - start : LEVEL_SEND_PART_SIZE;
+    bool last = part == snap->partCount - 1;
+    const unsigned char* in = snap->input + start;
 
     z_stream strm;
     memset(&strm, 0, sizeof strm);
-    // 15+16 = zlib's windowBits convention for producing a gzip wrapped
-    // stream instead of a raw zlib one
-    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
-        free(out); free(job->blocks); free(job);
-        return;
+    // negative windowBits = raw deflate, the gzip wrapper is added around
+    // the concatenated parts instead
+    if (deflateInit2(&strm, sLevel, Z_DEFLATED, -15, 8, sStrategy) != Z_OK) return NULL;
+    if (start > 0) {
+        size_t dictLen = start < 32768 ? start : 32768;
+        deflateSetDictionary(&strm, in - dictLen, (uInt)dictLen);
     }
 
-    unsigned char lenPrefix[4] = {
-        (unsigned char)(job->len >> 24), (unsigned char)(job->len >> 16),
-        (unsigned char)(job->len >> 8),  (unsigned char)job->len
-    };
-
+    // the sync flush's empty stored block is 5 bytes on top of the bound
+    uLong bound = deflateBound(&strm, (uLong)partLen) + 16;
+    unsigned char* out = (unsigned char*)malloc(bound);
+    if (!out) {
+        deflateEnd(&strm);
+        return NULL;
+    }
+    strm.next_in = (Bytef*)in;
+    strm.avail_in = (uInt)partLen;
     strm.next_out = out;
     strm.avail_out = (uInt)bound;
+    int ret = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+    bool ok = last ? ret == Z_STREAM_END : ret == Z_OK && strm.avail_in == 0;
+    int len = (int)(bound - strm.avail_out);
+    deflateEnd(&strm);
+    if (!ok) {
+        free(out);
+        return NULL;
+    }
 
-    // two deflate() calls into the same stream, matching the real source
-    // writing the length prefix then the block bytes through one continuous
-    // GZIPOutputStream -- both land in a single gzip member either way
-    strm.next_in = lenPrefix;
-    strm.avail_in = 4;
-    deflate(&strm, Z_NO_FLUSH);
+    // the bound is about the input size, don't hold on to that much
+    unsigned char* shrunk = (unsigned char*)realloc(out, len > 0 ? (size_t)len : 1);
+    *outLen = len;
+    *outCrc = crc32(0L, in, (uInt)partLen);
+    return shrunk ? shrunk : out;
+}
 
-    strm.next_in = job->blocks;
-    strm.avail_in = (uInt)job->len;
-    deflate(&strm, Z_FINISH);
+// appends every finished part that's next in order to the published
+// stream, and the trailer once they all are: the crc32 of the whole input,
+// combined from the parts', and its length. Parts finish out of order, so
+// whichever worker completes the one at the front publishes the run of
+// them behind it too. Call with sLock held
+static void publishParts(LevelSnapshot* snap) {
+    int end = snap->published;
+    while (snap->partsPublished < snap->partCount && snap->parts[snap->partsPublished]) {
+        __atomic_store_n(&snap->partStarts[snap->partsPublished], end, __ATOMIC_RELAXED);
+        end += snap->partLens[snap->partsPublished];
+        snap->partsPublished++;
+    }
+    if (snap->partsPublished < snap->partCount) {
+        storeRelease(&snap->published, end);
+        return;
+    }
 
-    int compressedLen = (int)(bound - strm.avail_out);
-    deflateEnd(&strm);
-    free(job->blocks);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    size_t remaining = (size_t)snap->len + 4;
+    for (int i = 0; i < snap->partCount; i++) {
+        size_t partLen = remaining < LEVEL_SEND_PART_SIZE ? remaining : LEVEL_SEND_PART_SIZE;
+        crc = crc32_combine(crc, snap->partCrcs[i], (z_off_t)partLen);
+        remaining -= partLen;
+    }
+    unsigned int isize = (unsigned int)((size_t)snap->len + 4);
+    unsigned char* t = snap->trailer;
+    t[0] = (unsigned char)crc;   t[1] = (unsigned char)(crc >> 8);
+    t[2] = (unsigned char)(crc >> 16); t[3] = (unsigned char)(crc >> 24);
+    t[4] = (unsigned char)isize; t[5] = (unsigned char)(isize >> 8);
+    t[6] = (unsigned char)(isize >> 16); t[7] = (unsigned char)(isize >> 24);
+    storeRelease(&snap->published, end + (int)sizeof snap->trailer);
+    storeRelease(&snap->state, LEVEL_SEND_DONE);
+}
 
-    // publish length before the pointer, so the moment the main thread sees
-    // pendingLevelBytes go non-null, pendingLevelLen is already valid
-    job->conn->pendingLevelLen = compressedLen;
-    job->conn->pendingLevelBytes = out;
+#if defined(_WIN32)
+static DWORD WINAPI workerMain(LPVOID arg) {
+#else
+static void* workerMain(void* arg) {
+#endif
+    (void)arg;
+    for (;;) {
+        lock();
+        while (sJobCount == 0) {
+#if defined(_WIN32)
+            SleepConditionVariableCS(&sJobReady, &sLock, INFINITE);
+#else
+            pthread_cond_wait(&sJobReady, &sLock);
+#endif
+        }
+        // workers claim parts rather than whole snapshots, so every idle
+        // worker helps with the oldest one. It leaves the ring once its
+        // last part is claimed
+        LevelSnapshot* snap = sJobs[sJobHead];
+        int part = snap->nextPart++;
+        if (snap->nextPart == snap->partCount) {
+            sJobHead = (sJobHead + 1) % LEVEL_SEND_MAX_WORKERS;
+            sJobCount--;
+        }
+        bool skip = snap->failed;
+        unlock();
+
+        int partLen = 0;
+        unsigned long partCrc = 0;
+        unsigned char* out = skip ? NULL : compressPart(snap, part, &partLen, &partCrc);
 
-    free(job);
+        lock();
+        if (out) {
+            snap->parts[part] = out;
+            snap->partLens[part] = partLen;
+            snap->partCrcs[part] = partCrc;
+            if (!snap->failed) publishParts(snap);
+        } else if (!snap->failed) {
+            // a stream can't skip a part, so the whole snapshot is lost
+            snap->failed = true;
+            storeRelease(&snap->state, LEVEL_SEND_FAILED);
+        }
+        bool lastDone = ++snap->partsDone == snap->partCount;
+        if (lastDone) {
+            // nothing reads the input anymore, not even as a dictionary
+            free(snap->input);
+            snap->input = NULL;
+            sInFlight--;
+        }
+        unlock();
+        if (lastDone) LevelSend_release(snap); // the queue's own reference
+    }
+#if defined(_WIN32)
+    return 0;
+#else
+    return NULL;
+#endif
 }
 
+void LevelSend_init(int workerCount, int level, int strategy) {
+    sLevel = level;
+    sStrategy = strategy;
+    if (workerCount < 1) workerCount = 1;
+    if (workerCount > LEVEL_SEND_MAX_WORKERS) workerCount = LEVEL_SEND_MAX_WORKERS;
 #if defined(_WIN32)
-static DWORD WINAPI threadMain(LPVOID arg) { runJob((LevelSendJob*)arg); return 0; }
+    InitializeCriticalSection(&sLock);
+    InitializeConditionVariable(&sJobReady);
+#endif
+    for (int i = 0; i < workerCount; i++) {
+#if defined(_WIN32)
+        HANDLE h = CreateThread(NULL, 0, workerMain, NULL, 0, NULL);
+        if (!h) break;
+        CloseHandle(h); // detached: the pool lives as long as the process
 #else
-static void* threadMain(void* arg) { runJob((LevelSendJob*)arg); return NULL; }
+        pthread_t t;
+        if (pthread_create(&t, NULL, workerMain, NULL) != 0) break;
+        pthread_detach(t);
 #endif
+        sWorkerCount++;
+    }
+}
 
-void LevelSend_start(Connection* conn, const unsigned char* blocks, int len) {
-    LevelSendJob* job = (LevelSendJob*)malloc(sizeof *job);
-    job->conn = conn;
-    job->blocks = (unsigned char*)malloc((size_t)len);
-    memcpy(job->blocks, blocks, (size_t)len);
-    job->len = len;
+bool LevelSend_start(Connection* conn, const Level* level) {
+    // a failed snapshot is never reused, the next joiner retries with a new one
+    if (!sCurrent || sCurrent->generation != level->changeGeneration ||
+        loadAcquire(&sCurrent->state) == LEVEL_SEND_FAILED) {
+        lock();
+        bool poolFull = sInFlight >= sWorkerCount;
+        unlock();
+        if (poolFull) return false;
 
+        size_t len = (size_t)level->width * level->height * level->depth;
+        LevelSnapshot* snap = (LevelSnapshot*)calloc(1, sizeof *snap);
+        if (!snap) return false;
+        // the length prefix goes in front of the copy, so the parts split
+        // one flat buffer
+        snap->input = (unsigned char*)malloc(len + 4);
+        snap->partCount = (int)((len + 4 + LEVEL_SEND_PART_SIZE - 1) / LEVEL_SEND_PART_SIZE);
+        snap->parts = (unsigned char**)calloc((size_t)snap->partCount, sizeof *snap->parts);
+        snap->partLens = (int*)calloc((size_t)snap->partCount, sizeof *snap->partLens);
+        snap->partStarts = (int*)calloc((size_t)snap->partCount, sizeof *snap->partStarts);
+        snap->partCrcs = (unsigned long*)calloc((size_t)snap->partCount, sizeof *snap->partCrcs);
+        if (!snap->input || !snap->parts || !snap->partLens || !snap->partStarts || !snap->partCrcs) {
+            free(snap->input);
+            freeParts(snap);
+            free(snap);
+            return false;
+        }
+        snap->input[0] = (unsigned char)(len >> 24);
+        snap->input[1] = (unsigned char)(len >> 16);
+        snap->input[2] = (unsigned char)(len >> 8);
+        snap->input[3] = (unsigned char)len;
+        Level_copyBlocks(level, snap->input + 4);
+        snap->len = (int)len;
+        for (int i = 0; i < snap->partCount; i++) snap->partStarts[i] = INT_MAX;
+        snap->published = (int)sizeof GZIP_HEADER;
+        snap->state = LEVEL_SEND_STREAMING;
+        snap->generation = level->changeGeneration;
+        snap->refCount = 2; // sCurrent's, plus the job queue's
+
+        lock();
+        sJobs[(sJobHead + sJobCount) % LEVEL_SEND_MAX_WORKERS] = snap;
+        sJobCount++;
+        sInFlight++;
 #if defined(_WIN32)
-    HANDLE h = CreateThread(NULL, 0, threadMain, job, 0, NULL);
-    if (h) CloseHandle(h); // detached: nothing needs to join it
+        WakeAllConditionVariable(&sJobReady);
 #else
-    pthread_t t;
-    if (pthread_create(&t, NULL, threadMain, job) == 0) pthread_detach(t);
+        pthread_cond_broadcast(&sJobReady); // every worker can take a part
 #endif
+        unlock();
+
+        LevelSend_release(sCurrent);
+        sCurrent = snap;
+    }
+
+    lock();
+    sCurrent->refCount++;
+    unlock();
+    conn->levelSnapshot = sCurrent;
+    return true;
 }
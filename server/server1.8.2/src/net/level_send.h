@@ -1,18 +1,72 @@
 // net/level_send.h: background level compression, ported from
-// server/a.java (LevelSendThread). A real OS thread, matching the original's
-// architecture, so a big map never stalls the main tick loop
+// server/a.java (LevelSendThread). Real OS threads, matching the original's
+// architecture, so a big map never stalls the main tick loop, but a fixed
+// pool of them instead of the original's one new thread per login
 
 #ifndef LEVEL_SEND_H
 #define LEVEL_SEND_H
 
+#include <stdbool.h>
+
 struct Connection;
+struct Level;
+
+// upper bound on level-send-workers, anything past this is clamped
+#define LEVEL_SEND_MAX_WORKERS 16
+
+// each snapshot is deflated as independent parts of this many input bytes,
+// so however many workers are idle share one map (pigz's default size)
+#define LEVEL_SEND_PART_SIZE (128 * 1024)
+
+// one compressed copy of the whole level, shared by every connection that
+// joins while the level is unchanged. Not in the real source, which gzips
+// a fresh copy per login; reference counted so it outlives whichever
+// joiners are still streaming it after a newer one replaces it. The wire
+// format is gzip containing a 4 byte big endian uncompressed length prefix
+// followed by the raw block bytes, matching server/a.java's
+// writeInt(len)+write(blocks) through a single GZIPOutputStream
+typedef struct LevelSnapshot LevelSnapshot;
+
+// starts workerCount compression threads (level-send-workers in
+// server.properties), which split each snapshot between them, compressing at level (0..9, -1 = zlib's default)
+// with one of zlib's deflate strategies (Z_RLE, ...), from
+// level-send-compression and level-send-strategy. The stream is gzip
+// whatever these are, so clients can't tell. Call once, from Server_init
+void LevelSend_init(int workerCount, int level, int strategy);
+
+// tries to attach conn->levelSnapshot. Reuses the cached snapshot if
+// nothing in the level has changed since it was taken
+// (level->changeGeneration), otherwise copies blocks (the level can keep
+// changing immediately after this returns) and queues a new one for the
+// worker pool. Returns false without attaching anything while every worker
+// already has a snapshot to compress; the caller just retries later, and
+// however many joiners pile up meanwhile all share the next one. Any
+// snapshot taken after conn's login is safe to hand it, since every block
+// change since then is sitting in its queuedBuf already
+bool LevelSend_start(struct Connection* conn, const struct Level* level);
+
+// where a snapshot's compressed stream is at
+enum {
+    LEVEL_SEND_STREAMING, // parts are still being compressed
+    LEVEL_SEND_DONE,      // the whole gzip member is readable
+    LEVEL_SEND_FAILED     // out of memory partway, the stream never completes
+};
+
+// the snapshot's state, and in *outLen how many bytes of its stream can be
+// read so far. Not in the real source, which only sends anything once the
+// whole map is gzipped: here the workers publish the stream in order as
+// its parts finish, so the first chunks go out while the rest of the map
+// is still compressing. Never blocks, the bytes below *outLen are fixed
+// and stay valid until released
+int LevelSend_available(LevelSnapshot* snap, int* outLen);
+// copies len stream bytes starting at offset, all below what
+// LevelSend_available last reported
+void LevelSend_copy(LevelSnapshot* snap, int offset, unsigned char* out, int len);
+// how far through the map a client that has received offset stream bytes
+// is, 0..100, for LevelChunk's percent byte. Only 100 at the very end
+int LevelSend_progress(LevelSnapshot* snap, int offset);
 
-// copies blocks (the caller's buffer can be freed/reused immediately after
-// this returns), compresses in the background, and publishes the result
-// into conn->pendingLevelBytes/pendingLevelLen once done. The wire format is
-// gzip containing a 4 byte big endian uncompressed length prefix followed by
-// the raw block bytes, matching server/a.java's writeInt(len)+write(blocks)
-// through a single GZIPOutputStream
-void LevelSend_start(struct Connection* conn, const unsigned char* blocks, int len);
+// drops one reference, freeing the snapshot once nothing uses it anymore
+void LevelSend_release(LevelSnapshot* snap);
 
 #endif
@@ -3,11 +3,13 @@
 #include "net_socket.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #if defined(_WIN32)
   #include <ws2tcpip.h>
 #else
   #include <sys/socket.h>
+  #include <sys/uio.h>
   #include <sys/select.h>
   #include <sys/time.h>
   #include <netinet/in.h>
@@ -19,6 +21,16 @@
   #include <errno.h>
 #endif
 
+#if defined(__linux__)
+  #include <sys/epoll.h>
+#endif
+
+#if defined(_WIN32)
+  #define pollSockets(fds, count, timeoutMs) WSAPoll((fds), (ULONG)(count), (timeoutMs))
+#else
+  #define pollSockets(fds, count, timeoutMs) poll((fds), (nfds_t)(count), (timeoutMs))
+#endif
+
 static void ensureWinsockInit(void) {
 #if defined(_WIN32)
     static int wsaInited = 0;
@@ -137,3 +149,155 @@ int NetSocket_write(sock_t sock, const void* buf, int len) {
     }
     return n;
 }
+
+int NetSocket_writev(sock_t sock, const NetSendBuf* bufs, int count) {
+    if (count > NET_MAX_SEND_BUFS) count = NET_MAX_SEND_BUFS;
+#if defined(_WIN32)
+    WSABUF wsaBufs[NET_MAX_SEND_BUFS];
+    for (int i = 0; i < count; i++) {
+        wsaBufs[i].buf = (CHAR*)bufs[i].data;
+        wsaBufs[i].len = (ULONG)bufs[i].len;
+    }
+    DWORD sent = 0;
+    if (WSASend(sock, wsaBufs, (DWORD)count, &sent, 0, NULL, NULL) != 0) {
+        if (WSAGetLastError() == WSAEWOULDBLOCK) return 0;
+        return -1;
+    }
+    return (int)sent;
+#else
+    struct iovec iov[NET_MAX_SEND_BUFS];
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = (void*)bufs[i].data;
+        iov[i].iov_len = (size_t)bufs[i].len;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+  #if defined(MSG_NOSIGNAL)
+    int flags = MSG_NOSIGNAL; // a peer that's gone away is an error return, not a SIGPIPE
+  #else
+    int flags = 0;
+  #endif
+    ssize_t n = sendmsg(sock, &msg, flags);
+    if (n < 0) {
+        if (errno == EWOULDBLOCK || errno == EAGAIN) return 0;
+        return -1;
+    }
+    return (int)n;
+#endif
+}
+
+/* readiness polling */
+
+int NetPoller_init(NetPoller* p) {
+    memset(p, 0, sizeof *p);
+    p->epollFd = -1;
+#if defined(__linux__)
+    p->epollFd = epoll_create1(0);
+    if (p->epollFd >= 0) return 1;
+#endif
+    p->fdCapacity = 16;
+    p->fds = (struct pollfd*)malloc((size_t)p->fdCapacity * sizeof *p->fds);
+    p->fdUserData = (void**)malloc((size_t)p->fdCapacity * sizeof *p->fdUserData);
+    return (p->fds && p->fdUserData) ? 1 : 0;
+}
+
+static int findPollIndex(const NetPoller* p, sock_t sock) {
+    for (int i = 0; i < p->fdCount; i++) {
+        if (p->fds[i].fd == sock) return i;
+    }
+    return -1;
+}
+
+int NetPoller_add(NetPoller* p, sock_t sock, void* userData) {
+#if defined(__linux__)
+    if (p->epollFd >= 0) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof ev);
+        ev.events = EPOLLIN;
+        ev.data.ptr = userData;
+        return epoll_ctl(p->epollFd, EPOLL_CTL_ADD, sock, &ev) == 0 ? 1 : 0;
+    }
+#endif
+    if (p->fdCount == p->fdCapacity) {
+        int newCapacity = p->fdCapacity * 2;
+        struct pollfd* fds = (struct pollfd*)realloc(p->fds, (size_t)newCapacity * sizeof *fds);
+        if (!fds) return 0;
+        p->fds = fds;
+        void** userDatas = (void**)realloc(p->fdUserData, (size_t)newCapacity * sizeof *userDatas);
+        if (!userDatas) return 0;
+        p->fdUserData = userDatas;
+        p->fdCapacity = newCapacity;
+    }
+    p->fds[p->fdCount].fd = sock;
+    p->fds[p->fdCount].events = POLLIN;
+    p->fds[p->fdCount].revents = 0;
+    p->fdUserData[p->fdCount] = userData;
+    p->fdCount++;
+    return 1;
+}
+
+void NetPoller_setWantWrite(NetPoller* p, sock_t sock, void* userData, bool wantWrite) {
+#if defined(__linux__)
+    if (p->epollFd >= 0) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof ev);
+        ev.events = EPOLLIN | (wantWrite ? EPOLLOUT : 0);
+        ev.data.ptr = userData;
+        epoll_ctl(p->epollFd, EPOLL_CTL_MOD, sock, &ev);
+        return;
+    }
+#endif
+    int i = findPollIndex(p, sock);
+    if (i < 0) return;
+    p->fds[i].events = (short)(POLLIN | (wantWrite ? POLLOUT : 0));
+    p->fdUserData[i] = userData;
+}
+
+void NetPoller_remove(NetPoller* p, sock_t sock) {
+#if defined(__linux__)
+    if (p->epollFd >= 0) {
+        // pre-2.6.9 kernels insist on a non-null event even for DEL
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof ev);
+        epoll_ctl(p->epollFd, EPOLL_CTL_DEL, sock, &ev);
+        return;
+    }
+#endif
+    int i = findPollIndex(p, sock);
+    if (i < 0) return;
+    p->fdCount--;
+    p->fds[i] = p->fds[p->fdCount];
+    p->fdUserData[i] = p->fdUserData[p->fdCount];
+}
+
+int NetPoller_wait(NetPoller* p, NetPollEvent* out, int maxEvents, int timeoutMs) {
+    if (timeoutMs < 0) timeoutMs = 0;
+#if defined(__linux__)
+    if (p->epollFd >= 0) {
+        struct epoll_event evs[64];
+        if (maxEvents > 64) maxEvents = 64;
+        int n = epoll_wait(p->epollFd, evs, maxEvents, timeoutMs);
+        if (n < 0) return 0; // EINTR: just report nothing, the caller loops anyway
+        for (int i = 0; i < n; i++) {
+            out[i].userData = evs[i].data.ptr;
+            out[i].readable = (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0;
+            out[i].writable = (evs[i].events & EPOLLOUT) != 0;
+        }
+        return n;
+    }
+#endif
+    int ready = pollSockets(p->fds, p->fdCount, timeoutMs);
+    if (ready <= 0) return 0;
+    int n = 0;
+    for (int i = 0; i < p->fdCount && n < maxEvents; i++) {
+        short re = p->fds[i].revents;
+        if (!re) continue;
+        out[n].userData = p->fdUserData[i];
+        out[n].readable = (re & (POLLIN | POLLERR | POLLHUP)) != 0;
+        out[n].writable = (re & POLLOUT) != 0;
+        n++;
+    }
+    return n;
+}
@@ -8,6 +8,7 @@
 #define NET_SOCKET_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
 #if defined(_WIN32)
   // must precede any transitive <windows.h> include, or its old winsock.h
@@ -18,6 +19,7 @@
   #include <winsock2.h>
   typedef SOCKET sock_t;
 #else
+  #include <poll.h>
   typedef int sock_t;
 #endif
 
@@ -39,8 +41,57 @@ void NetSocket_close(sock_t sock);
 int NetSocket_read(sock_t sock, void* buf, int len);
 int NetSocket_write(sock_t sock, const void* buf, int len);
 
+// one piece of a gathered write, see NetSocket_writev
+typedef struct {
+    const void* data;
+    int len;
+} NetSendBuf;
+
+// most pieces NetSocket_writev takes per call, the rest wait for the next
+#define NET_MAX_SEND_BUFS 64
+
+// not in the real source: writes several separate buffers with a single
+// syscall (sendmsg, or WSASend on Windows), in order, as if they were one.
+// Same return convention as NetSocket_write
+int NetSocket_writev(sock_t sock, const NetSendBuf* bufs, int count);
+
 // matches com.mojang.a.b's captured InetAddress string, used for IP ban
 // checks and logging. Writes an empty string on failure
 void NetSocket_getRemoteAddress(sock_t sock, char* out, size_t outSize);
 
+/* readiness polling */
+
+// not part of the real source, which busy polls its non-blocking channels
+// with a fixed sleep in between. Lets the main loop block until a socket
+// actually has something to do or the next game tick is due, instead of
+// waking every 5ms regardless. epoll on Linux, plain poll() everywhere else
+// (WSAPoll on Windows), and as a runtime fallback if epoll_create1 fails
+typedef struct NetPoller {
+    int epollFd; // -1 when the poll() arrays below are in use instead
+
+    struct pollfd* fds;
+    void** fdUserData;
+    int fdCount, fdCapacity;
+} NetPoller;
+
+typedef struct {
+    void* userData; // whatever was passed to NetPoller_add for this socket
+    bool readable;  // also set on error/hangup, so the next read surfaces it
+    bool writable;
+} NetPollEvent;
+
+// returns 1 on success, 0 on failure
+int  NetPoller_init(NetPoller* p);
+// every socket starts out read-interested only
+int  NetPoller_add(NetPoller* p, sock_t sock, void* userData);
+// toggles write interest on top of the always-on read interest. Level
+// triggered, so only ask for it while there's actually unsent data
+void NetPoller_setWantWrite(NetPoller* p, sock_t sock, void* userData, bool wantWrite);
+// must be called before NetSocket_close, or the poll() fallback can end up
+// watching a recycled descriptor
+void NetPoller_remove(NetPoller* p, sock_t sock);
+// blocks up to timeoutMs (0 = just check, never -1 here since the game tick
+// always has a deadline). Returns how many entries of out were filled
+int  NetPoller_wait(NetPoller* p, NetPollEvent* out, int maxEvents, int timeoutMs);
+
 #endif
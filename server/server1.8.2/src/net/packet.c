@@ -19,3 +19,9 @@ const int PacketPayloadLen[PACKET_COUNT] = {
     1 + 64,          // Message
     64               // Disconnect
 };
+
+const char* const PacketName[PACKET_COUNT] = {
+    "login", "ping", "level_init", "level_chunk", "level_finalize",
+    "set_block_cs", "set_block_sc", "spawn_player", "teleport", "move_look",
+    "move", "look", "despawn_player", "message", "disconnect"
+};
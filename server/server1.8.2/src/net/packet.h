@@ -35,10 +35,17 @@ enum {
     PACKET_COUNT          = 15
 };
 
+// player ids are a signed byte with -1 meaning "yourself", so any one
+// client can only ever tell 128 other players apart (ids 0-127)
+#define PROTOCOL_MAX_PLAYER_IDS 128
+
 #define PACKET_STRING_LEN 64
 #define PACKET_ARRAY_LEN  1024
 
 // payload byte length after the leading id byte, indexed by packet id
 extern const int PacketPayloadLen[PACKET_COUNT];
+// lowercase names ("login", "level_chunk", ...), indexed by packet id. Not
+// in the real source, only used to label metrics
+extern const char* const PacketName[PACKET_COUNT];
 
 #endif
@@ -0,0 +1,183 @@
+// net/send_chain.c
+
+#include "send_chain.h"
+#include "buffer_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+// private slab block size for SendChain_pushCopy, header included. Big
+// enough that a level chunk packet or a burst of small per-connection
+// replies lands in one piece, small enough to not matter per idle connection
+#define PRIVATE_SLAB_SIZE 4096
+
+// packets come from the buffer pool, and get to keep whatever slack the
+// pool's rounding up leaves past capacity
+static SharedPacket* allocPacket(int capacity) {
+    int blockSize;
+    SharedPacket* pkt = (SharedPacket*)BufferPool_alloc((int)sizeof *pkt + capacity, &blockSize);
+    if (!pkt) return NULL;
+    pkt->refCount = 1;
+    pkt->len = 0;
+    pkt->capacity = blockSize - (int)sizeof *pkt;
+    return pkt;
+}
+
+static int packetBlockSize(const SharedPacket* pkt) {
+    return pkt->capacity + (int)sizeof *pkt;
+}
+
+SharedPacket* SharedPacket_create(const unsigned char* bytes, int len) {
+    SharedPacket* pkt = allocPacket(len);
+    if (!pkt) return NULL;
+    memcpy(pkt->bytes, bytes, (size_t)len);
+    pkt->len = len;
+    return pkt;
+}
+
+void SharedPacket_release(SharedPacket* pkt) {
+    if (pkt && --pkt->refCount == 0) BufferPool_free(pkt, packetBlockSize(pkt));
+}
+
+void SendChain_init(SendChain* chain, int limit) {
+    memset(chain, 0, sizeof *chain);
+    chain->limit = limit;
+}
+
+void SendChain_clear(SendChain* chain) {
+    for (int i = 0; i < chain->count; i++) {
+        SharedPacket_release(chain->segs[(chain->head + i) % chain->capacity].pkt);
+    }
+    free(chain->segs);
+    SharedPacket_release(chain->spare);
+    int limit = chain->limit;
+    SendChain_init(chain, limit);
+}
+
+static SendSegment* tailSegment(SendChain* chain) {
+    if (chain->count == 0) return NULL;
+    return &chain->segs[(chain->head + chain->count - 1) % chain->capacity];
+}
+
+static bool pushSegment(SendChain* chain, SharedPacket* pkt, int offset) {
+    if (chain->count == chain->capacity) {
+        int newCapacity = chain->capacity ? chain->capacity * 2 : 16;
+        SendSegment* grown = (SendSegment*)malloc((size_t)newCapacity * sizeof *grown);
+        if (!grown) return false;
+        // unwrap the ring while copying, so head starts back at 0
+        for (int i = 0; i < chain->count; i++) grown[i] = chain->segs[(chain->head + i) % chain->capacity];
+        free(chain->segs);
+        chain->segs = grown;
+        chain->capacity = newCapacity;
+        chain->head = 0;
+    }
+    SendSegment* seg = &chain->segs[(chain->head + chain->count) % chain->capacity];
+    seg->pkt = pkt;
+    seg->offset = offset;
+    chain->count++;
+    return true;
+}
+
+bool SendChain_pushShared(SendChain* chain, SharedPacket* pkt) {
+    if (!pkt || chain->pendingBytes + pkt->len > chain->limit) return false;
+    if (!pushSegment(chain, pkt, 0)) return false;
+    pkt->refCount++;
+    chain->pendingBytes += pkt->len;
+    return true;
+}
+
+bool SendChain_pushCopy(SendChain* chain, const unsigned char* bytes, int len) {
+    if (len <= 0) return true;
+    if (chain->pendingBytes + len > chain->limit) return false;
+
+    // the tail is only writable if this chain is its sole owner. That can
+    // be a broadcast packet every other recipient has finished with, which
+    // is fine: nobody else will ever read it again
+    SendSegment* tail = tailSegment(chain);
+    SharedPacket* slab = tail ? tail->pkt : NULL;
+    if (!slab || slab->refCount != 1 || slab->capacity - slab->len < len) {
+        if (chain->spare && len <= chain->spare->capacity) {
+            slab = chain->spare;
+            chain->spare = NULL;
+        } else {
+            int minCapacity = PRIVATE_SLAB_SIZE - (int)sizeof *slab;
+            slab = allocPacket(len > minCapacity ? len : minCapacity);
+            if (!slab) return false;
+        }
+        if (!pushSegment(chain, slab, 0)) {
+            SharedPacket_release(slab);
+            return false;
+        }
+    }
+
+    memcpy(slab->bytes + slab->len, bytes, (size_t)len);
+    slab->len += len;
+    chain->pendingBytes += len;
+    return true;
+}
+
+bool SendChain_moveAll(SendChain* dst, SendChain* src) {
+    bool all = true;
+    for (int i = 0; i < src->count; i++) {
+        SendSegment* seg = &src->segs[(src->head + i) % src->capacity];
+        int remaining = seg->pkt->len - seg->offset;
+        if (dst->pendingBytes + remaining <= dst->limit && pushSegment(dst, seg->pkt, seg->offset)) {
+            dst->pendingBytes += remaining;
+        } else {
+            SharedPacket_release(seg->pkt);
+            all = false;
+        }
+    }
+    src->head = 0;
+    src->count = 0;
+    src->pendingBytes = 0;
+    return all;
+}
+
+int SendChain_flush(SendChain* chain, sock_t sock) {
+    if (chain->count == 0) return 0;
+
+    NetSendBuf bufs[NET_MAX_SEND_BUFS];
+    int bufCount = 0;
+    for (int i = 0; i < chain->count && bufCount < NET_MAX_SEND_BUFS; i++) {
+        SendSegment* seg = &chain->segs[(chain->head + i) % chain->capacity];
+        bufs[bufCount].data = seg->pkt->bytes + seg->offset;
+        bufs[bufCount].len = seg->pkt->len - seg->offset;
+        bufCount++;
+    }
+
+    int n = NetSocket_writev(sock, bufs, bufCount);
+    if (n <= 0) return n;
+
+    chain->pendingBytes -= n;
+    int left = n;
+    while (left > 0) {
+        SendSegment* seg = &chain->segs[chain->head];
+        int segRemaining = seg->pkt->len - seg->offset;
+        if (left < segRemaining) {
+            seg->offset += left;
+            break;
+        }
+        left -= segRemaining;
+
+        SharedPacket* done = seg->pkt;
+        chain->head = (chain->head + 1) % chain->capacity;
+        chain->count--;
+        if (done->refCount == 1 && packetBlockSize(done) == PRIVATE_SLAB_SIZE && !chain->spare) {
+            done->len = 0;
+            chain->spare = done;
+        } else {
+            SharedPacket_release(done);
+        }
+    }
+    return n;
+}
+
+void SendChain_shrink(SendChain* chain) {
+    SharedPacket_release(chain->spare);
+    chain->spare = NULL;
+    if (chain->count > 0) return;
+    free(chain->segs);
+    chain->segs = NULL;
+    chain->head = 0;
+    chain->capacity = 0;
+}
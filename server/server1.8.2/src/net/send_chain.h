@@ -0,0 +1,73 @@
+// net/send_chain.h: a connection's outgoing bytes, as a queue of
+// references to packet buffers rather than one flat private copy. Not in
+// the real source, which writes every packet into each recipient's own
+// ByteBuffer. Here a broadcast is encoded once into a SharedPacket, and
+// each recipient's chain just takes a reference to it; a flush hands the
+// queued pieces to the socket in a single gathered write
+//
+// Everything here runs on the main thread only (the reference counts are
+// plain ints, not atomics)
+
+#ifndef SEND_CHAIN_H
+#define SEND_CHAIN_H
+
+#include "net_socket.h"
+#include <stdbool.h>
+
+// immutable while shared: only ever appended to (see SendChain_pushCopy)
+// once a single chain holds the last reference. Allocated from the
+// buffer pool, so capacity may be a little more than was asked for
+typedef struct SharedPacket {
+    int refCount;
+    int len, capacity;
+    unsigned char bytes[];
+} SharedPacket;
+
+// a new packet holding a copy of bytes, with one reference owned by the
+// caller. NULL if out of memory
+SharedPacket* SharedPacket_create(const unsigned char* bytes, int len);
+void SharedPacket_release(SharedPacket* pkt); // NULL is a no-op
+
+typedef struct {
+    SharedPacket* pkt;
+    int offset; // how much of pkt has already been written out
+} SendSegment;
+
+typedef struct SendChain {
+    SendSegment* segs; // ring buffer
+    int head, count, capacity;
+
+    int pendingBytes;
+    // pushes that would take pendingBytes past this are dropped whole, the
+    // same cap the old flat buffer had, minus its habit of truncating
+    // whichever packet happened to straddle the end. Connections kick a
+    // client whose chain refuses a push (see Connection_queueOrSend)
+    int limit;
+
+    // a fully written private slab kept for the next SendChain_pushCopy,
+    // so steady small writes don't malloc every time
+    SharedPacket* spare;
+} SendChain;
+
+void SendChain_init(SendChain* chain, int limit);
+// releases every queued reference and the chain's own storage
+void SendChain_clear(SendChain* chain);
+
+// queues a reference to pkt (the caller keeps its own). false if dropped
+bool SendChain_pushShared(SendChain* chain, SharedPacket* pkt);
+// queues a private copy of bytes, appended to the chain's tail slab when
+// it has room. false if dropped
+bool SendChain_pushCopy(SendChain* chain, const unsigned char* bytes, int len);
+// moves everything queued on src to the end of dst, in order, leaving src
+// empty. Anything past dst's limit is dropped, and false returned
+bool SendChain_moveAll(SendChain* dst, SendChain* src);
+
+// hands the spare slab back to the pool and, if nothing is queued, the
+// segment ring too. For once a burst (like the level transfer) is over
+void SendChain_shrink(SendChain* chain);
+
+// writes as much as the socket takes in one gathered write. Returns bytes
+// written, 0 if nothing was pending or it would block, -1 on error
+int SendChain_flush(SendChain* chain, sock_t sock);
+
+#endif
@@ -1,73 +1,166 @@
 // player_list.c
 
 #include "player_list.h"
-#include <stdio.h>
+#include "log.h"
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
+#define PLAYER_LIST_MIN_CAPACITY 64
+// stale lines tolerated on top of one per live entry before compacting
+#define PLAYER_LIST_COMPACT_SLACK 64
+
 static void toLower(char* out, const char* s, size_t outSize) {
     size_t i = 0;
     for (; s[i] && i < outSize - 1; i++) out[i] = (char)tolower((unsigned char)s[i]);
     out[i] = '\0';
 }
 
-static void save(const PlayerList* list) {
-    FILE* f = fopen(list->path, "w");
+// FNV-1a
+static unsigned int hashName(const char* s) {
+    unsigned int h = 2166136261u;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+// the slot holding lower, or the empty one ending its probe run
+static int findSlot(const PlayerList* list, const char* lower, unsigned int hash) {
+    int mask = list->capacity - 1;
+    int i = (int)(hash & (unsigned int)mask);
+    while (list->slots[i].name[0]) {
+        if (list->slots[i].hash == hash && strcmp(list->slots[i].name, lower) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static bool grow(PlayerList* list) {
+    int capacity = list->capacity ? list->capacity * 2 : PLAYER_LIST_MIN_CAPACITY;
+    PlayerListSlot* slots = (PlayerListSlot*)calloc((size_t)capacity, sizeof *slots);
+    if (!slots) return false;
+    PlayerListSlot* old = list->slots;
+    int oldCapacity = list->capacity;
+    list->slots = slots;
+    list->capacity = capacity;
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].name[0]) list->slots[findSlot(list, old[i].name, old[i].hash)] = old[i];
+    }
+    free(old);
+    return true;
+}
+
+static bool insert(PlayerList* list, const char* lower) {
+    // kept at most 3/4 full, so probe runs stay short
+    if ((list->count + 1) * 4 > list->capacity * 3 && !grow(list)) {
+        Log_warn("Out of memory growing %s, %s not added", list->path, lower);
+        return false;
+    }
+    unsigned int hash = hashName(lower);
+    int i = findSlot(list, lower, hash);
+    if (list->slots[i].name[0]) return false;
+    list->slots[i].hash = hash;
+    snprintf(list->slots[i].name, PLAYER_LIST_ENTRY_LEN, "%s", lower);
+    list->count++;
+    return true;
+}
+
+// backward shift deletion: entries further along the probe run are moved
+// up into the hole, so lookups never need tombstones
+static bool erase(PlayerList* list, const char* lower) {
+    if (list->count == 0) return false;
+    int mask = list->capacity - 1;
+    int i = findSlot(list, lower, hashName(lower));
+    if (!list->slots[i].name[0]) return false;
+    for (int j = (i + 1) & mask; list->slots[j].name[0]; j = (j + 1) & mask) {
+        int home = (int)(list->slots[j].hash & (unsigned int)mask);
+        // j can fill the hole unless its home lies cyclically in (i, j]
+        bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (stays) continue;
+        list->slots[i] = list->slots[j];
+        i = j;
+    }
+    list->slots[i].name[0] = '\0';
+    list->count--;
+    return true;
+}
+
+// rewrites the file as one line per entry, under a temporary name that's
+// renamed over it so a crash midway never loses the list
+static void compact(PlayerList* list) {
+    char temp[270];
+    snprintf(temp, sizeof temp, "%s.tmp", list->path);
+    FILE* f = fopen(temp, "w");
     if (!f) return;
-    for (int i = 0; i < list->count; i++) {
-        fprintf(f, "%s\n", list->entries[i]);
+    for (int i = 0; i < list->capacity; i++) {
+        if (list->slots[i].name[0]) fprintf(f, "%s\n", list->slots[i].name);
+    }
+    bool ok = fclose(f) == 0;
+    if (list->file) fclose(list->file);
+#if defined(_WIN32)
+    if (ok) remove(list->path); // rename won't replace an existing file here
+#endif
+    if (ok && rename(temp, list->path) == 0) list->staleLines = 0;
+    else Log_warn("Failed to rewrite %s", list->path);
+    list->file = fopen(list->path, "a");
+}
+
+static void appendLine(PlayerList* list, const char* prefix, const char* lower) {
+    if (list->rewriteOnChange || list->staleLines > list->count + PLAYER_LIST_COMPACT_SLACK) {
+        compact(list); // already holds this change
+        return;
     }
-    fclose(f);
+    if (!list->file) return;
+    fprintf(list->file, "%s%s\n", prefix, lower);
+    fflush(list->file);
 }
 
 void PlayerList_init(PlayerList* list, const char* path) {
+    memset(list, 0, sizeof *list);
     snprintf(list->path, sizeof list->path, "%s", path);
-    list->count = 0;
+    grow(list);
 
     FILE* f = fopen(path, "r");
-    if (!f) {
-        // matches the real source: create an empty file if missing
-        f = fopen(path, "w");
-        if (f) fclose(f);
-        return;
-    }
-
-    char line[PLAYER_LIST_ENTRY_LEN];
-    while (fgets(line, sizeof line, f) && list->count < PLAYER_LIST_MAX_ENTRIES) {
-        size_t len = strlen(line);
-        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
-        if (len == 0) continue;
-        toLower(list->entries[list->count], line, PLAYER_LIST_ENTRY_LEN);
-        list->count++;
+    if (f) {
+        char line[PLAYER_LIST_ENTRY_LEN + 1];
+        while (fgets(line, sizeof line, f)) {
+            size_t len = strlen(line);
+            while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+            if (len == 0) continue;
+            char lower[PLAYER_LIST_ENTRY_LEN];
+            if (line[0] == '-') {
+                toLower(lower, line + 1, sizeof lower);
+                erase(list, lower);
+                list->staleLines += 2; // the removal and the line it cancels
+            } else {
+                toLower(lower, line, sizeof lower);
+                if (!insert(list, lower)) list->staleLines++;
+            }
+        }
+        fclose(f);
     }
-    fclose(f);
+    // a missing file is created empty, matching the real source
+    if (!f || list->staleLines > 0) compact(list);
+    else list->file = fopen(path, "a");
 }
 
 bool PlayerList_contains(const PlayerList* list, const char* name) {
+    if (list->count == 0) return false;
     char lower[PLAYER_LIST_ENTRY_LEN];
     toLower(lower, name, sizeof lower);
-    for (int i = 0; i < list->count; i++) {
-        if (strcmp(list->entries[i], lower) == 0) return true;
-    }
-    return false;
+    return list->slots[findSlot(list, lower, hashName(lower))].name[0] != '\0';
 }
 
 void PlayerList_add(PlayerList* list, const char* name) {
-    if (PlayerList_contains(list, name) || list->count >= PLAYER_LIST_MAX_ENTRIES) return;
-    toLower(list->entries[list->count], name, PLAYER_LIST_ENTRY_LEN);
-    list->count++;
-    save(list);
+    char lower[PLAYER_LIST_ENTRY_LEN];
+    toLower(lower, name, sizeof lower);
+    if (!lower[0] || !insert(list, lower)) return;
+    appendLine(list, "", lower);
 }
 
 void PlayerList_remove(PlayerList* list, const char* name) {
     char lower[PLAYER_LIST_ENTRY_LEN];
     toLower(lower, name, sizeof lower);
-    for (int i = 0; i < list->count; i++) {
-        if (strcmp(list->entries[i], lower) == 0) {
-            memcpy(list->entries[i], list->entries[list->count - 1], PLAYER_LIST_ENTRY_LEN);
-            list->count--;
-            save(list);
-            return;
-        }
-    }
+    if (!erase(list, lower)) return;
+    list->staleLines += 2;
+    appendLine(list, "-", lower);
 }
@@ -5,23 +5,42 @@
 #define PLAYER_LIST_H
 
 #include <stdbool.h>
+#include <stdio.h>
 
-#define PLAYER_LIST_MAX_ENTRIES 256
 #define PLAYER_LIST_ENTRY_LEN   64
 
+// not in the real source, which keeps a HashSet and rewrites the whole file
+// on every change: entries live in an open addressing hash table (linear
+// probing, grown as needed) so a lookup costs the same for a ban list of a
+// million names as for one of ten. Changes are appended to the file, a
+// removal as a "-name" line, and the file is compacted back to one plain
+// line per entry once the stale lines outnumber the live ones. Lists other
+// programs read as they are (players.txt) set rewriteOnChange instead
+typedef struct {
+    unsigned int hash;
+    char name[PLAYER_LIST_ENTRY_LEN]; // "" = empty slot
+} PlayerListSlot;
+
 typedef struct {
     char path[256];
     // every real call site constructs this case-insensitive (caseSensitive
     // always false), so that's the only mode this port implements
-    char entries[PLAYER_LIST_MAX_ENTRIES][PLAYER_LIST_ENTRY_LEN];
+    PlayerListSlot* slots;
+    int capacity;                     // a power of two
     int count;
+    FILE* file;                       // path, open for appending
+    int staleLines;                   // lines in the file compaction would drop
+    // rewrite the whole file on every change, as the real source does,
+    // rather than append. For the online roster, which outside tools read
+    // as the list of who's on and which churns on every join and leave
+    bool rewriteOnChange;
 } PlayerList;
 
 // loads from path, creating an empty file if it doesn't exist yet
 void PlayerList_init(PlayerList* list, const char* path);
-// every add/remove immediately rewrites the whole file, matching the real
-// source's lack of batching. Order is not preserved (the real source backs
-// this with a HashSet), not a bug to "fix" if a diff looks reshuffled
+// appends the change to the file (or rewrites it, see rewriteOnChange). Order is not preserved (the real source
+// backs this with a HashSet), not a bug to "fix" if a compacted file looks
+// reshuffled
 void PlayerList_add(PlayerList* list, const char* name);
 void PlayerList_remove(PlayerList* list, const char* name);
 bool PlayerList_contains(const PlayerList* list, const char* name);
@@ -1,9 +1,15 @@
 // server.c: MinecraftServer singleton, ported from server/MinecraftServer.java
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "server.h"
 #include "net/connection.h"
 #include "net/packet.h"
+#include "net/level_send.h"
 #include "level/level.h"
+#include "level/region_ticks.h"
+#include "level/level_sections.h"
+#include "level/level_codec.h"
 #include "level/tile/tile.h"
 #include "stdin_reader.h"
 #include "log.h"
@@ -12,13 +18,10 @@
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <zlib.h>
 
 #if defined(_WIN32)
   #include <windows.h>
-  static void sleepMs(int ms) { Sleep((DWORD)ms); }
-#else
-  #include <unistd.h>
-  static void sleepMs(int ms) { usleep((useconds_t)ms * 1000); }
 #endif
 
 static long long nowNanos(void) {
@@ -35,6 +38,25 @@ static long long nowNanos(void) {
 #endif
 }
 
+long long Server_nowNanos(void) {
+    return nowNanos();
+}
+
+// with view-distance set, a player is spawned for another once within that
+// many blocks, but only despawned again once this much further out, so
+// someone walking along the edge doesn't flicker in and out
+#define VIEW_HIDE_MARGIN 8
+
+// with view-distance set, how often (in ticks) everyone's visibility gets
+// rechecked, on top of the immediate recheck whenever a player crosses
+// into another grid cell
+#define VIEW_RECHECK_TICKS 10
+
+// level-send-strategy's values, in zlib's own strategy order
+static const char* const SEND_STRATEGY_NAMES[] = { "default", "filtered", "huffman", "rle" };
+static const int SEND_STRATEGIES[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE };
+#define SEND_STRATEGY_COUNT 4
+
 static void loadProperties(MinecraftServer* srv) {
     // matches Properties round-tripping: load what's there, default the
     // rest, always re-save so a fresh install gets a populated file
@@ -44,6 +66,23 @@ static void loadProperties(MinecraftServer* srv) {
     srv->maxPlayers = 16;
     srv->isPublic = true;
     srv->maxConnections = 3;
+    srv->levelSendWorkers = 2;
+    srv->levelSendCompression = -1;
+    srv->levelSendStrategy = 0;
+    srv->saveCodec = LEVEL_CODEC_GZIP;
+    srv->saveCompression = -1;
+    srv->tileTickWorkers = 0;
+    srv->sectionStorage = false;
+    srv->nativeFormat = false;
+    srv->journalEnabled = true;
+    srv->journalSyncTicks = 20;
+    srv->autosaveTicks = 1200;
+    srv->viewDistance = 0;
+    srv->perfLogSeconds = 300;
+    srv->perfDumpFile[0] = '\0';
+    srv->metricsPort = 0;
+    srv->logMaxKb = 8192;
+    srv->logFiles = 5;
 
     FILE* f = fopen("server.properties", "r");
     if (f) {
@@ -64,6 +103,33 @@ static void loadProperties(MinecraftServer* srv) {
             else if (strcmp(key, "max-players") == 0) srv->maxPlayers = atoi(value);
             else if (strcmp(key, "public") == 0) srv->isPublic = (strcmp(value, "true") == 0);
             else if (strcmp(key, "max-connections") == 0) srv->maxConnections = atoi(value);
+            else if (strcmp(key, "level-send-workers") == 0) srv->levelSendWorkers = atoi(value);
+            else if (strcmp(key, "level-send-compression") == 0) srv->levelSendCompression = atoi(value);
+            else if (strcmp(key, "level-send-strategy") == 0) {
+                for (int i = 0; i < SEND_STRATEGY_COUNT; i++) {
+                    if (strcmp(value, SEND_STRATEGY_NAMES[i]) == 0) srv->levelSendStrategy = i;
+                }
+            }
+            else if (strcmp(key, "save-codec") == 0) {
+                srv->saveCodec = LevelCodec_byName(value);
+                if (srv->saveCodec < 0 || !LevelCodec_available(srv->saveCodec)) {
+                    Log_warn("save-codec %s isn't available in this build, using gzip", value);
+                    srv->saveCodec = LEVEL_CODEC_GZIP;
+                }
+            }
+            else if (strcmp(key, "save-compression") == 0) srv->saveCompression = atoi(value);
+            else if (strcmp(key, "tile-tick-workers") == 0) srv->tileTickWorkers = atoi(value);
+            else if (strcmp(key, "level-storage") == 0) srv->sectionStorage = (strcmp(value, "sections") == 0);
+            else if (strcmp(key, "level-format") == 0) srv->nativeFormat = (strcmp(value, "native") == 0);
+            else if (strcmp(key, "level-journal") == 0) srv->journalEnabled = (strcmp(value, "true") == 0);
+            else if (strcmp(key, "journal-sync-ticks") == 0) srv->journalSyncTicks = atoi(value);
+            else if (strcmp(key, "autosave-ticks") == 0) srv->autosaveTicks = atoi(value);
+            else if (strcmp(key, "view-distance") == 0) srv->viewDistance = atoi(value);
+            else if (strcmp(key, "perf-log-seconds") == 0) srv->perfLogSeconds = atoi(value);
+            else if (strcmp(key, "perf-dump-file") == 0) snprintf(srv->perfDumpFile, sizeof srv->perfDumpFile, "%s", value);
+            else if (strcmp(key, "metrics-port") == 0) srv->metricsPort = atoi(value);
+            else if (strcmp(key, "log-max-kb") == 0) srv->logMaxKb = atoi(value);
+            else if (strcmp(key, "log-files") == 0) srv->logFiles = atoi(value);
         }
         fclose(f);
     }
@@ -71,6 +137,20 @@ static void loadProperties(MinecraftServer* srv) {
     if (srv->maxPlayers < 1) srv->maxPlayers = 1;
     if (srv->maxPlayers > SERVER_MAX_PLAYERS) srv->maxPlayers = SERVER_MAX_PLAYERS;
     if (srv->maxConnections < 1) srv->maxConnections = 1;
+    if (srv->levelSendWorkers < 1) srv->levelSendWorkers = 1;
+    if (srv->levelSendWorkers > LEVEL_SEND_MAX_WORKERS) srv->levelSendWorkers = LEVEL_SEND_MAX_WORKERS;
+    if (srv->levelSendCompression < -1 || srv->levelSendCompression > 9) srv->levelSendCompression = -1;
+    if (srv->saveCompression != -1) srv->saveCompression = LevelCodec_clampLevel(srv->saveCodec, srv->saveCompression);
+    if (srv->tileTickWorkers < 0) srv->tileTickWorkers = 0;
+    if (srv->tileTickWorkers > REGION_TICKS_MAX_WORKERS) srv->tileTickWorkers = REGION_TICKS_MAX_WORKERS;
+    if (srv->journalSyncTicks < 1) srv->journalSyncTicks = 1;
+    if (srv->autosaveTicks < 20) srv->autosaveTicks = 20;
+    if (srv->viewDistance < 0) srv->viewDistance = 0;
+    if (srv->perfLogSeconds < 0) srv->perfLogSeconds = 0;
+    if (srv->metricsPort < 0 || srv->metricsPort > 65535) srv->metricsPort = 0;
+    if (srv->logMaxKb < 0) srv->logMaxKb = 0;
+    if (srv->logFiles < 0) srv->logFiles = 0;
+    if (srv->logFiles > 99) srv->logFiles = 99;
 
     FILE* out = fopen("server.properties", "w");
     if (out) {
@@ -87,6 +167,23 @@ static void loadProperties(MinecraftServer* srv) {
         // bug, since it's a pure persistence glitch with no gameplay effect
         // and no strong reason to deliberately carry it forward
         fprintf(out, "max-connections=%d\n", srv->maxConnections);
+        fprintf(out, "level-send-workers=%d\n", srv->levelSendWorkers);
+        fprintf(out, "level-send-compression=%d\n", srv->levelSendCompression);
+        fprintf(out, "level-send-strategy=%s\n", SEND_STRATEGY_NAMES[srv->levelSendStrategy]);
+        fprintf(out, "save-codec=%s\n", LevelCodec_name(srv->saveCodec));
+        fprintf(out, "save-compression=%d\n", srv->saveCompression);
+        fprintf(out, "tile-tick-workers=%d\n", srv->tileTickWorkers);
+        fprintf(out, "level-storage=%s\n", srv->sectionStorage ? "sections" : "flat");
+        fprintf(out, "level-format=%s\n", srv->nativeFormat ? "native" : "java");
+        fprintf(out, "level-journal=%s\n", srv->journalEnabled ? "true" : "false");
+        fprintf(out, "journal-sync-ticks=%d\n", srv->journalSyncTicks);
+        fprintf(out, "autosave-ticks=%d\n", srv->autosaveTicks);
+        fprintf(out, "view-distance=%d\n", srv->viewDistance);
+        fprintf(out, "perf-log-seconds=%d\n", srv->perfLogSeconds);
+        fprintf(out, "perf-dump-file=%s\n", srv->perfDumpFile);
+        fprintf(out, "metrics-port=%d\n", srv->metricsPort);
+        fprintf(out, "log-max-kb=%d\n", srv->logMaxKb);
+        fprintf(out, "log-files=%d\n", srv->logFiles);
         fclose(out);
     }
 }
@@ -94,50 +191,118 @@ static void loadProperties(MinecraftServer* srv) {
 bool Server_init(MinecraftServer* srv) {
     memset(srv, 0, sizeof *srv);
     loadProperties(srv);
+    Log_start((long long)srv->logMaxKb * 1024, srv->logFiles);
 
-    Tile_registerAll();
+    srv->playerSlots = (Connection**)calloc((size_t)srv->maxPlayers, sizeof *srv->playerSlots);
+    srv->freeSlots = (int*)malloc((size_t)srv->maxPlayers * sizeof *srv->freeSlots);
+    if (!srv->playerSlots || !srv->freeSlots) {
+        Log_severe("Out of memory allocating %d player slots", srv->maxPlayers);
+        return false;
+    }
+    // pushed highest first, so slots are handed out lowest first like the
+    // real source's scan, at least until some get freed out of order
+    for (int i = 0; i < srv->maxPlayers; i++) srv->freeSlots[i] = srv->maxPlayers - 1 - i;
+    srv->freeSlotCount = srv->maxPlayers;
 
-    if (!Level_load(&srv->level)) {
+    Tile_registerAll();
+    LevelSend_init(srv->levelSendWorkers, srv->levelSendCompression, SEND_STRATEGIES[srv->levelSendStrategy]);
+    RegionTicks_init(srv->tileTickWorkers);
+
+    // Level_load also replays any journaled changes on top of the save
+    Level_useNativeFormat(srv->nativeFormat);
+    Level_setSaveCodec(srv->saveCodec, srv->saveCompression);
+    bool loaded = Level_load(&srv->level);
+    if (!loaded) {
+        if (!BlockJournal_setAside()) return false;
         Log_info("Generating a new level...");
         Level_init(&srv->level, 256, 256, 64);
+        // written straight away rather than at the first autosave: the
+        // journal only holds changes on top of a save, so until there is
+        // one a crash would lose every edit made to the new level
+        if (!Level_save(&srv->level)) Log_warn("The new level isn't saved, its journal can't be replayed without it");
+    }
+    if (srv->sectionStorage) {
+        // dirty from the start: a replayed journal may have changed it since the save
+        if (Level_packSections(&srv->level, false)) {
+            const LevelSections* s = srv->level.sections;
+            size_t flat = (size_t)srv->level.width * srv->level.height * srv->level.depth;
+            Log_info("Level stored in sections: %d of %d expanded, %d KB instead of %d KB",
+                     LevelSections_countExpanded(s), s->cols * s->rows * s->layers,
+                     (int)(LevelSections_residentBytes(s) / 1024), (int)(flat / 1024));
+        } else {
+            Log_warn("Out of memory packing the level into sections, keeping it flat");
+        }
+    }
+    if (srv->journalEnabled && BlockJournal_open(&srv->journal, &srv->level)) {
+        srv->level.journal = &srv->journal;
     }
     Level_setListener(&srv->level, Server_onBlockChanged, srv);
 
+    if (srv->viewDistance > 0 &&
+        !ViewGrid_init(&srv->viewGrid, srv->level.width, srv->level.height, srv->viewDistance + VIEW_HIDE_MARGIN)) {
+        Log_severe("Out of memory allocating the view grid");
+        return false;
+    }
+
     PlayerList_init(&srv->admins, "admins.txt");
     PlayerList_init(&srv->bannedNames, "banned.txt");
     PlayerList_init(&srv->bannedIps, "banned-ip.txt");
     PlayerList_init(&srv->onlinePlayers, "players.txt");
+    srv->onlinePlayers.rewriteOnChange = true;
 
+    if (!NetPoller_init(&srv->poller)) {
+        Log_severe("Failed to set up socket polling");
+        return false;
+    }
     if (!NetSocket_listen(&srv->listenSock, srv->port)) {
         Log_severe("Failed to listen on port %d", srv->port);
         return false;
     }
+    // the listen socket's own address doubles as its poller tag, telling
+    // it apart from the Connection* every other registered socket carries
+    NetPoller_add(&srv->poller, srv->listenSock, &srv->listenSock);
+
+    if (srv->metricsPort > 0) {
+        if (Metrics_listen(srv, srv->metricsPort)) Log_info("Serving metrics on port %d", srv->metricsPort);
+        else Log_warn("Failed to listen on metrics port %d, no metrics endpoint", srv->metricsPort);
+    }
 
     StdinReader_start(srv); // server1.6: background stdin admin command reader
+    TickProfiler_init(&srv->profiler, srv->perfLogSeconds, srv->perfDumpFile, nowNanos());
 
     Log_info("Now accepting connections on port %d", srv->port);
     return true;
 }
 
-int Server_findFreeSlot(const MinecraftServer* srv) {
-    for (int i = 0; i < srv->maxPlayers; i++) {
-        if (!srv->playerSlots[i]) return i;
-    }
-    return -1;
+int Server_takeFreeSlot(MinecraftServer* srv) {
+    if (srv->freeSlotCount == 0) return -1;
+    return srv->freeSlots[--srv->freeSlotCount];
 }
 
 void Server_broadcastAll(MinecraftServer* srv, const unsigned char* packetBytes, int len) {
-    for (int i = 0; i < srv->maxPlayers; i++) {
-        Connection* c = srv->playerSlots[i];
-        if (c && c->open) Connection_queueOrSend(c, packetBytes, len);
-    }
+    Server_broadcastExcept(srv, NULL, packetBytes, len);
 }
 
 void Server_broadcastExcept(MinecraftServer* srv, Connection* exclude, const unsigned char* packetBytes, int len) {
+    // encoded once, every recipient just queues a reference to it. Without
+    // the memory for that, each gets its own copy as in the real source
+    SharedPacket* pkt = SharedPacket_create(packetBytes, len);
     for (int i = 0; i < srv->maxPlayers; i++) {
         Connection* c = srv->playerSlots[i];
-        if (c && c != exclude && c->open) Connection_queueOrSend(c, packetBytes, len);
+        if (!c || c == exclude || !c->open) continue;
+        if (pkt) Connection_queueOrSendShared(c, pkt);
+        else Connection_queueOrSend(c, packetBytes, len);
     }
+    SharedPacket_release(pkt);
+}
+
+// horizontal distance check in blocks, always true with unlimited view
+// distance. lastX/lastZ are 1/32 block fixed point
+static bool inViewRange(const MinecraftServer* srv, const Connection* a, const Connection* b, int blocks) {
+    if (srv->viewDistance <= 0) return true;
+    long long dx = a->lastX - b->lastX, dz = a->lastZ - b->lastZ;
+    long long limit = (long long)blocks * 32;
+    return dx * dx + dz * dz <= limit * limit;
 }
 
 void Server_removeConnection(MinecraftServer* srv, Connection* conn) {
@@ -146,9 +311,22 @@ void Server_removeConnection(MinecraftServer* srv, Connection* conn) {
     if (conn->username[0]) PlayerList_remove(&srv->onlinePlayers, conn->username); // new in server1.3
     Log_info("%s disconnected", conn->username[0] ? conn->username : conn->remoteAddress);
     srv->playerSlots[conn->playerId] = NULL;
+    srv->freeSlots[srv->freeSlotCount++] = conn->playerId;
+    if (conn->gridNode.cell >= 0) ViewGrid_remove(&srv->viewGrid, &conn->gridNode);
 
-    unsigned char pkt[2] = { (unsigned char)PACKET_DESPAWN_PLAYER, (unsigned char)conn->playerId };
-    Server_broadcastAll(srv, pkt, 2);
+    for (int i = 0; i < srv->maxPlayers; i++) {
+        Connection* viewer = srv->playerSlots[i];
+        if (!viewer || !viewer->wireIdBySlot || viewer->wireIdBySlot[conn->playerId] < 0) continue;
+        // a viewer that was out of ids may have others waiting for this one
+        bool wasFull = viewer->shownCount == PROTOCOL_MAX_PLAYER_IDS;
+        Server_hidePlayer(srv, viewer, conn);
+        if (!wasFull) continue;
+        for (int j = 0; j < srv->maxPlayers; j++) {
+            Connection* other = srv->playerSlots[j];
+            if (other && other->spawned && other != viewer && inViewRange(srv, viewer, other, srv->viewDistance) &&
+                Server_showPlayer(srv, viewer, other)) break;
+        }
+    }
 
     if (conn->spawned) {
         char msg[80];
@@ -166,6 +344,145 @@ void Server_removeConnection(MinecraftServer* srv, Connection* conn) {
     conn->playerId = -1;
 }
 
+bool Server_showPlayer(MinecraftServer* srv, Connection* viewer, Connection* subject) {
+    (void)srv;
+    if (viewer == subject || !viewer->wireIdBySlot || viewer->wireIdBySlot[subject->playerId] >= 0) return false;
+    if (viewer->shownCount == PROTOCOL_MAX_PLAYER_IDS) return false;
+
+    int id = subject->playerId;
+    if (id >= PROTOCOL_MAX_PLAYER_IDS || viewer->slotByWireId[id] >= 0) {
+        for (id = 0; id < PROTOCOL_MAX_PLAYER_IDS && viewer->slotByWireId[id] >= 0; id++) {}
+    }
+    viewer->slotByWireId[id] = (short)subject->playerId;
+    viewer->wireIdBySlot[subject->playerId] = (signed char)id;
+    viewer->shownCount++;
+
+    unsigned char pkt[1 + 1 + PACKET_STRING_LEN + 2 + 2 + 2 + 1 + 1];
+    int n = 0;
+    pkt[n++] = (unsigned char)PACKET_SPAWN_PLAYER;
+    pkt[n++] = (unsigned char)id;
+    size_t ulen = strlen(subject->username);
+    if (ulen > PACKET_STRING_LEN) ulen = PACKET_STRING_LEN;
+    for (size_t i = 0; i < (size_t)PACKET_STRING_LEN; i++) pkt[n++] = (unsigned char)(i < ulen ? subject->username[i] : ' ');
+    pkt[n++] = (unsigned char)(subject->lastX >> 8); pkt[n++] = (unsigned char)subject->lastX;
+    pkt[n++] = (unsigned char)(subject->lastY >> 8); pkt[n++] = (unsigned char)subject->lastY;
+    pkt[n++] = (unsigned char)(subject->lastZ >> 8); pkt[n++] = (unsigned char)subject->lastZ;
+    pkt[n++] = (unsigned char)subject->lastYaw;
+    pkt[n++] = (unsigned char)subject->lastPitch;
+    Connection_queueOrSend(viewer, pkt, n);
+    return true;
+}
+
+void Server_hidePlayer(MinecraftServer* srv, Connection* viewer, Connection* subject) {
+    (void)srv;
+    if (!viewer->wireIdBySlot) return;
+    int id = viewer->wireIdBySlot[subject->playerId];
+    if (id < 0) return;
+    viewer->wireIdBySlot[subject->playerId] = -1;
+    viewer->slotByWireId[id] = -1;
+    viewer->shownCount--;
+
+    unsigned char pkt[2] = { (unsigned char)PACKET_DESPAWN_PLAYER, (unsigned char)id };
+    Connection_queueOrSend(viewer, pkt, 2);
+}
+
+void Server_spawnPlayer(MinecraftServer* srv, Connection* conn) {
+    if (srv->viewDistance > 0) {
+        ViewGrid_place(&srv->viewGrid, &conn->gridNode,
+                       ViewGrid_cellAt(&srv->viewGrid, conn->lastX >> 5, conn->lastZ >> 5));
+        Server_updateVisibility(srv, conn);
+        return;
+    }
+    for (int i = 0; i < srv->maxPlayers; i++) {
+        Connection* other = srv->playerSlots[i];
+        if (other && other != conn && other->spawned && other->open) Server_showPlayer(srv, other, conn);
+    }
+    for (int i = 0; i < srv->maxPlayers; i++) {
+        Connection* other = srv->playerSlots[i];
+        if (other && other != conn && other->spawned && other->open) Server_showPlayer(srv, conn, other);
+    }
+}
+
+void Server_updateVisibility(MinecraftServer* srv, Connection* conn) {
+    if (srv->viewDistance <= 0 || conn->gridNode.cell < 0) return;
+
+    // drop whoever has gone out of range, both ways round
+    for (int id = 0; id < PROTOCOL_MAX_PLAYER_IDS; id++) {
+        int slot = conn->slotByWireId[id];
+        if (slot < 0) continue;
+        Connection* other = srv->playerSlots[slot];
+        if (!other || inViewRange(srv, conn, other, srv->viewDistance + VIEW_HIDE_MARGIN)) continue;
+        Server_hidePlayer(srv, conn, other);
+        Server_hidePlayer(srv, other, conn);
+    }
+
+    // and pick up whoever has come into it. Anyone within the hide distance
+    // is in one of these cells, since that's the cell size
+    int cells[9];
+    int cellCount = ViewGrid_nearCells(&srv->viewGrid, conn->gridNode.cell, cells);
+    for (int k = 0; k < cellCount; k++) {
+        for (ViewGridNode* node = srv->viewGrid.heads[cells[k]]; node; node = node->next) {
+            Connection* other = (Connection*)node->owner;
+            if (other == conn) continue;
+            if (inViewRange(srv, conn, other, srv->viewDistance)) {
+                Server_showPlayer(srv, conn, other);
+                Server_showPlayer(srv, other, conn);
+            } else if (!inViewRange(srv, conn, other, srv->viewDistance + VIEW_HIDE_MARGIN)) {
+                // other may be showing conn without conn showing it back
+                // (conn's ids were all taken), which the loop above misses
+                Server_hidePlayer(srv, other, conn);
+            }
+        }
+    }
+}
+
+void Server_onPlayerMoved(MinecraftServer* srv, Connection* conn) {
+    if (srv->viewDistance <= 0 || conn->gridNode.cell < 0) return;
+    int cell = ViewGrid_cellAt(&srv->viewGrid, conn->lastX >> 5, conn->lastZ >> 5);
+    if (cell == conn->gridNode.cell) return;
+    ViewGrid_place(&srv->viewGrid, &conn->gridNode, cell);
+    Server_updateVisibility(srv, conn);
+}
+
+void Server_broadcastPlayerPacket(MinecraftServer* srv, Connection* subject, unsigned char* packetBytes, int len) {
+    // with every slot fitting in a byte, every viewer knows subject by the
+    // same id and this is one packet shared by all of them
+    SharedPacket* byWireId[PROTOCOL_MAX_PLAYER_IDS] = {0};
+
+    // with a view distance, everyone who has subject spawned is in the
+    // cells around it (see Server_updateVisibility), so only those get
+    // looked at instead of every slot
+    Connection* candidates[SERVER_MAX_PLAYERS];
+    int candidateCount = 0;
+    if (srv->viewDistance > 0 && subject->gridNode.cell >= 0) {
+        int cells[9];
+        int cellCount = ViewGrid_nearCells(&srv->viewGrid, subject->gridNode.cell, cells);
+        for (int k = 0; k < cellCount; k++) {
+            for (ViewGridNode* node = srv->viewGrid.heads[cells[k]]; node && candidateCount < SERVER_MAX_PLAYERS; node = node->next) {
+                candidates[candidateCount++] = (Connection*)node->owner;
+            }
+        }
+    } else {
+        for (int i = 0; i < srv->maxPlayers; i++) {
+            if (srv->playerSlots[i]) candidates[candidateCount++] = srv->playerSlots[i];
+        }
+    }
+
+    for (int i = 0; i < candidateCount; i++) {
+        Connection* viewer = candidates[i];
+        if (viewer == subject || !viewer->open || !viewer->wireIdBySlot) continue;
+        int id = viewer->wireIdBySlot[subject->playerId];
+        if (id < 0) continue;
+        if (!byWireId[id]) {
+            packetBytes[1] = (unsigned char)id;
+            byWireId[id] = SharedPacket_create(packetBytes, len);
+            if (!byWireId[id]) continue;
+        }
+        Connection_queueOrSendShared(viewer, byWireId[id]);
+    }
+    for (int id = 0; id < PROTOCOL_MAX_PLAYER_IDS; id++) SharedPacket_release(byWireId[id]);
+}
+
 static bool equalsIgnoreCase(const char* a, const char* b) {
     char aa[65], bb[65];
     snprintf(aa, sizeof aa, "%s", a);
@@ -282,44 +599,151 @@ void Server_banIpByName(MinecraftServer* srv, const char* name) {
     }
 }
 
+// the 8 byte SetBlock for a cell as it is now, so a cell that changed
+// several times this tick only ever sends its final state
+static int encodeSetBlock(unsigned char* pkt, const Level* level, int x, int y, int z) {
+    int n = 0;
+    pkt[n++] = (unsigned char)PACKET_SET_BLOCK_SC;
+    pkt[n++] = (unsigned char)(x >> 8); pkt[n++] = (unsigned char)x;
+    pkt[n++] = (unsigned char)(y >> 8); pkt[n++] = (unsigned char)y;
+    pkt[n++] = (unsigned char)(z >> 8); pkt[n++] = (unsigned char)z;
+    pkt[n++] = (unsigned char)Level_getTile(level, x, y, z);
+    return n;
+}
+
 void Server_onBlockChanged(void* ctx, int x, int y, int z) {
     MinecraftServer* srv = (MinecraftServer*)ctx;
-    int type = Level_getTile(&srv->level, x, y, z);
-    unsigned char pkt[8] = {
-        (unsigned char)PACKET_SET_BLOCK_SC,
-        (unsigned char)(x >> 8), (unsigned char)x,
-        (unsigned char)(y >> 8), (unsigned char)y,
-        (unsigned char)(z >> 8), (unsigned char)z,
-        (unsigned char)type
-    };
-    Server_broadcastAll(srv, pkt, 8);
+    BlockChangeBatch* b = &srv->blockChanges;
+    const Level* level = &srv->level;
+
+    int cellCount = level->width * level->height * level->depth;
+    if (b->markedCells != cellCount) {
+        // first change, or the level was resized: nothing recorded so far
+        // can still be addressed, so start over at the new size
+        free(b->marks);
+        b->marks = (unsigned char*)calloc((size_t)(cellCount + 7) / 8, 1);
+        b->markedCells = b->marks ? cellCount : 0;
+        b->count = 0;
+    }
+
+    int i = (y * level->height + z) * level->width + x;
+    if (b->marks && (b->marks[i >> 3] & (1 << (i & 7)))) return; // already pending this tick
+
+    if (b->marks && b->count == b->capacity) {
+        int newCapacity = b->capacity ? b->capacity * 2 : 256;
+        int* grown = (int*)realloc(b->cells, (size_t)newCapacity * sizeof *grown);
+        if (grown) {
+            b->cells = grown;
+            b->capacity = newCapacity;
+        }
+    }
+    if (!b->marks || b->count == b->capacity) {
+        // out of memory: can't be batched, so send it now, unbatched
+        unsigned char pkt[8];
+        Server_broadcastAll(srv, pkt, encodeSetBlock(pkt, level, x, y, z));
+        return;
+    }
+    b->marks[i >> 3] |= (unsigned char)(1 << (i & 7));
+    b->cells[b->count++] = i;
+}
+
+void Server_flushBlockChanges(MinecraftServer* srv) {
+    BlockChangeBatch* b = &srv->blockChanges;
+    const Level* level = &srv->level;
+    // encoded into the batch's own buffer, each full buffer broadcast as
+    // one shared packet rather than one 8 byte packet per cell per player.
+    // Bounded, so a flood goes out as several packets that each fit a
+    // connection's send limit, instead of one too big for any of them
+    int n = 0;
+    for (int k = 0; k < b->count; k++) {
+        int i = b->cells[k];
+        b->marks[i >> 3] &= (unsigned char)~(1 << (i & 7));
+        if (n + 8 > BLOCK_BATCH_PACKET_BYTES) {
+            Server_broadcastAll(srv, b->packet, n);
+            n = 0;
+        }
+        int x = i % level->width;
+        int z = (i / level->width) % level->height;
+        int y = i / (level->width * level->height);
+        n += encodeSetBlock(b->packet + n, level, x, y, z);
+    }
+    b->count = 0;
+
+    if (n > 0) Server_broadcastAll(srv, b->packet, n);
+}
+
+// records the time since start against phase, returning now so the next
+// phase can start from there
+static long long recordPhase(MinecraftServer* srv, PerfPhase phase, long long start) {
+    long long now = nowNanos();
+    TickProfiler_record(&srv->profiler, phase, now - start);
+    return now;
 }
 
 void Server_run(MinecraftServer* srv) {
     // matches run(): network I/O every outer iteration, a fixed ~20Hz world
     // tick, a slower ~0.5s ping broadcast, autosave every ~60s. Heartbeat to
-    // the long dead minecraft.net master list is deliberately not ported
+    // the long dead minecraft.net master list is deliberately not ported.
+    // Unlike the real source's fixed sleep between iterations, each
+    // iteration blocks on the poller until a socket is ready or the next
+    // tick/ping is due, so packets are handled the moment they arrive and
+    // an idle server doesn't spin
     const long long tickNanos = 50000000LL;  // 50ms = 20Hz
     const long long pingNanos = 500000000LL; // 0.5s
+    // the old fixed sleep, still used as the wake cadence while any
+    // connection has work no readiness event will announce (see
+    // Connection_needsService), e.g. waiting on its background level gzip
+    const int serviceMs = 5;
 
     long long lastTick = nowNanos();
     long long tickAccum = 0;
     long long pingAccum = 0;
 
-    // static, not stack local: each Connection carries 3 x 256KB buffers,
-    // so the full array is tens of megabytes, comfortably past a typical
-    // thread's default stack size
-    static Connection connections[SERVER_MAX_PLAYERS];
-    static bool connectionUsed[SERVER_MAX_PLAYERS];
+    // one Connection per player slot, at the same index, sized once from
+    // max-players for the life of the process. Each Connection's buffers
+    // are allocated separately and only grow while in use (see
+    // buffer_pool.h)
+    const int maxConns = srv->maxPlayers;
+    Connection* connections = (Connection*)calloc((size_t)maxConns, sizeof *connections);
+    bool* connectionUsed = (bool*)calloc((size_t)maxConns, sizeof *connectionUsed);
+    NetPollEvent* events = (NetPollEvent*)malloc((size_t)(maxConns + 1) * sizeof *events);
+    if (!connections || !connectionUsed || !events) {
+        Log_severe("Out of memory allocating %d connections", maxConns);
+        return;
+    }
 
     for (;;) {
         // server1.6: drains queued stdin admin command lines, once per
         // outer loop iteration, matching MinecraftServer.c()
         StdinReader_poll(srv);
 
+        bool anyNeedsService = false;
+        for (int i = 0; i < maxConns; i++) {
+            if (connectionUsed[i] && Connection_needsService(&connections[i])) { anyNeedsService = true; break; }
+        }
+
+        // sleep until whichever comes first: the next game tick, the next
+        // ping, or socket readiness. Rounded up so a wake never lands just
+        // short of the deadline and has to immediately go back to sleep
+        long long sinceLast = nowNanos() - lastTick;
+        if (sinceLast < 0) sinceLast = 0;
+        long long untilDue = MIN(tickNanos - tickAccum, pingNanos - pingAccum) - sinceLast;
+        int timeoutMs = untilDue > 0 ? (int)((untilDue + 999999LL) / 1000000LL) : 0;
+        if (anyNeedsService && timeoutMs > serviceMs) timeoutMs = serviceMs;
+
+        int eventCount = NetPoller_wait(&srv->poller, events, maxConns + 1, timeoutMs);
+        long long phaseStart = nowNanos(); // the wait itself isn't counted anywhere
+        bool listenReady = false;
+        for (int e = 0; e < eventCount; e++) {
+            if (events[e].userData == &srv->listenSock) listenReady = true;
+            else if (Metrics_handleEvent(srv, events[e].userData, events[e].readable, events[e].writable, phaseStart)) continue;
+            else ((Connection*)events[e].userData)->ioReady = true;
+        }
+        Metrics_tick(srv, phaseStart);
+
         // accept new connections
         sock_t clientSock;
-        while (NetSocket_accept(srv->listenSock, &clientSock)) {
+        while (listenReady && NetSocket_accept(srv->listenSock, &clientSock)) {
             char addr[64];
             NetSocket_getRemoteAddress(clientSock, addr, sizeof addr);
 
@@ -336,7 +760,7 @@ void Server_run(MinecraftServer* srv) {
             // reads at first glance). server1.6: the cap (previously always
             // 3) is now the real server.properties max-connections value
             int sameAddrCount = 0;
-            for (int i = 0; i < SERVER_MAX_PLAYERS; i++) {
+            for (int i = 0; i < maxConns; i++) {
                 if (connectionUsed[i] && strcmp(connections[i].remoteAddress, addr) == 0) sameAddrCount++;
             }
             if (sameAddrCount >= srv->maxConnections) {
@@ -345,34 +769,38 @@ void Server_run(MinecraftServer* srv) {
                 continue;
             }
 
-            int slot = Server_findFreeSlot(srv);
-            int freeConnIdx = -1;
-            for (int i = 0; i < SERVER_MAX_PLAYERS; i++) if (!connectionUsed[i]) { freeConnIdx = i; break; }
-
-            if (slot < 0 || freeConnIdx < 0) {
+            int slot = Server_takeFreeSlot(srv);
+            if (slot < 0) {
                 NetSocket_configure(clientSock);
                 NetSocket_close(clientSock);
                 continue;
             }
 
-            Connection* c = &connections[freeConnIdx];
-            connectionUsed[freeConnIdx] = true;
+            Connection* c = &connections[slot];
+            connectionUsed[slot] = true;
             Connection_init(c, srv, clientSock);
             c->playerId = slot;
+            c->ioReady = true; // a fast client's Login may already be waiting
             srv->playerSlots[slot] = c;
         }
 
-        // network I/O for every connection
-        for (int i = 0; i < SERVER_MAX_PLAYERS; i++) {
+        // network I/O, only for connections that are actually ready (or
+        // have queued writes/pending work the poller won't report on its own)
+        for (int i = 0; i < maxConns; i++) {
             if (!connectionUsed[i]) continue;
-            Connection_tick(&connections[i]);
-            if (!connections[i].open) {
-                Server_removeConnection(srv, &connections[i]);
+            Connection* c = &connections[i];
+            if (c->ioReady || Connection_needsService(c)) {
+                c->ioReady = false;
+                Connection_tick(c);
+            }
+            if (!c->open) {
+                Server_removeConnection(srv, c);
                 connectionUsed[i] = false;
             }
         }
 
         long long now = nowNanos();
+        TickProfiler_record(&srv->profiler, PERF_NETWORK, now - phaseStart);
         long long elapsed = now - lastTick;
         lastTick = now;
         if (elapsed < 0) elapsed = 0;
@@ -387,17 +815,48 @@ void Server_run(MinecraftServer* srv) {
             // Click/chat throttle decay and the SetBlock/Move queue
             // drain, all fixed-rate, distinct from the fast network I/O
             // poll in Connection_tick above
-            for (int i = 0; i < SERVER_MAX_PLAYERS; i++) {
+            long long tickStart = nowNanos();
+            phaseStart = tickStart;
+            for (int i = 0; i < maxConns; i++) {
                 if (connectionUsed[i]) Connection_onGameTick(&connections[i]);
             }
+            phaseStart = recordPhase(srv, PERF_CONNECTIONS, phaseStart);
+
+            // Level_onTick, in its two halves so each gets timed
+            Level_runTickList(&srv->level);
+            phaseStart = recordPhase(srv, PERF_TICK_LIST, phaseStart);
+            Level_runRandomTicks(&srv->level);
+            phaseStart = recordPhase(srv, PERF_RANDOM_TICKS, phaseStart);
+            Server_flushBlockChanges(srv);
+            phaseStart = recordPhase(srv, PERF_BLOCK_FLUSH, phaseStart);
+
+            if (srv->viewDistance > 0 && srv->tickCount % VIEW_RECHECK_TICKS == 0) {
+                for (int i = 0; i < maxConns; i++) {
+                    if (connectionUsed[i] && connections[i].spawned) Server_updateVisibility(srv, &connections[i]);
+                }
+                phaseStart = recordPhase(srv, PERF_VISIBILITY, phaseStart);
+            }
 
-            Level_onTick(&srv->level);
+            if (srv->level.journal && srv->tickCount % srv->journalSyncTicks == 0) {
+                BlockJournal_sync(srv->level.journal);
+                phaseStart = recordPhase(srv, PERF_JOURNAL, phaseStart);
+            }
 
-            if (srv->tickCount - srv->lastSaveTick >= 1200) {
+            // a journal that's grown past JOURNAL_COMPACT_RECORDS gets folded
+            // into a full save early, so replay on the next start stays quick
+            bool journalFull = srv->level.journal && srv->level.journal->recordsSinceRotate >= JOURNAL_COMPACT_RECORDS;
+            if (srv->tickCount - srv->lastSaveTick >= srv->autosaveTicks || journalFull) {
                 srv->lastSaveTick = srv->tickCount;
                 Log_info("Saving level");
-                Level_save(&srv->level);
+                int finished = Level_savesFinished();
+                if (!Level_saveAsync(&srv->level)) Log_warn("Previous save still running, skipping this one");
+                else if (!srv->stats.saveStart) {
+                    srv->stats.saveStart = nowNanos();
+                    srv->savesFinished = finished;
+                }
+                phaseStart = recordPhase(srv, PERF_AUTOSAVE, phaseStart);
             }
+            TickProfiler_record(&srv->profiler, PERF_TICK, phaseStart - tickStart);
         }
 
         pingAccum += elapsed;
@@ -407,6 +866,27 @@ void Server_run(MinecraftServer* srv) {
             Server_broadcastAll(srv, pingPkt, 1);
         }
 
-        sleepMs(5);
+        // anything changed outside a tick (e.g. by an admin command) still
+        // goes out this iteration. Whatever the ticks/ping above just queued
+        // gets flushed as soon as the socket can take it, rather than on the
+        // next unrelated wake
+        Server_flushBlockChanges(srv);
+        for (int i = 0; i < maxConns; i++) {
+            if (connectionUsed[i]) Connection_syncPollInterest(&connections[i]);
+        }
+
+        // the background save's duration, to within one loop iteration. One
+        // that finished without a save finishing had nothing to write
+        if (srv->stats.saveStart && !Level_isSaving()) {
+            if (Level_savesFinished() != srv->savesFinished) {
+                long long took = nowNanos() - srv->stats.saveStart;
+                srv->stats.saves++;
+                srv->stats.lastSaveNanos = took;
+                srv->stats.saveTotalNanos += took;
+            }
+            srv->stats.saveStart = 0;
+        }
+
+        TickProfiler_maybeReport(&srv->profiler, nowNanos());
     }
 }
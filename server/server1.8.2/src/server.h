@@ -4,7 +4,11 @@
 #define SERVER_H
 
 #include "level/level.h"
+#include "level/block_journal.h"
 #include "player_list.h"
+#include "view_grid.h"
+#include "tick_profiler.h"
+#include "metrics.h"
 #include "net/net_socket.h"
 #include <stdbool.h>
 
@@ -13,16 +17,40 @@
 // MinecraftServer* backref)
 struct Connection;
 
-#define SERVER_MAX_PLAYERS 32
+// upper bound on max-players. The real source's slot index doubles as the
+// wire player id, capping it at 128; here each viewer gets its own id
+// mapping instead (see Server_showPlayer), so the table can go past that
+#define SERVER_MAX_PLAYERS 1024
+
+// not in the real source, which broadcasts a SetBlock the instant any cell
+// changes. Changed cells are collected here instead, each at most once no
+// matter how often it changes, and sent as one run of SetBlock packets per
+// connection at the end of the tick (see Server_flushBlockChanges). A
+// change that can't be recorded for lack of memory is broadcast on its
+// own right away instead, as the real source does for all of them
+#define BLOCK_BATCH_PACKET_BYTES 4096 // most SetBlocks per broadcast, 8 bytes each
+typedef struct BlockChangeBatch {
+    int* cells; // block array indices, in first-changed order
+    int count, capacity;
+    unsigned char* marks; // one bit per cell, set while it's in cells
+    int markedCells; // level size marks was allocated for
+    unsigned char packet[BLOCK_BATCH_PACKET_BYTES]; // the next broadcast, being encoded
+} BlockChangeBatch;
 
 typedef struct MinecraftServer {
     sock_t listenSock;
+    // every open socket (listen + all connections), see Server_run
+    NetPoller poller;
     Level level;
 
-    // fixed slot array, index doubles as the wire protocol's player id.
-    // NULL = free slot, matches PlayerConnection[] playerSlots
-    struct Connection* playerSlots[SERVER_MAX_PLAYERS];
+    // maxPlayers entries, NULL = free slot, matches PlayerConnection[]
+    // playerSlots. The index is the wire player id whenever it fits (see
+    // Server_showPlayer). Free slots are kept on a stack, lowest on top to
+    // start with, so taking one doesn't scan the table
+    struct Connection** playerSlots;
     int maxPlayers;
+    int* freeSlots;
+    int freeSlotCount;
 
     char serverName[65];
     char motd[65];
@@ -31,6 +59,72 @@ typedef struct MinecraftServer {
     // server1.6: real config value (default 3), replacing the previously
     // hardcoded same-IP simultaneous connection cap
     int maxConnections;
+    // not in the real source: how many background threads gzip the level
+    // for joining players (level-send-workers, default 2). Joins beyond
+    // that just wait their turn instead of each getting a thread
+    int levelSendWorkers;
+    // not in the real source: the level transfer's gzip level (0..9,
+    // level-send-compression, default -1 = zlib's default) and deflate
+    // strategy (level-send-strategy: default, filtered, rle or huffman)
+    int levelSendCompression;
+    int levelSendStrategy;
+    // not in the real source: what server_level.dat saves are compressed
+    // with (save-codec: gzip, or zstd/lz4 if built in) and at what level
+    // (save-compression, -1 = the codec's default), see level/level_codec.h
+    int saveCodec;
+    int saveCompression;
+    // not in the real source: how many threads help run random tile ticks
+    // region by region (tile-tick-workers, default 0 = off, ticking on the
+    // main thread alone as in the real source), see level/region_ticks.h
+    int tileTickWorkers;
+    // not in the real source: keep the blocks in 16x16x16 sections, with
+    // one tile sections (sky, solid rock) holding no array (level-storage,
+    // "flat" by default as in the real source, or "sections"), see
+    // level/level_sections.h
+    bool sectionStorage;
+    // not in the real source: save to the native, uncompressed and mappable
+    // server_level.map instead of server_level.dat (level-format, "java"
+    // by default or "native"), see level/level_native.h
+    bool nativeFormat;
+    // not in the real source: block change journaling (level-journal,
+    // default true), flushed to disk every journalSyncTicks (default 20,
+    // i.e. at most a second of edits lost on a crash), with full saves
+    // every autosaveTicks (default 1200, the real source's fixed ~60s)
+    bool journalEnabled;
+    int journalSyncTicks;
+    int autosaveTicks;
+    BlockJournal journal;
+
+    BlockChangeBatch blockChanges;
+
+    // not in the real source: how far away (in blocks, horizontally) other
+    // players are spawned for a client (view-distance, default 0 =
+    // unlimited, every player sees every other one as in the real source).
+    // When set, in-game players are bucketed in viewGrid so movement only
+    // fans out to those nearby
+    int viewDistance;
+    ViewGrid viewGrid;
+
+    // not in the real source: per phase timings of the main loop, see
+    // tick_profiler.h. Summarized into server.log every perfLogSeconds
+    // (perf-log-seconds, default 300, 0 = never) and, if perfDumpFile
+    // (perf-dump-file) is set, written there as JSON too
+    TickProfiler profiler;
+    int perfLogSeconds;
+    char perfDumpFile[128];
+
+    // not in the real source: traffic, kick and save counters, served over
+    // HTTP on metricsPort (metrics-port, default 0 = off), see metrics.h
+    ServerStats stats;
+    MetricsServer metrics;
+    int metricsPort;
+    int savesFinished; // Level_savesFinished() when stats.saveStart was set
+
+    // not in the real source: server.log is rotated once it would pass
+    // logMaxKb (log-max-kb, default 8192, 0 = never), keeping logFiles
+    // (log-files, default 5) old ones, see Log_start
+    int logMaxKb;
+    int logFiles;
 
     PlayerList admins;
     PlayerList bannedNames;
@@ -46,17 +140,46 @@ typedef struct MinecraftServer {
 
 bool Server_init(MinecraftServer* srv);
 void Server_run(MinecraftServer* srv); // never returns, matches MinecraftServer.run()
+// the monotonic clock the main loop runs on, in nanoseconds
+long long Server_nowNanos(void);
 
-// -1 if full, matching findFreeSlot()
-int Server_findFreeSlot(const MinecraftServer* srv);
+// claims a free slot, -1 if full, matching findFreeSlot()
+int Server_takeFreeSlot(MinecraftServer* srv);
 
 void Server_broadcastAll(MinecraftServer* srv, const unsigned char* packetBytes, int len);
 void Server_broadcastExcept(MinecraftServer* srv, struct Connection* exclude, const unsigned char* packetBytes, int len);
 
-// removes a connection from its slot and broadcasts DespawnPlayer, matching
-// MinecraftServer.removeConnection(). No-op if it's already been removed
+// removes a connection from its slot and despawns it for everyone who
+// could see it, matching MinecraftServer.removeConnection(). No-op if it's
+// already been removed
 void Server_removeConnection(MinecraftServer* srv, struct Connection* conn);
 
+// not in the real source, which spawns every player for every other one
+// under its slot index. Each viewer instead gives the other players it
+// has spawned its own wire ids, the slot index when that's free and fits
+// in the protocol's signed byte, any free id otherwise. With more than
+// PROTOCOL_MAX_PLAYER_IDS others online, the ones a viewer has no id for
+// just aren't spawned for it, until an id frees up.
+//
+// Server_showPlayer returns false if viewer has no free id, or already
+// shows subject. Server_hidePlayer is a no-op if it doesn't
+bool Server_showPlayer(MinecraftServer* srv, struct Connection* viewer, struct Connection* subject);
+void Server_hidePlayer(MinecraftServer* srv, struct Connection* viewer, struct Connection* subject);
+// called once conn's own join completes: spawns it for everyone already
+// in game, and everyone already in game for it
+void Server_spawnPlayer(MinecraftServer* srv, struct Connection* conn);
+// re-decides who conn sees and who sees it when view-distance is set:
+// spawns players that came within range, despawns ones that went more than
+// a few blocks past it. No-op with unlimited view distance
+void Server_updateVisibility(MinecraftServer* srv, struct Connection* conn);
+// call after conn's lastX/lastZ change. Moves it between grid cells, and
+// re-runs Server_updateVisibility right away when it crosses into another
+void Server_onPlayerMoved(MinecraftServer* srv, struct Connection* conn);
+// sends a packet about subject (byte 1, the player id, is overwritten with
+// each viewer's own id for it) to every other viewer that has subject
+// spawned. Encoded once per distinct id, not once per viewer
+void Server_broadcastPlayerPacket(MinecraftServer* srv, struct Connection* subject, unsigned char* packetBytes, int len);
+
 // matches kickByName/banByName/opByName/deopByName/unbanByName/banIpByName:
 // act on the persisted list regardless of online status, and additionally
 // kick/notify the matching online connection if there is one
@@ -77,8 +200,13 @@ void Server_banIpByName(MinecraftServer* srv, const char* name);
 // next Move packet
 void Server_teleportToPlayer(MinecraftServer* srv, struct Connection* issuer, const char* targetName);
 
-// matches MinecraftServer.a(x,y,z): the Level block change listener callback,
-// reads the current tile back and broadcasts SetBlock server->client to everyone
+// matches MinecraftServer.a(x,y,z): the Level block change listener
+// callback. Only records the cell; the SetBlock broadcast itself is
+// deferred to Server_flushBlockChanges
 void Server_onBlockChanged(void* ctx, int x, int y, int z);
+// reads every cell recorded since the last flush back from the level and
+// sends all of them to every connection in one append each. Called at the
+// end of every tick and every loop iteration
+void Server_flushBlockChanges(MinecraftServer* srv);
 
 #endif
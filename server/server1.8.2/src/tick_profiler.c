@@ -0,0 +1,136 @@
+// tick_profiler.c
+
+#include "tick_profiler.h"
+#include "log.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TICK_BUDGET_NANOS 50000000LL
+
+static const char* const PHASE_NAMES[PERF_PHASE_COUNT] = {
+    "network", "connections", "tick-list", "random-ticks", "block-flush",
+    "visibility", "journal", "autosave", "tick"
+};
+
+const char* TickProfiler_phaseName(PerfPhase phase) {
+    return PHASE_NAMES[phase];
+}
+
+void TickProfiler_init(TickProfiler* p, int logSeconds, const char* dumpPath, long long now) {
+    memset(p, 0, sizeof *p);
+    p->logSeconds = logSeconds;
+    snprintf(p->dumpPath, sizeof p->dumpPath, "%s", dumpPath);
+    p->windowStart = now;
+}
+
+static int bucketOf(long long micros) {
+    if (micros < 8) return micros < 0 ? 0 : (int)micros;
+    int log2 = 3;
+    while (log2 < 62 && (micros >> (log2 + 1)) != 0) log2++;
+    int sub = (int)(micros >> (log2 - 3)) & 7;
+    int i = 8 + (log2 - 3) * 8 + sub;
+    return i < PERF_BUCKETS ? i : PERF_BUCKETS - 1;
+}
+
+long long TickProfiler_bucketMicros(int i) {
+    if (i < 8) return i;
+    int log2 = (i - 8) / 8 + 3;
+    return (long long)(8 + (i - 8) % 8) << (log2 - 3);
+}
+
+static void add(PerfHistogram* h, long long nanos) {
+    h->count++;
+    h->totalNanos += nanos;
+    if (nanos > h->maxNanos) h->maxNanos = nanos;
+    h->buckets[bucketOf(nanos / 1000)]++;
+}
+
+void TickProfiler_record(TickProfiler* p, PerfPhase phase, long long nanos) {
+    add(&p->total[phase], nanos);
+    add(&p->window[phase], nanos);
+    if (phase == PERF_TICK && nanos > TICK_BUDGET_NANOS) {
+        p->overruns++;
+        p->windowOverruns++;
+    }
+}
+
+// the upper edge of the bucket the given fraction of samples falls in,
+// never past the largest sample actually seen
+static double percentileMs(const PerfHistogram* h, double fraction) {
+    long long rank = (long long)(h->count * fraction);
+    if (rank >= h->count) rank = h->count - 1;
+    long long seen = 0;
+    for (int i = 0; i < PERF_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            double ms = (double)TickProfiler_bucketMicros(i + 1) / 1000.0;
+            double maxMs = (double)h->maxNanos / 1e6;
+            return ms < maxMs ? ms : maxMs;
+        }
+    }
+    return (double)h->maxNanos / 1e6;
+}
+
+void TickProfiler_summarize(const PerfHistogram* h, PerfSummary* out) {
+    memset(out, 0, sizeof *out);
+    out->count = h->count;
+    if (h->count == 0) return;
+    out->meanMs = (double)h->totalNanos / (double)h->count / 1e6;
+    out->p50Ms = percentileMs(h, 0.5);
+    out->p99Ms = percentileMs(h, 0.99);
+    out->maxMs = (double)h->maxNanos / 1e6;
+}
+
+void TickProfiler_describe(const TickProfiler* p, PerfPhase phase, char* out, int outSize) {
+    PerfSummary s;
+    TickProfiler_summarize(&p->window[phase], &s);
+    snprintf(out, (size_t)outSize, "%-12s p50 %.2f p99 %.2f max %.2f ms", PHASE_NAMES[phase], s.p50Ms, s.p99Ms, s.maxMs);
+}
+
+// written to a temporary name and renamed over the old dump, so whatever
+// reads it never sees half a file
+static void writeDump(const TickProfiler* p, double windowSeconds) {
+    char temp[160];
+    snprintf(temp, sizeof temp, "%s.tmp", p->dumpPath);
+    FILE* f = fopen(temp, "w");
+    if (!f) {
+        Log_warn("Failed to write %s", temp);
+        return;
+    }
+    fprintf(f, "{\n  \"window_seconds\": %.1f,\n  \"overruns\": %lld,\n  \"phases\": {\n", windowSeconds, p->windowOverruns);
+    for (int i = 0; i < PERF_PHASE_COUNT; i++) {
+        PerfSummary s;
+        TickProfiler_summarize(&p->window[i], &s);
+        fprintf(f, "    \"%s\": {\"count\": %lld, \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+                PHASE_NAMES[i], s.count, s.meanMs, s.p50Ms, s.p99Ms, s.maxMs, i + 1 < PERF_PHASE_COUNT ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+    bool ok = fclose(f) == 0;
+#if defined(_WIN32)
+    remove(p->dumpPath); // rename won't replace an existing file here
+#endif
+    if (!ok || rename(temp, p->dumpPath) != 0) Log_warn("Failed to write %s", p->dumpPath);
+}
+
+void TickProfiler_maybeReport(TickProfiler* p, long long now) {
+    if (p->logSeconds <= 0 || now - p->windowStart < (long long)p->logSeconds * 1000000000LL) return;
+    double seconds = (double)(now - p->windowStart) / 1e9;
+
+    PerfSummary tick;
+    TickProfiler_summarize(&p->window[PERF_TICK], &tick);
+    char line[400];
+    int n = snprintf(line, sizeof line, "Ticks p50/p99/max %.2f/%.2f/%.2f ms, %lld over budget; p99",
+                     tick.p50Ms, tick.p99Ms, tick.maxMs, p->windowOverruns);
+    for (int i = 0; i < PERF_TICK && n > 0 && n < (int)sizeof line; i++) {
+        PerfSummary s;
+        TickProfiler_summarize(&p->window[i], &s);
+        n += snprintf(line + n, sizeof line - (size_t)n, " %s %.2f", PHASE_NAMES[i], s.p99Ms);
+    }
+    Log_info("%s", line);
+
+    if (p->dumpPath[0]) writeDump(p, seconds);
+
+    memset(p->window, 0, sizeof p->window);
+    p->windowOverruns = 0;
+    p->windowStart = now;
+}
@@ -0,0 +1,72 @@
+// tick_profiler.h: where the main loop's time goes. Not in the real
+// source, which has no instrumentation at all. Server_run times each phase
+// of every loop iteration and tick with the monotonic clock and records it
+// here, in log scale histograms (1/8 of a power of two wide, so any
+// percentile read back is within about 12% of the real value)
+//
+// Two sets are kept: one since startup, and a window that's summarized
+// into server.log (and optionally perf-dump-file) every perf-log-seconds,
+// then cleared. /perf shows the current window
+
+#ifndef TICK_PROFILER_H
+#define TICK_PROFILER_H
+
+#include <stdbool.h>
+
+typedef enum {
+    PERF_NETWORK,      // accepts plus socket reads/writes, once per loop iteration
+    PERF_CONNECTIONS,  // Connection_onGameTick for everyone: throttles, action queue drains
+    PERF_TICK_LIST,    // scheduled tile ticks (Level_runTickList)
+    PERF_RANDOM_TICKS, // random tile ticks (Level_runRandomTicks)
+    PERF_BLOCK_FLUSH,  // broadcasting the tick's block changes
+    PERF_VISIBILITY,   // view-distance rechecks
+    PERF_JOURNAL,      // journal syncs
+    PERF_AUTOSAVE,     // starting an autosave, the snapshot copy is the synchronous part
+    PERF_TICK,         // a whole tick, everything above but network
+    PERF_PHASE_COUNT
+} PerfPhase;
+
+// 8 single microsecond buckets, then 8 per power of two up to ~2^27 us
+#define PERF_BUCKETS 208
+
+typedef struct {
+    long long count;
+    long long totalNanos;
+    long long maxNanos;
+    unsigned int buckets[PERF_BUCKETS];
+} PerfHistogram;
+
+typedef struct {
+    long long count;
+    double meanMs, p50Ms, p99Ms, maxMs;
+} PerfSummary;
+
+typedef struct TickProfiler {
+    PerfHistogram total[PERF_PHASE_COUNT];
+    PerfHistogram window[PERF_PHASE_COUNT];
+    long long windowStart; // nowNanos() the window was last cleared at
+    long long overruns, windowOverruns; // ticks over their 50ms budget
+
+    int logSeconds;        // perf-log-seconds, 0 = no periodic line
+    char dumpPath[128];    // perf-dump-file, "" = no dump
+} TickProfiler;
+
+// "network", "connections", ..., for logs, /perf and the dump
+const char* TickProfiler_phaseName(PerfPhase phase);
+
+void TickProfiler_init(TickProfiler* p, int logSeconds, const char* dumpPath, long long now);
+void TickProfiler_record(TickProfiler* p, PerfPhase phase, long long nanos);
+
+void TickProfiler_summarize(const PerfHistogram* h, PerfSummary* out);
+// the lower edge of bucket i, in microseconds (bucket i+1's is its upper)
+long long TickProfiler_bucketMicros(int i);
+
+// one line for phase's current window, short enough for a chat message
+void TickProfiler_describe(const TickProfiler* p, PerfPhase phase, char* out, int outSize);
+
+// once perf-log-seconds have passed since the window started: logs a
+// summary line, writes the dump file if there is one, and starts a new
+// window. Call once per loop iteration
+void TickProfiler_maybeReport(TickProfiler* p, long long now);
+
+#endif
@@ -0,0 +1,190 @@
+// tools/liquidcheck.c: deterministic liquid simulation check, built and run
+// with `make liquidcheck`. Not part of the real source, nor of the server
+// binary. Generates a map from a fixed seed, pours water and lava onto it,
+// dries some of it up with sponges, then takes the sponges away and
+// breaches lakes partway through, ticking the level exactly as the server
+// does. At every checkpoint it prints a hash of the block array and of the
+// light depths
+//
+// make liquidcheck builds this twice: against this tree's level code, and
+// against tools/liquidref, a verbatim copy of level.c, tile.c and the
+// generator as they were before the tick queue, sponge and light work
+// (plain FIFO tick list, 125 cell sponge scans, whole column light
+// recalcs). It fails unless both print exactly the same lines, so any
+// change to what liquids, sponges, falling tiles or light end up doing
+// shows up here. Only the API both share is used. Timings go to stderr
+//
+// usage: minecraft-liquidcheck [-s seed] [-n ticks] [-c every] [-w size]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "level/level.h"
+#include "level/tile/tile.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SITES 32
+
+/* the level code's logging, to stderr only: no server.log from a check */
+
+static void logLine(const char* severity, const char* fmt, va_list args) {
+    fprintf(stderr, "%s  ", severity);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+}
+
+void Log_info(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    logLine("   ", fmt, args);
+    va_end(args);
+}
+
+void Log_warn(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    logLine("  !", fmt, args);
+    va_end(args);
+}
+
+void Log_severe(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    logLine("***", fmt, args);
+    va_end(args);
+}
+
+void Server_beginLevelLoading(const char* title) { (void)title; }
+void Server_levelLoadUpdate(const char* status) { (void)status; }
+void Server_levelLoadProgress(int percent) { (void)percent; }
+
+/* scenario */
+
+// its own generator, so where things go doesn't depend on how much of
+// rand() generation and random ticks used up
+static unsigned int sPick;
+
+static int pick(int bound) {
+    sPick = sPick * 1103515245u + 12345u;
+    return (int)((sPick >> 8) % (unsigned int)bound);
+}
+
+// the highest non-air y in column (x, z), -1 if there is none
+static int surfaceAt(const Level* level, int x, int z) {
+    for (int y = level->depth - 1; y >= 0; y--) {
+        if (Level_getTile(level, x, y, z) != 0) return y;
+    }
+    return -1;
+}
+
+typedef struct { int x, y, z; } Cell;
+
+static unsigned long long fnv1a(const void* data, size_t len, unsigned long long h) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) h = (h ^ p[i]) * 1099511628211ULL;
+    return h;
+}
+
+static void checkpoint(const Level* level) {
+    const unsigned long long basis = 14695981039346656037ULL;
+    size_t cells = (size_t)level->width * level->height * level->depth;
+    size_t columns = (size_t)level->width * level->height;
+    unsigned long long blocks = basis;
+    for (int y = 0; y < level->depth; y++)
+        for (int z = 0; z < level->height; z++)
+            for (int x = 0; x < level->width; x++) {
+                unsigned char id = (unsigned char)Level_getTile(level, x, y, z);
+                blocks = fnv1a(&id, 1, blocks);
+            }
+    unsigned long long light = fnv1a(level->lightDepths, columns * sizeof(int), basis);
+    printf("tick %6d  blocks %016llx  light %016llx  (%zu cells)\n", level->tickCount, blocks, light, cells);
+    fflush(stdout);
+}
+
+// sources on the surface, alternating water and lava, and sponges with
+// water poured right next to them (inside their dry zone) or sat on a lake
+static int placeSites(Level* level, Cell* sponges) {
+    int spongeCount = 0;
+    for (int i = 0; i < SITES; i++) {
+        int x = 4 + pick(level->width - 8), z = 4 + pick(level->height - 8);
+        int y = surfaceAt(level, x, z);
+        if (y < 0 || y + 2 >= level->depth) continue;
+        switch (i % 4) {
+            case 0: level_setTile(level, x, y + 1, z, TILE_WATER.id); break;
+            case 1: level_setTile(level, x, y + 1, z, TILE_LAVA.id); break;
+            case 2:
+                level_setTile(level, x, y + 1, z, TILE_SPONGE.id);
+                sponges[spongeCount++] = (Cell){ x, y + 1, z };
+                level_setTile(level, x + 2, surfaceAt(level, x + 2, z) + 1, z, TILE_WATER.id);
+                break;
+            default:
+                level_setTile(level, x, y, z, TILE_SPONGE.id);
+                sponges[spongeCount++] = (Cell){ x, y, z };
+                break;
+        }
+    }
+    return spongeCount;
+}
+
+// digs a trench from a lake's edge out into the land beside it, so the
+// lake drains into it
+static void breachLakes(Level* level, int count) {
+    for (int tries = 0; tries < count * 200 && count > 0; tries++) {
+        int x = 8 + pick(level->width - 16), z = 8 + pick(level->height - 16);
+        int y = surfaceAt(level, x, z);
+        int id = y >= 0 ? Level_getTile(level, x, y, z) : 0;
+        if (id != TILE_CALM_WATER.id && id != TILE_WATER.id) continue;
+        int dx = pick(2) ? 1 : -1;
+        for (int step = 1; step <= 6; step++)
+            for (int dy = 0; dy < 3; dy++) level_setTile(level, x + dx * step, y - dy, z, 0);
+        count--;
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: minecraft-liquidcheck [-s seed] [-n ticks] [-c checkpoint every] [-w map size]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    unsigned int seed = 1;
+    int ticks = 3000, every = 250, size = 256;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) usage();
+        int value = atoi(argv[++i]);
+        switch (argv[i - 1][1]) {
+            case 's': seed = (unsigned int)value; break;
+            case 'n': ticks = value; break;
+            case 'c': every = value; break;
+            case 'w': size = value; break;
+            default: usage();
+        }
+    }
+    if (ticks < 1 || every < 1 || size < 32 || (size & (size - 1)) != 0) usage();
+
+    srand(seed);
+    sPick = seed;
+    Tile_registerAll();
+    Level level;
+    memset(&level, 0, sizeof level);
+    Level_init(&level, size, size, 64);
+
+    Cell sponges[SITES];
+    int spongeCount = placeSites(&level, sponges);
+    checkpoint(&level);
+
+    clock_t start = clock();
+    for (int t = 1; t <= ticks; t++) {
+        if (t == ticks / 3) {
+            for (int i = 0; i < spongeCount; i++) level_setTile(&level, sponges[i].x, sponges[i].y, sponges[i].z, 0);
+        }
+        if (t == ticks / 2) breachLakes(&level, 4);
+        Level_onTick(&level);
+        if (t % every == 0 || t == ticks) checkpoint(&level);
+    }
+    fprintf(stderr, "%d ticks in %.2fs\n", ticks, (double)(clock() - start) / CLOCKS_PER_SEC);
+    return 0;
+}
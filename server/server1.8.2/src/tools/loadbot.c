@@ -0,0 +1,654 @@
+// tools/loadbot.c: headless load test client, built with `make loadbot`.
+// Not part of the real source, nor of the server binary. Opens a number of
+// simulated players against a running server, takes each through the
+// login and level download, then has them walk, chat and place/break
+// blocks at fixed rates, and reports what that cost the server as seen
+// from the client side:
+//
+//   join      connect to self spawn (login + whole level transfer)
+//   setblock  SetBlock sent to its SetBlock echo, which the server only
+//             broadcasts at the end of the tick that applied it, so this
+//             tracks tick latency
+//   chat      Message sent to its echo, handled as soon as it's read
+//   bandwidth bytes in and out, totals and per second
+//   kicks     Disconnect packets, by reason, plus sockets that just closed
+//
+// usage: minecraft-loadbot [options], see usage() below. Everything runs on
+// one thread, all bots multiplexed over a single poll()
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../net/packet.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(_WIN32)
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #include <windows.h>
+  typedef SOCKET sock_t;
+  #define BAD_SOCK INVALID_SOCKET
+  #define pollSockets WSAPoll
+  #define closeSock closesocket
+#else
+  #include <arpa/inet.h>
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <netdb.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <time.h>
+  #include <unistd.h>
+  typedef int sock_t;
+  #define BAD_SOCK (-1)
+  #define pollSockets poll
+  #define closeSock close
+#endif
+
+#define PROTOCOL_VERSION 6
+#define MAX_KICK_REASONS 16
+#define ECHO_TIMEOUT_NANOS 5000000000LL // an echo that never came is dropped, not counted
+
+typedef enum {
+    BOT_IDLE,       // not connected yet
+    BOT_CONNECTING,
+    BOT_JOINING,    // login sent, level on its way
+    BOT_PLAYING,    // self spawn received
+    BOT_GONE        // kicked or disconnected, never reconnects
+} BotState;
+
+typedef struct {
+    int index;
+    BotState state;
+    sock_t sock;
+    char name[24];
+
+    unsigned char* in;
+    int inLen, inCapacity;
+    unsigned char* out; // whatever a non-blocking send couldn't take yet
+    int outLen, outCapacity;
+
+    long long connectStart;
+    int spawnX, spawnY, spawnZ; // 1/32 block units, from the self spawn
+    int centerX, centerZ;       // of the circle walked
+    int levelWidth, levelHeight; // x and z extent, in blocks
+    int x, y, z;
+    double angle;
+
+    long long nextMove, nextChat, nextSetBlock;
+    int chatSeq;
+    bool placeNext;
+
+    // the one echo of each kind being waited for
+    long long chatSentAt;
+    char chatText[PACKET_STRING_LEN + 1];
+    long long setBlockSentAt;
+    int setBlockX, setBlockY, setBlockZ, setBlockType;
+} Bot;
+
+typedef struct {
+    double* values;
+    int count, capacity;
+} Samples;
+
+typedef struct {
+    char host[128];
+    int port;
+    int bots;
+    double seconds;
+    double joinRate;    // connects per second
+    double moveRate;    // per bot per second, each one a Teleport
+    double chatRate;
+    double setBlockRate;
+    double radius;      // blocks, of the circle each bot walks
+    int tile;
+    char prefix[9];
+    double reportSeconds;
+} Options;
+
+static Options sOpt = {
+    "127.0.0.1", 25565, 32, 60.0, 10.0, 10.0, 0.05, 2.0, 3.0, 21, "bot", 10.0
+};
+
+static Samples sJoin, sSetBlock, sChat;
+static long long sBytesIn, sBytesOut;
+static int sJoined, sClosed, sConnectFailed;
+static char sKickReasons[MAX_KICK_REASONS][PACKET_STRING_LEN + 1];
+static int sKickCounts[MAX_KICK_REASONS];
+static int sKickReasonCount, sKicks;
+
+static long long nowNanos(void) {
+#if defined(_WIN32)
+    static LARGE_INTEGER freq = {0};
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (long long)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+// a rate of 0 (or less) never comes due
+static long long interval(double perSecond) {
+    return perSecond > 0 ? (long long)(1e9 / perSecond) : -1;
+}
+
+/* stats */
+
+static void addSample(Samples* s, double v) {
+    if (s->count == s->capacity) {
+        int capacity = s->capacity ? s->capacity * 2 : 256;
+        double* grown = (double*)realloc(s->values, (size_t)capacity * sizeof *grown);
+        if (!grown) return;
+        s->values = grown;
+        s->capacity = capacity;
+    }
+    s->values[s->count++] = v;
+}
+
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void printSamples(const char* label, Samples* s) {
+    if (s->count == 0) {
+        printf("  %-9s no samples\n", label);
+        return;
+    }
+    qsort(s->values, (size_t)s->count, sizeof *s->values, compareDoubles);
+    printf("  %-9s n=%-7d p50 %7.1f ms  p99 %7.1f ms  max %7.1f ms\n", label, s->count,
+           s->values[s->count / 2], s->values[(int)((long long)s->count * 99 / 100)], s->values[s->count - 1]);
+}
+
+static void countKick(const char* reason) {
+    sKicks++;
+    for (int i = 0; i < sKickReasonCount; i++) {
+        if (strcmp(sKickReasons[i], reason) == 0) {
+            sKickCounts[i]++;
+            return;
+        }
+    }
+    if (sKickReasonCount == MAX_KICK_REASONS) return; // still counted in sKicks
+    strcpy(sKickReasons[sKickReasonCount], reason);
+    sKickCounts[sKickReasonCount++] = 1;
+}
+
+static void report(Bot* bots, long long start, long long now) {
+    double secs = (double)(now - start) / 1e9;
+    int playing = 0;
+    for (int i = 0; i < sOpt.bots; i++)
+        if (bots[i].state == BOT_PLAYING) playing++;
+
+    printf("after %.1fs: %d playing, %d joined, %d kicked, %d closed, %d failed to connect\n",
+           secs, playing, sJoined, sKicks, sClosed, sConnectFailed);
+    printSamples("join", &sJoin);
+    printSamples("setblock", &sSetBlock);
+    printSamples("chat", &sChat);
+    printf("  in  %10lld bytes  %9.1f KB/s\n", sBytesIn, secs > 0 ? (double)sBytesIn / 1024.0 / secs : 0.0);
+    printf("  out %10lld bytes  %9.1f KB/s\n", sBytesOut, secs > 0 ? (double)sBytesOut / 1024.0 / secs : 0.0);
+    for (int i = 0; i < sKickReasonCount; i++)
+        printf("  kick x%-5d %s\n", sKickCounts[i], sKickReasons[i]);
+    fflush(stdout);
+}
+
+static int clampInt(int v, int lo, int hi) {
+    if (v > hi) v = hi;
+    return v < lo ? lo : v;
+}
+
+/* wire */
+
+static void putU16(unsigned char* p, int v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+static int getU16(const unsigned char* p) {
+    return (short)((p[0] << 8) | p[1]);
+}
+
+static void putString(unsigned char* p, const char* s) {
+    size_t len = strlen(s);
+    for (size_t i = 0; i < PACKET_STRING_LEN; i++) p[i] = (unsigned char)(i < len ? s[i] : ' ');
+}
+
+static void getString(const unsigned char* p, char* out) {
+    int len = PACKET_STRING_LEN;
+    while (len > 0 && p[len - 1] == ' ') len--;
+    memcpy(out, p, (size_t)len);
+    out[len] = '\0';
+}
+
+static void closeBot(Bot* b) {
+    if (b->sock != BAD_SOCK) closeSock(b->sock);
+    b->sock = BAD_SOCK;
+    b->state = BOT_GONE;
+    b->inLen = b->outLen = 0;
+}
+
+static bool wouldBlock(void) {
+#if defined(_WIN32)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+static void flushBot(Bot* b) {
+    while (b->outLen > 0) {
+        int n = (int)send(b->sock, (const char*)b->out, (size_t)b->outLen, 0);
+        if (n < 0) {
+            if (!wouldBlock()) {
+                sClosed++;
+                closeBot(b);
+            }
+            return;
+        }
+        sBytesOut += n;
+        memmove(b->out, b->out + n, (size_t)(b->outLen - n));
+        b->outLen -= n;
+    }
+}
+
+static void sendPacket(Bot* b, const unsigned char* pkt, int len) {
+    if (b->outLen + len > b->outCapacity) {
+        int capacity = b->outCapacity ? b->outCapacity : 4096;
+        while (capacity < b->outLen + len) capacity *= 2;
+        unsigned char* grown = (unsigned char*)realloc(b->out, (size_t)capacity);
+        if (!grown) return;
+        b->out = grown;
+        b->outCapacity = capacity;
+    }
+    memcpy(b->out + b->outLen, pkt, (size_t)len);
+    b->outLen += len;
+    flushBot(b);
+}
+
+static void sendLogin(Bot* b) {
+    unsigned char pkt[1 + 1 + PACKET_STRING_LEN * 2 + 1];
+    pkt[0] = (unsigned char)PACKET_LOGIN;
+    pkt[1] = PROTOCOL_VERSION;
+    putString(pkt + 2, b->name);
+    putString(pkt + 2 + PACKET_STRING_LEN, "-");
+    pkt[2 + PACKET_STRING_LEN * 2] = 0;
+    sendPacket(b, pkt, (int)sizeof pkt);
+}
+
+// one step around the circle, as a Teleport with the self id
+static void sendMove(Bot* b) {
+    double step = 4.0 / (sOpt.moveRate > 0 ? sOpt.moveRate : 1.0) / (sOpt.radius > 0 ? sOpt.radius : 1.0);
+    b->angle += step; // about 4 blocks a second
+    b->x = b->centerX + (int)(cos(b->angle) * sOpt.radius * 32.0);
+    b->z = b->centerZ + (int)(sin(b->angle) * sOpt.radius * 32.0);
+    b->y = b->spawnY;
+
+    unsigned char pkt[1 + 1 + 6 + 2];
+    pkt[0] = (unsigned char)PACKET_TELEPORT;
+    pkt[1] = 0xFF;
+    putU16(pkt + 2, b->x);
+    putU16(pkt + 4, b->y);
+    putU16(pkt + 6, b->z);
+    pkt[8] = (unsigned char)(int)(b->angle * 256.0 / (2.0 * 3.14159265358979323846));
+    pkt[9] = 0;
+    sendPacket(b, pkt, (int)sizeof pkt);
+}
+
+static void sendChat(Bot* b, long long now) {
+    snprintf(b->chatText, sizeof b->chatText, "load test %d", b->chatSeq++);
+    unsigned char pkt[1 + 1 + PACKET_STRING_LEN];
+    pkt[0] = (unsigned char)PACKET_MESSAGE;
+    pkt[1] = 0xFF;
+    putString(pkt + 2, b->chatText);
+    b->chatSentAt = now;
+    sendPacket(b, pkt, (int)sizeof pkt);
+}
+
+// places a block up and to the side of where the bot stands, well inside
+// the server's reach check and clear of the ground, then breaks that same
+// block next time
+static void sendSetBlock(Bot* b, long long now) {
+    if (b->placeNext) {
+        b->setBlockX = b->x / 32 + 2;
+        b->setBlockY = b->y / 32 + 2;
+        b->setBlockZ = b->z / 32;
+    }
+    unsigned char pkt[1 + 6 + 2];
+    pkt[0] = (unsigned char)PACKET_SET_BLOCK_CS;
+    putU16(pkt + 1, b->setBlockX);
+    putU16(pkt + 3, b->setBlockY);
+    putU16(pkt + 5, b->setBlockZ);
+    pkt[7] = b->placeNext ? 1 : 0;
+    pkt[8] = (unsigned char)sOpt.tile;
+    b->setBlockType = b->placeNext ? sOpt.tile : 0;
+    b->placeNext = !b->placeNext;
+    b->setBlockSentAt = now;
+    sendPacket(b, pkt, (int)sizeof pkt);
+}
+
+static void handlePacket(Bot* b, const unsigned char* p, long long now) {
+    switch (p[0]) {
+        case PACKET_SPAWN_PLAYER:
+            if (p[1] != 0xFF || b->state != BOT_JOINING) break;
+            b->state = BOT_PLAYING;
+            b->spawnX = b->x = getU16(p + 2 + PACKET_STRING_LEN);
+            b->spawnY = b->y = getU16(p + 4 + PACKET_STRING_LEN);
+            b->spawnZ = b->z = getU16(p + 6 + PACKET_STRING_LEN);
+            sJoined++;
+            addSample(&sJoin, (double)(now - b->connectStart) / 1e6);
+            // every bot walks its own circle on a grid around the spawn, far
+            // enough apart that no two ever edit the same block, and its
+            // actions are spread out rather than all on one tick
+            {
+                int spacing = (int)(sOpt.radius * 2.0 + 6.0) * 32;
+                int margin = (int)(sOpt.radius + 3.0) * 32;
+                b->centerX = clampInt(b->spawnX + (b->index % 16 - 8) * spacing, margin, b->levelWidth * 32 - margin);
+                b->centerZ = clampInt(b->spawnZ + (b->index / 16 % 16 - 8) * spacing, margin, b->levelHeight * 32 - margin);
+            }
+            b->angle = b->index * 0.7;
+            b->nextMove = now;
+            b->nextChat = now + interval(sOpt.chatRate) * (b->index % 13) / 13;
+            // the first move jumps to the circle, and the server only
+            // checks reach against a position it has processed, so give it
+            // a second before the first SetBlock
+            b->nextSetBlock = now + 1000000000LL + interval(sOpt.setBlockRate) * (b->index % 11) / 11;
+            break;
+        case PACKET_LEVEL_FINALIZE:
+            b->levelWidth = getU16(p + 1);
+            b->levelHeight = getU16(p + 5);
+            break;
+        case PACKET_SET_BLOCK_SC:
+            if (b->setBlockSentAt && getU16(p + 1) == b->setBlockX &&
+                getU16(p + 3) == b->setBlockY && getU16(p + 5) == b->setBlockZ && p[7] == b->setBlockType) {
+                addSample(&sSetBlock, (double)(now - b->setBlockSentAt) / 1e6);
+                b->setBlockSentAt = 0;
+            }
+            break;
+        case PACKET_MESSAGE: {
+            if (!b->chatSentAt) break;
+            char text[PACKET_STRING_LEN + 1];
+            getString(p + 2, text);
+            size_t nameLen = strlen(b->name);
+            if (strncmp(text, b->name, nameLen) == 0 && strncmp(text + nameLen, ": ", 2) == 0 &&
+                strcmp(text + nameLen + 2, b->chatText) == 0) {
+                addSample(&sChat, (double)(now - b->chatSentAt) / 1e6);
+                b->chatSentAt = 0;
+            }
+            break;
+        }
+        case PACKET_DISCONNECT: {
+            char reason[PACKET_STRING_LEN + 1];
+            getString(p + 1, reason);
+            countKick(reason);
+            closeBot(b);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void readBot(Bot* b, long long now) {
+    for (;;) {
+        if (b->inCapacity - b->inLen < 4096) {
+            int capacity = b->inCapacity ? b->inCapacity * 2 : 16384;
+            unsigned char* grown = (unsigned char*)realloc(b->in, (size_t)capacity);
+            if (!grown) return;
+            b->in = grown;
+            b->inCapacity = capacity;
+        }
+        int n = (int)recv(b->sock, (char*)b->in + b->inLen, (size_t)(b->inCapacity - b->inLen), 0);
+        if (n == 0 || (n < 0 && !wouldBlock())) {
+            sClosed++;
+            closeBot(b);
+            return;
+        }
+        if (n < 0) break;
+        b->inLen += n;
+        sBytesIn += n;
+    }
+
+    int pos = 0;
+    while (pos < b->inLen && b->state != BOT_GONE) {
+        int id = b->in[pos];
+        if (id >= PACKET_COUNT) {
+            countKick("(unknown packet id from server)");
+            closeBot(b);
+            return;
+        }
+        int need = 1 + PacketPayloadLen[id];
+        if (b->inLen - pos < need) break;
+        handlePacket(b, b->in + pos, now);
+        pos += need;
+    }
+    if (b->state == BOT_GONE) return;
+    memmove(b->in, b->in + pos, (size_t)(b->inLen - pos));
+    b->inLen -= pos;
+}
+
+static bool startConnect(Bot* b, const struct sockaddr_in* addr, long long now) {
+    b->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (b->sock == BAD_SOCK) return false;
+    int one = 1;
+    setsockopt(b->sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof one);
+#if defined(_WIN32)
+    u_long nonBlocking = 1;
+    ioctlsocket(b->sock, FIONBIO, &nonBlocking);
+#else
+    fcntl(b->sock, F_SETFL, fcntl(b->sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    b->connectStart = now;
+    b->state = BOT_CONNECTING;
+    if (connect(b->sock, (const struct sockaddr*)addr, sizeof *addr) == 0) {
+        b->state = BOT_JOINING;
+        sendLogin(b);
+        return true;
+    }
+#if defined(_WIN32)
+    if (WSAGetLastError() == WSAEWOULDBLOCK) return true;
+#else
+    if (errno == EINPROGRESS) return true;
+#endif
+    closeBot(b);
+    return false;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: minecraft-loadbot [options]\n"
+        "  -h host      server address (%s)\n"
+        "  -p port      server port (%d)\n"
+        "  -n bots      simulated players (%d)\n"
+        "  -d seconds   how long to run once started (%.0f)\n"
+        "  -j rate      connects per second (%.0f)\n"
+        "  -m rate      moves per bot per second (%.0f)\n"
+        "  -c rate      chat lines per bot per second (%.2f)\n"
+        "  -b rate      SetBlocks per bot per second (%.1f)\n"
+        "  -r blocks    radius of the circle each bot walks (%.0f)\n"
+        "  -t tile      tile id placed (%d)\n"
+        "  -P prefix    bot name prefix, names are prefix1..prefixN (%s)\n"
+        "  -i seconds   report interval, 0 for only the final one (%.0f)\n"
+        "a rate of 0 turns that action off. The server's own chat throttle\n"
+        "mutes anyone above roughly one 15 character line per 6 seconds\n",
+        sOpt.host, sOpt.port, sOpt.bots, sOpt.seconds, sOpt.joinRate, sOpt.moveRate,
+        sOpt.chatRate, sOpt.setBlockRate, sOpt.radius, sOpt.tile, sOpt.prefix, sOpt.reportSeconds);
+}
+
+static bool parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (a[0] != '-' || a[1] == '\0' || a[2] != '\0' || i + 1 >= argc) return false;
+        const char* v = argv[++i];
+        switch (a[1]) {
+            case 'h': snprintf(sOpt.host, sizeof sOpt.host, "%s", v); break;
+            case 'p': sOpt.port = atoi(v); break;
+            case 'n': sOpt.bots = atoi(v); break;
+            case 'd': sOpt.seconds = atof(v); break;
+            case 'j': sOpt.joinRate = atof(v); break;
+            case 'm': sOpt.moveRate = atof(v); break;
+            case 'c': sOpt.chatRate = atof(v); break;
+            case 'b': sOpt.setBlockRate = atof(v); break;
+            case 'r': sOpt.radius = atof(v); break;
+            case 't': sOpt.tile = atoi(v); break;
+            case 'P': snprintf(sOpt.prefix, sizeof sOpt.prefix, "%s", v); break;
+            case 'i': sOpt.reportSeconds = atof(v); break;
+            default: return false;
+        }
+    }
+    return sOpt.bots > 0 && sOpt.port > 0 && sOpt.port < 65536 && sOpt.joinRate > 0;
+}
+
+int main(int argc, char** argv) {
+    if (!parseArgs(argc, argv)) {
+        usage();
+        return 2;
+    }
+
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+#endif
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)sOpt.port);
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(sOpt.host, NULL, &hints, &res) != 0 || !res) {
+        fprintf(stderr, "can't resolve %s\n", sOpt.host);
+        return 1;
+    }
+    addr.sin_addr = ((struct sockaddr_in*)res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+
+    Bot* bots = (Bot*)calloc((size_t)sOpt.bots, sizeof *bots);
+    struct pollfd* fds = (struct pollfd*)calloc((size_t)sOpt.bots, sizeof *fds);
+    Bot** fdBots = (Bot**)calloc((size_t)sOpt.bots, sizeof *fdBots);
+    if (!bots || !fds || !fdBots) return 1;
+    for (int i = 0; i < sOpt.bots; i++) {
+        bots[i].index = i;
+        bots[i].sock = BAD_SOCK;
+        bots[i].placeNext = true;
+        snprintf(bots[i].name, sizeof bots[i].name, "%s%d", sOpt.prefix, i + 1);
+    }
+
+    printf("%d bots against %s:%d for %.0fs\n", sOpt.bots, sOpt.host, sOpt.port, sOpt.seconds);
+    long long start = nowNanos();
+    long long end = start + (long long)(sOpt.seconds * 1e9);
+    long long reportEvery = sOpt.reportSeconds > 0 ? (long long)(sOpt.reportSeconds * 1e9) : -1;
+    long long nextReport = reportEvery > 0 ? start + reportEvery : -1;
+    long long joinEvery = interval(sOpt.joinRate);
+    long long moveEvery = interval(sOpt.moveRate), chatEvery = interval(sOpt.chatRate);
+    long long setBlockEvery = interval(sOpt.setBlockRate);
+    int connected = 0;
+
+    for (;;) {
+        long long now = nowNanos();
+        if (now >= end) break;
+
+        while (connected < sOpt.bots && now >= start + joinEvery * connected) {
+            if (!startConnect(&bots[connected], &addr, now)) sConnectFailed++;
+            connected++;
+        }
+
+        for (int i = 0; i < connected; i++) {
+            Bot* b = &bots[i];
+            if (b->state != BOT_PLAYING) continue;
+            if (moveEvery > 0 && now >= b->nextMove) {
+                sendMove(b);
+                b->nextMove += moveEvery;
+                if (b->nextMove < now) b->nextMove = now + moveEvery; // fell behind, don't burst
+            }
+            if (b->state == BOT_PLAYING && chatEvery > 0 && now >= b->nextChat) {
+                sendChat(b, now);
+                b->nextChat += chatEvery;
+                if (b->nextChat < now) b->nextChat = now + chatEvery;
+            }
+            if (b->state == BOT_PLAYING && setBlockEvery > 0 && now >= b->nextSetBlock) {
+                if (b->setBlockSentAt && now - b->setBlockSentAt > ECHO_TIMEOUT_NANOS) b->setBlockSentAt = 0;
+                if (!b->setBlockSentAt) sendSetBlock(b, now);
+                b->nextSetBlock += setBlockEvery;
+                if (b->nextSetBlock < now) b->nextSetBlock = now + setBlockEvery;
+            }
+            if (b->chatSentAt && now - b->chatSentAt > ECHO_TIMEOUT_NANOS) b->chatSentAt = 0;
+        }
+
+        int nfds = 0;
+        for (int i = 0; i < connected; i++) {
+            Bot* b = &bots[i];
+            if (b->state == BOT_GONE || b->state == BOT_IDLE) continue;
+            fds[nfds].fd = b->sock;
+            fds[nfds].events = POLLIN;
+            if (b->state == BOT_CONNECTING || b->outLen > 0) fds[nfds].events |= POLLOUT;
+            fds[nfds].revents = 0;
+            fdBots[nfds++] = b;
+        }
+        // wake for whichever comes first of a socket or the next scheduled
+        // action; 5ms keeps the schedule honest without spinning
+        if (nfds > 0) pollSockets(fds, (unsigned)nfds, 5);
+        else {
+#if defined(_WIN32)
+            Sleep(5);
+#else
+            struct timespec ts = { 0, 5000000 };
+            nanosleep(&ts, NULL);
+#endif
+        }
+
+        now = nowNanos();
+        for (int i = 0; i < nfds; i++) {
+            Bot* b = fdBots[i];
+            short re = fds[i].revents;
+            if (!re) continue;
+            if (b->state == BOT_CONNECTING) {
+                int err = 0;
+                socklen_t errLen = sizeof err;
+                getsockopt(b->sock, SOL_SOCKET, SO_ERROR, (char*)&err, &errLen);
+                if (err != 0 || (re & (POLLERR | POLLHUP))) {
+                    sConnectFailed++;
+                    closeBot(b);
+                    continue;
+                }
+                b->state = BOT_JOINING;
+                sendLogin(b);
+                continue;
+            }
+            if (re & POLLOUT) flushBot(b);
+            if (b->state != BOT_GONE && (re & (POLLIN | POLLERR | POLLHUP))) readBot(b, now);
+        }
+
+        if (nextReport > 0 && now >= nextReport) {
+            report(bots, start, now);
+            nextReport += reportEvery;
+        }
+    }
+
+    printf("final ");
+    report(bots, start, nowNanos());
+    for (int i = 0; i < sOpt.bots; i++) {
+        if (bots[i].sock != BAD_SOCK) closeSock(bots[i].sock);
+        free(bots[i].in);
+        free(bots[i].out);
+    }
+    free(bots);
+    free(fds);
+    free(fdBots);
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+    return 0;
+}
@@ -0,0 +1,62 @@
+// view_grid.c
+
+#include "view_grid.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool ViewGrid_init(ViewGrid* grid, int levelWidth, int levelHeight, int cellSize) {
+    memset(grid, 0, sizeof *grid);
+    if (cellSize < 1) cellSize = 1;
+    grid->cellSize = cellSize;
+    grid->cols = (levelWidth + cellSize - 1) / cellSize;
+    grid->rows = (levelHeight + cellSize - 1) / cellSize;
+    if (grid->cols < 1) grid->cols = 1;
+    if (grid->rows < 1) grid->rows = 1;
+    grid->heads = (ViewGridNode**)calloc((size_t)(grid->cols * grid->rows), sizeof *grid->heads);
+    return grid->heads != NULL;
+}
+
+void ViewGrid_destroy(ViewGrid* grid) {
+    free(grid->heads);
+    memset(grid, 0, sizeof *grid);
+}
+
+int ViewGrid_cellAt(const ViewGrid* grid, int blockX, int blockZ) {
+    int cx = blockX < 0 ? 0 : blockX / grid->cellSize;
+    int cz = blockZ < 0 ? 0 : blockZ / grid->cellSize;
+    if (cx >= grid->cols) cx = grid->cols - 1;
+    if (cz >= grid->rows) cz = grid->rows - 1;
+    return cz * grid->cols + cx;
+}
+
+void ViewGrid_remove(ViewGrid* grid, ViewGridNode* node) {
+    if (node->cell < 0) return;
+    if (node->prev) node->prev->next = node->next;
+    else grid->heads[node->cell] = node->next;
+    if (node->next) node->next->prev = node->prev;
+    node->prev = node->next = NULL;
+    node->cell = -1;
+}
+
+void ViewGrid_place(ViewGrid* grid, ViewGridNode* node, int cell) {
+    if (node->cell == cell) return;
+    ViewGrid_remove(grid, node);
+    node->cell = cell;
+    node->prev = NULL;
+    node->next = grid->heads[cell];
+    if (node->next) node->next->prev = node;
+    grid->heads[cell] = node;
+}
+
+int ViewGrid_nearCells(const ViewGrid* grid, int cell, int out[9]) {
+    int cx = cell % grid->cols, cz = cell / grid->cols;
+    int n = 0;
+    for (int z = cz - 1; z <= cz + 1; z++) {
+        if (z < 0 || z >= grid->rows) continue;
+        for (int x = cx - 1; x <= cx + 1; x++) {
+            if (x < 0 || x >= grid->cols) continue;
+            out[n++] = z * grid->cols + x;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,42 @@
+// view_grid.h: a uniform 2D grid over the level's x/z plane, bucketing
+// in-game players by position so "who's near this player" only has to
+// look at a few cells rather than every connection. Not in the real
+// source, where every player always sees every other one. Backs the
+// view-distance setting (see Server_updateVisibility)
+
+#ifndef VIEW_GRID_H
+#define VIEW_GRID_H
+
+#include <stdbool.h>
+
+// embedded in whatever is being tracked (a Connection), linking it into
+// its cell's list. cell is -1 while not in the grid
+typedef struct ViewGridNode {
+    struct ViewGridNode* prev;
+    struct ViewGridNode* next;
+    int cell;
+    void* owner;
+} ViewGridNode;
+
+typedef struct ViewGrid {
+    int cellSize; // in blocks
+    int cols, rows;
+    ViewGridNode** heads; // cols * rows lists
+} ViewGrid;
+
+// cellSize should be at least the largest distance anything is ever
+// looked for at, so the 3x3 cells around a point always cover it
+bool ViewGrid_init(ViewGrid* grid, int levelWidth, int levelHeight, int cellSize);
+void ViewGrid_destroy(ViewGrid* grid);
+
+// which cell a block position falls in. Positions off the edge of the map
+// (players can walk out there) clamp to the nearest edge cell
+int  ViewGrid_cellAt(const ViewGrid* grid, int blockX, int blockZ);
+// links node into cell, unlinking it from wherever it was first
+void ViewGrid_place(ViewGrid* grid, ViewGridNode* node, int cell);
+void ViewGrid_remove(ViewGrid* grid, ViewGridNode* node);
+
+// fills out with the (up to 9) cells at and around cell, returns how many
+int  ViewGrid_nearCells(const ViewGrid* grid, int cell, int out[9]);
+
+#endif